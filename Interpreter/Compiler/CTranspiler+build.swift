@@ -0,0 +1,164 @@
+import Foundation
+import QuasicodeInterpreter
+
+extension CTranspiler {
+    enum BuildError: Error {
+        case frontEndProblems([InterpreterProblem])
+        case transpileProblems([InterpreterProblem])
+        case compilerFailed(String)
+    }
+    
+    /// Runs the scanner, parser, templater, resolver and type checker the same way main.swift does
+    static func typeCheckedAst(source: String) -> ([Stmt], SymbolTable, [InterpreterProblem]) {
+        let scanner = QuasicodeInterpreter.Scanner(source: source)
+        let (tokens, scanErrors) = scanner.scanTokens()
+        
+        var symbolTable: SymbolTable = .init()
+        Builtins.addStringClassToSymbolTable(symbolTable)
+        let stringClassIndex = symbolTable.queryAtGlobalOnly("String<>")!.id
+        
+        let parser = Parser(tokens: tokens, stringClassIndex: stringClassIndex, builtinClasses: ["String"])
+        let (parsedStmts, parseErrors) = parser.parse(addBuiltinclassesToAst: false)
+        var (ast, templateErrors) = Templater().expandClasses(statements: parsedStmts)
+        let resolveErrors = Resolver().resolveAST(statements: &ast, symbolTable: &symbolTable)
+        let typeCheckerErrors = TypeChecker().typeCheckAst(statements: ast, symbolTables: &symbolTable, parallel: TYPE_CHECK_IN_PARALLEL)
+        
+        return (ast, symbolTable, scanErrors + parseErrors + templateErrors + resolveErrors + typeCheckerErrors)
+    }
+    
+    /// Transpiles a Quasicode program and builds it into an executable with the system C compiler.
+    /// `runtimeDirectory` is the directory containing the VM sources, whose object.c and memory.c are linked in.
+    static func build(
+        source: String,
+        executablePath: String,
+        runtimeDirectory: String,
+        compiler: String = "/usr/bin/cc",
+        optimizationFlag: String = "-O2"
+    ) throws {
+        let (ast, symbolTable, frontEndProblems) = typeCheckedAst(source: source)
+        if !frontEndProblems.isEmpty {
+            throw BuildError.frontEndProblems(frontEndProblems)
+        }
+        let (cSource, transpileProblems) = CTranspiler().transpileAst(statements: ast, symbolTable: symbolTable)
+        if !transpileProblems.isEmpty {
+            throw BuildError.transpileProblems(transpileProblems)
+        }
+        
+        let cSourcePath = executablePath + ".c"
+        try cSource.write(toFile: cSourcePath, atomically: true, encoding: .utf8)
+        
+        let runtimeUrl = URL(fileURLWithPath: runtimeDirectory)
+        let (status, _, compilerOutput) = try run(executable: compiler, arguments: [
+            optimizationFlag,
+            "-I", runtimeDirectory,
+            cSourcePath,
+            runtimeUrl.appendingPathComponent("object.c").path,
+            runtimeUrl.appendingPathComponent("memory.c").path,
+            "-lm",
+            "-o", executablePath
+        ])
+        if status != 0 {
+            throw BuildError.compilerFailed(compilerOutput)
+        }
+    }
+    
+    /// Builds a program and runs it attached to the standard input and output of this process, returning its exit status
+    static func buildAndRun(source: String, runtimeDirectory: String) throws -> Int32 {
+        let executablePath = NSTemporaryDirectory() + "qsc-\(UUID().uuidString)"
+        defer {
+            try? FileManager.default.removeItem(atPath: executablePath)
+            try? FileManager.default.removeItem(atPath: executablePath + ".c")
+        }
+        try build(source: source, executablePath: executablePath, runtimeDirectory: runtimeDirectory)
+        let process = Process()
+        process.executableURL = URL(fileURLWithPath: executablePath)
+        try process.run()
+        process.waitUntilExit()
+        return process.terminationStatus
+    }
+    
+    private static func run(executable: String, arguments: [String], stdin: String = "") throws -> (Int32, String, String) {
+        let process = Process()
+        process.executableURL = URL(fileURLWithPath: executable)
+        process.arguments = arguments
+        let stdinPipe = Pipe()
+        let stdoutPipe = Pipe()
+        let stderrPipe = Pipe()
+        process.standardInput = stdinPipe
+        process.standardOutput = stdoutPipe
+        process.standardError = stderrPipe
+        try process.run()
+        stdinPipe.fileHandleForWriting.write(stdin.data(using: .utf8)!)
+        try stdinPipe.fileHandleForWriting.close()
+        // read before waiting so that a full pipe can't block the child
+        let stdoutData = stdoutPipe.fileHandleForReading.readDataToEndOfFile()
+        let stderrData = stderrPipe.fileHandleForReading.readDataToEndOfFile()
+        process.waitUntilExit()
+        return (process.terminationStatus, String(decoding: stdoutData, as: UTF8.self), String(decoding: stderrData, as: UTF8.self))
+    }
+    
+    /// Builds every program in `sourceFiles` and checks that the executable prints exactly what the interpreter prints, and that both of them
+    /// either succeed or fail with a runtime error. If a file named `<program>.in` exists, it is used as the input of both.
+    /// Returns the files whose output differs, or that couldn't be built.
+    static func verifyAgainstInterpreter(sourceFiles: [String], runtimeDirectory: String, compiler: String = "/usr/bin/cc") -> [String] {
+        var failures: [String] = []
+        for sourceFile in sourceFiles {
+            guard let source = try? String(contentsOfFile: sourceFile) else {
+                print("\(sourceFile): could not be read")
+                failures.append(sourceFile)
+                continue
+            }
+            let input = (try? String(contentsOfFile: sourceFile + ".in")) ?? ""
+            
+            let (ast, symbolTable, problems) = typeCheckedAst(source: source)
+            if !problems.isEmpty {
+                print("\(sourceFile): has \(problems.count) compile time problems")
+                failures.append(sourceFile)
+                continue
+            }
+            
+            // interpreter
+            var inputLines = input.split(separator: "\n", omittingEmptySubsequences: false).map { String($0) }
+            var interpreterOutput = ""
+            var interpreterErrored = false
+            Interpreter().execute(
+                ast,
+                symbolTable: symbolTable,
+                customStdin: {
+                    inputLines.isEmpty ? "" : inputLines.removeFirst()
+                },
+                customStdout: { output in
+                    interpreterOutput += output
+                },
+                customErrorHandling: { _, _, _ in
+                    interpreterErrored = true
+                }
+            )
+            
+            // native
+            let executablePath = NSTemporaryDirectory() + "qsc-\(UUID().uuidString)"
+            defer {
+                try? FileManager.default.removeItem(atPath: executablePath)
+                try? FileManager.default.removeItem(atPath: executablePath + ".c")
+            }
+            let nativeResult: (status: Int32, stdout: String, stderr: String)
+            do {
+                try build(source: source, executablePath: executablePath, runtimeDirectory: runtimeDirectory, compiler: compiler)
+                nativeResult = try run(executable: executablePath, arguments: [], stdin: input)
+            } catch {
+                print("\(sourceFile): could not be built (\(error))")
+                failures.append(sourceFile)
+                continue
+            }
+            
+            if nativeResult.stdout != interpreterOutput || (nativeResult.status != 0) != interpreterErrored {
+                print("\(sourceFile): output differs from the interpreter")
+                failures.append(sourceFile)
+            } else {
+                print("\(sourceFile): ok")
+            }
+        }
+        print("\(sourceFiles.count - failures.count)/\(sourceFiles.count) programs match the interpreter")
+        return failures
+    }
+}
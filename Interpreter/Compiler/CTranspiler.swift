@@ -0,0 +1,1115 @@
+import QuasicodeInterpreter
+
+// swiftlint:disable type_body_length
+/// Translates a type checked AST into a single C translation unit, which links against the VM's object.c and memory.c runtime.
+/// Ints, doubles and booleans become `long`, `double` and `bool`, strings become `struct ObjString*` and arrays become `struct ObjArray*`
+/// whose elements are stored as raw 64 bit words. Only the subset of the language supported by the tree-walk interpreter can be transpiled,
+/// everything else is reported as a problem.
+class CTranspiler: ExprStringVisitor, StmtVisitor {
+// swiftlint:enable type_body_length
+    private var symbolTable: SymbolTable = .init()
+    private var stringClassId = -1
+    private var problems: [InterpreterProblem] = []
+    
+    // the body of the function that is being generated, and the locals it uses. locals are declared at the top of the function
+    private var body = ""
+    private var indentation = 1
+    private var locals: [Int] = []
+    private var localsSet: Set<Int> = []
+    private var params: Set<Int> = []
+    private var temporaryCount = 0
+    // the declarations of the temporaries that evaluateInOrder uses in the function, which are declared with the locals
+    private var temporaryDeclarations: [String] = []
+    
+    private var stringLiterals: [String : Int] = [:]
+    private var stringLiteralInitializers: [String] = []
+    // array helpers (printing, equality and allocation) are generated on demand, per element type
+    private var generatedHelpers: Set<String> = []
+    private var helperPrototypes: [String] = []
+    private var helperDefinitions: [String] = []
+    
+    init() {}
+    
+    private func error(message: String, start: InterpreterLocation, end: InterpreterLocation) {
+        problems.append(.init(message: message, start: start, end: end))
+    }
+    
+    private func unsupported(_ what: String, on expr: Expr) -> String {
+        error(message: "\(what) cannot be transpiled to C", start: expr.startLocation, end: expr.endLocation)
+        return "0"
+    }
+    
+    private func unsupported(_ what: String, on stmt: Stmt) {
+        error(message: "\(what) cannot be transpiled to C", start: stmt.startLocation, end: stmt.endLocation)
+    }
+    
+    private func isString(_ type: QsType?) -> Bool {
+        return (type as? QsClass)?.id == stringClassId
+    }
+    
+    private func cType(_ type: QsType?, start: InterpreterLocation, end: InterpreterLocation) -> String {
+        switch type {
+        case is QsInt:
+            return "long"
+        case is QsDouble:
+            return "double"
+        case is QsBoolean:
+            return "bool"
+        case is QsArray:
+            return "ObjArray*"
+        case is QsVoidType:
+            return "void"
+        default:
+            if isString(type) {
+                return "ObjString*"
+            }
+            error(message: "Values of this type cannot be transpiled to C", start: start, end: end)
+            return "long"
+        }
+    }
+    
+    private func cType(of expr: Expr) -> String {
+        return cType(expr.type, start: expr.startLocation, end: expr.endLocation)
+    }
+    
+    /// A short name for a type that is used to name the helpers generated for it
+    private func mangle(_ type: QsType) -> String {
+        switch type {
+        case is QsInt:
+            return "i"
+        case is QsDouble:
+            return "d"
+        case is QsBoolean:
+            return "b"
+        case is QsArray:
+            return "a" + mangle((type as! QsArray).contains)
+        default:
+            return "s"
+        }
+    }
+    
+    private func toBits(_ value: String, type: QsType) -> String {
+        switch type {
+        case is QsDouble:
+            return "qsDoubleToBits(\(value))"
+        case is QsInt, is QsBoolean:
+            return "(unsigned long)(\(value))"
+        default:
+            return "(unsigned long)(uintptr_t)(\(value))"
+        }
+    }
+    
+    private func fromBits(_ bits: String, type: QsType) -> String {
+        switch type {
+        case is QsDouble:
+            return "qsBitsToDouble(\(bits))"
+        case is QsInt:
+            return "(long)(\(bits))"
+        case is QsBoolean:
+            return "((\(bits)) != 0)"
+        case is QsArray:
+            return "((ObjArray*)(uintptr_t)(\(bits)))"
+        default:
+            return "((ObjString*)(uintptr_t)(\(bits)))"
+        }
+    }
+    
+    private func defaultValue(_ type: QsType?) -> String {
+        switch type {
+        case is QsInt:
+            return "0"
+        case is QsDouble:
+            return "0.0"
+        case is QsBoolean:
+            return "false"
+        case is QsArray:
+            return "qsAllocateArray(0, 0, 0)"
+        default:
+            return "qsEmptyString"
+        }
+    }
+    
+    private func location(_ expr: Expr) -> String {
+        return "\(expr.startLocation.row), \(expr.startLocation.column)"
+    }
+    
+    private func variableName(_ symbolTableIndex: Int) -> String {
+        let name = symbolTable.getSymbol(id: symbolTableIndex).name.filter { character in
+            character.isASCII && (character.isLetter || character.isNumber || character == "_")
+        }
+        return "v\(symbolTableIndex)_\(name)"
+    }
+    
+    private func functionName(_ symbolTableIndex: Int) -> String {
+        let symbol = symbolTable.getSymbol(id: symbolTableIndex) as! FunctionSymbol
+        let name = symbol.functionStmt!.name.lexeme.filter { character in
+            character.isASCII && (character.isLetter || character.isNumber || character == "_")
+        }
+        return "f\(symbolTableIndex)_\(name)"
+    }
+    
+    /// Records a variable that is used by the function being generated, so that locals can be declared at the top of the function
+    private func useVariable(_ symbolTableIndex: Int) -> String {
+        let symbol = symbolTable.getSymbol(id: symbolTableIndex)
+        if !(symbol is GlobalVariableSymbol) && !params.contains(symbolTableIndex) && !localsSet.contains(symbolTableIndex) {
+            locals.append(symbolTableIndex)
+            localsSet.insert(symbolTableIndex)
+        }
+        return variableName(symbolTableIndex)
+    }
+    
+    private func makeTemporary() -> String {
+        temporaryCount += 1
+        return "t\(temporaryCount)"
+    }
+    
+    private func isLiteral(_ expr: Expr) -> Bool {
+        if let grouping = expr as? GroupingExpr {
+            return isLiteral(grouping.expression)
+        }
+        return expr is LiteralExpr
+    }
+    
+    /// Whether evaluating the expression can neither fail nor have side effects, so that it only matters when it is evaluated if something
+    /// evaluated around it has side effects
+    private func readsOnly(_ expr: Expr) -> Bool {
+        if let grouping = expr as? GroupingExpr {
+            return readsOnly(grouping.expression)
+        }
+        return expr is LiteralExpr || expr is VariableExpr || expr is VariableToSetExpr
+    }
+    
+    /// Evaluates the operands of a C expression from left to right, like the interpreter does, and passes their values to `combine`.
+    /// C leaves the order in which operands and arguments are evaluated unspecified, so every operand that could affect or be affected by
+    /// the ones after it is assigned to a temporary first, and the assignments are chained with the comma operator, which is sequenced
+    private func evaluateInOrder(_ operands: [Expr], _ combine: ([String]) -> String) -> String {
+        var assignments: [String] = []
+        var values: [String] = []
+        for (i, operand) in operands.enumerated() {
+            let value = expression(operand)
+            let later = operands[(i + 1)...]
+            if isLiteral(operand) || later.allSatisfy(isLiteral) || (readsOnly(operand) && later.allSatisfy(readsOnly)) {
+                values.append(value)
+                continue
+            }
+            let temporary = makeTemporary()
+            temporaryDeclarations.append("\(cType(of: operand)) \(temporary);")
+            assignments.append("\(temporary) = \(value)")
+            values.append(temporary)
+        }
+        let combined = combine(values)
+        if assignments.isEmpty {
+            return combined
+        }
+        return "(\(assignments.joined(separator: ", ")), \(combined))"
+    }
+    
+    private func emit(_ line: String) {
+        body += String(repeating: "    ", count: indentation) + line + "\n"
+    }
+    
+    private func cStringLiteral(_ string: String) -> String {
+        var result = "\""
+        for byte in string.utf8 {
+            switch byte {
+            case UInt8(ascii: "\""), UInt8(ascii: "\\"):
+                result += "\\" + String(UnicodeScalar(byte))
+            case 0x20...0x7E:
+                result += String(UnicodeScalar(byte))
+            default:
+                // octal escapes never run into the characters that follow them, unlike hex escapes
+                let octal = String(byte, radix: 8)
+                result += "\\" + String(repeating: "0", count: 3 - octal.count) + octal
+            }
+        }
+        return result + "\""
+    }
+    
+    // MARK: array helpers
+    
+    private func addHelper(name: String, prototype: String, definition: () -> String) {
+        if generatedHelpers.contains(name) {
+            return
+        }
+        generatedHelpers.insert(name)
+        helperPrototypes.append(prototype + ";")
+        // generating the definition may add the helpers for the element type first
+        let definitionBody = definition()
+        helperDefinitions.append(prototype + " {\n" + definitionBody + "}\n")
+    }
+    
+    private func printStatement(_ value: String, type: QsType) -> String {
+        switch type {
+        case is QsInt:
+            return "printf(\"%ld\", \(value));"
+        case is QsDouble:
+            return "qsPrintDouble(\(value));"
+        case is QsBoolean:
+            return "qsPrintBool(\(value));"
+        case is QsArray:
+            return "\(arrayPrintHelper(type as! QsArray))(\(value));"
+        default:
+            return "qsPrintString(\(value));"
+        }
+    }
+    
+    private func arrayPrintHelper(_ type: QsArray) -> String {
+        let name = "qsPrint_" + mangle(type)
+        addHelper(name: name, prototype: "static void \(name)(ObjArray* array)") {
+            """
+                putchar('{');
+                for (long i = 0; i < array->length; i++) {
+                    \(printStatement(fromBits("array->data[i]", type: type.contains), type: type.contains))
+                    if (i != array->length - 1) {
+                        fputs(", ", stdout);
+                    }
+                }
+                putchar('}');
+            
+            """
+        }
+        return name
+    }
+    
+    private func equalityExpression(_ lhs: String, _ rhs: String, type: QsType) -> String {
+        switch type {
+        case is QsInt, is QsDouble, is QsBoolean:
+            return "((\(lhs)) == (\(rhs)))"
+        case is QsArray:
+            return "\(arrayEqualityHelper(type as! QsArray))(\(lhs), \(rhs))"
+        default:
+            return "qsStringsEqual(\(lhs), \(rhs))"
+        }
+    }
+    
+    private func arrayEqualityHelper(_ type: QsArray) -> String {
+        let name = "qsEqual_" + mangle(type)
+        let elementsEqual = equalityExpression(
+            fromBits("lhs->data[i]", type: type.contains),
+            fromBits("rhs->data[i]", type: type.contains),
+            type: type.contains
+        )
+        addHelper(name: name, prototype: "static bool \(name)(ObjArray* lhs, ObjArray* rhs)") {
+            """
+                if (lhs == rhs) {
+                    return true;
+                }
+                if (lhs->length != rhs->length) {
+                    return false;
+                }
+                for (long i = 0; i < lhs->length; i++) {
+                    if (!\(elementsEqual)) {
+                        return false;
+                    }
+                }
+                return true;
+            
+            """
+        }
+        return name
+    }
+    
+    private func arrayAllocationHelper(_ type: QsArray) -> String {
+        let name = "qsAllocate_" + mangle(type)
+        let innerElement: String
+        if let contains = type.contains as? QsArray {
+            innerElement = "dimensions > 1 ? \(toBits("\(arrayAllocationHelper(contains))(lengths + 1, dimensions - 1, row, column)", type: contains)) : \(toBits(defaultValue(contains), type: contains))"
+        } else {
+            innerElement = toBits(defaultValue(type.contains), type: type.contains)
+        }
+        addHelper(name: name, prototype: "static ObjArray* \(name)(const long* lengths, int dimensions, long row, long column)") {
+            """
+                ObjArray* array = qsAllocateArray(lengths[0], row, column);
+                for (long i = 0; i < array->length; i++) {
+                    array->data[i] = \(innerElement);
+                }
+                return array;
+            
+            """
+        }
+        return name
+    }
+    
+    // MARK: expressions
+    
+    private func expression(_ expr: Expr) -> String {
+        return expr.accept(visitor: self)
+    }
+    
+    func visitGroupingExprString(expr: GroupingExpr) -> String {
+        return "(\(expression(expr.expression)))"
+    }
+    
+    func visitLiteralExprString(expr: LiteralExpr) -> String {
+        switch expr.value {
+        case is Int:
+            let value = expr.value as! Int
+            if value == Int.min {
+                return "(-9223372036854775807L - 1)"
+            }
+            return "\(value)L"
+        case is Double:
+            let value = expr.value as! Double
+            if value.isNaN {
+                return "NAN"
+            }
+            if value.isInfinite {
+                return value < 0 ? "(-INFINITY)" : "INFINITY"
+            }
+            // swift's description is the shortest representation that round trips, which is also a valid C double literal
+            return "(\(value.description))"
+        case is Bool:
+            return (expr.value as! Bool) ? "true" : "false"
+        case is String:
+            let value = expr.value as! String
+            if stringLiterals[value] == nil {
+                stringLiterals[value] = stringLiterals.count
+                stringLiteralInitializers.append("s\(stringLiterals[value]!) = compilerCopyString(\(cStringLiteral(value)), \(value.utf8.count));")
+            }
+            return "s\(stringLiterals[value]!)"
+        default:
+            return unsupported("Literals of this type", on: expr)
+        }
+    }
+    
+    func visitArrayLiteralExprString(expr: ArrayLiteralExpr) -> String {
+        guard let type = expr.type as? QsArray else {
+            return unsupported("This array literal", on: expr)
+        }
+        if expr.values.isEmpty {
+            return "qsAllocateArray(0, 0, 0)"
+        }
+        return evaluateInOrder(expr.values) { values in
+            let bits = values.map { toBits($0, type: type.contains) }
+            return "qsArrayLiteral(\(bits.count), (unsigned long[]){ \(bits.joined(separator: ", ")) })"
+        }
+    }
+    
+    func visitStaticClassExprString(expr: StaticClassExpr) -> String {
+        return unsupported("Classes", on: expr)
+    }
+    
+    func visitThisExprString(expr: ThisExpr) -> String {
+        return unsupported("Classes", on: expr)
+    }
+    
+    func visitSuperExprString(expr: SuperExpr) -> String {
+        return unsupported("Classes", on: expr)
+    }
+    
+    func visitVariableExprString(expr: VariableExpr) -> String {
+        return useVariable(expr.symbolTableIndex!)
+    }
+    
+    func visitSubscriptExprString(expr: SubscriptExpr) -> String {
+        guard let arrayType = expr.expression.type as? QsArray else {
+            return unsupported("Subscripting a value that isn't an array", on: expr)
+        }
+        return evaluateInOrder([expr.expression, expr.index]) { operands in
+            fromBits("qsArrayGet(\(operands[0]), \(operands[1]), \(location(expr.index)))", type: arrayType.contains)
+        }
+    }
+    
+    func visitCallExprString(expr: CallExpr) -> String {
+        guard
+            let callSymbolId = expr.uniqueFunctionCall,
+            let functionSymbol = symbolTable.getSymbol(id: callSymbolId) as? FunctionSymbol,
+            let functionStmt = functionSymbol.functionStmt
+        else {
+            return unsupported("Calls to methods and builtin functions", on: expr)
+        }
+        
+        // parameters that aren't passed get their initializer evaluated at the call site, after the arguments
+        var arguments: [Expr] = []
+        for (i, param) in functionStmt.params.enumerated() {
+            if i < expr.arguments.count {
+                arguments.append(expr.arguments[i])
+            } else {
+                arguments.append(param.initializer!)
+            }
+        }
+        return evaluateInOrder(arguments) { values in
+            "\(functionName(callSymbolId))(\(values.joined(separator: ", ")))"
+        }
+    }
+    
+    func visitGetExprString(expr: GetExpr) -> String {
+        // like the interpreter, the only property that is supported is the length of an array
+        if expr.object.type is QsArray {
+            return "(\(expression(expr.object)))->length"
+        }
+        return unsupported("Fields", on: expr)
+    }
+    
+    func visitUnaryExprString(expr: UnaryExpr) -> String {
+        let right = expression(expr.right)
+        switch expr.opr.tokenType {
+        case .MINUS:
+            if expr.right.type is QsInt {
+                return "qsNegateInt(\(right))"
+            }
+            return "(-(\(right)))"
+        case .NOT:
+            return "(!(\(right)))"
+        default:
+            return unsupported("The '\(expr.opr.lexeme)' operator", on: expr)
+        }
+    }
+    
+    private func convert(_ value: String, from fromType: QsType?, to toType: QsType?, expr: Expr) -> String {
+        if toType is QsInt && fromType is QsDouble {
+            return "((long)(\(value)))"
+        }
+        if toType is QsDouble && fromType is QsInt {
+            return "((double)(\(value)))"
+        }
+        if (toType is QsInt && fromType is QsInt) || (toType is QsDouble && fromType is QsDouble) {
+            return value
+        }
+        return unsupported("Casts to this type", on: expr)
+    }
+    
+    func visitCastExprString(expr: CastExpr) -> String {
+        return convert(expression(expr.value), from: expr.value.type, to: expr.type, expr: expr)
+    }
+    
+    func visitArrayAllocationExprString(expr: ArrayAllocationExpr) -> String {
+        guard let type = expr.type as? QsArray else {
+            return unsupported("This array allocation", on: expr)
+        }
+        return evaluateInOrder(expr.capacity) { lengths in
+            "\(arrayAllocationHelper(type))((long[]){ \(lengths.joined(separator: ", ")) }, \(lengths.count), \(location(expr)))"
+        }
+    }
+    
+    func visitClassAllocationExprString(expr: ClassAllocationExpr) -> String {
+        return unsupported("Classes", on: expr)
+    }
+    
+    func visitBinaryExprString(expr: BinaryExpr) -> String {
+        return evaluateInOrder([expr.left, expr.right]) { operands in
+            binaryOperation(expr, left: operands[0], right: operands[1])
+        }
+    }
+    
+    // swiftlint:disable:next cyclomatic_complexity
+    private func binaryOperation(_ expr: BinaryExpr, left: String, right: String) -> String {
+        let operandType = expr.left.type
+        switch expr.opr.tokenType {
+        case .EQUAL_EQUAL:
+            return equalityExpression(left, right, type: operandType!)
+        case .BANG_EQUAL:
+            return "(!\(equalityExpression(left, right, type: operandType!)))"
+        case .GREATER, .GREATER_EQUAL, .LESS, .LESS_EQUAL:
+            if isString(operandType) {
+                return "(qsCompareStrings(\(left), \(right)) \(expr.opr.lexeme) 0)"
+            }
+            return "((\(left)) \(expr.opr.lexeme) (\(right)))"
+        case .PLUS, .MINUS, .STAR, .SLASH, .DIV, .MOD:
+            if operandType is QsInt {
+                switch expr.opr.tokenType {
+                case .PLUS:
+                    return "qsAddInt(\(left), \(right))"
+                case .MINUS:
+                    return "qsSubtractInt(\(left), \(right))"
+                case .STAR:
+                    return "qsMultiplyInt(\(left), \(right))"
+                case .MOD:
+                    return "qsModInt(\(left), \(right), \(location(expr)))"
+                default:
+                    return "qsDivideInt(\(left), \(right), \(location(expr)))"
+                }
+            }
+            if operandType is QsDouble {
+                switch expr.opr.tokenType {
+                case .PLUS:
+                    return "((\(left)) + (\(right)))"
+                case .MINUS:
+                    return "((\(left)) - (\(right)))"
+                case .STAR:
+                    return "((\(left)) * (\(right)))"
+                case .SLASH:
+                    return "((\(left)) / (\(right)))"
+                case .DIV:
+                    return "((long)((\(left)) / (\(right))))"
+                default:
+                    break
+                }
+            }
+            if isString(operandType) && expr.opr.tokenType == .PLUS {
+                return "qsConcatStrings(\(left), \(right))"
+            }
+            return unsupported("The '\(expr.opr.lexeme)' operator on these operands", on: expr)
+        default:
+            return unsupported("The '\(expr.opr.lexeme)' operator", on: expr)
+        }
+    }
+    
+    func visitLogicalExprString(expr: LogicalExpr) -> String {
+        let left = expression(expr.left)
+        let right = expression(expr.right)
+        if expr.opr.tokenType == .AND {
+            return "((\(left)) && (\(right)))"
+        }
+        return "((\(left)) || (\(right)))"
+    }
+    
+    func visitVariableToSetExprString(expr: VariableToSetExpr) -> String {
+        return useVariable(expr.to.symbolTableIndex!)
+    }
+    
+    func visitIsTypeExprString(expr: IsTypeExpr) -> String {
+        // without anys or classes every value's type is known statically, the operand still has to be evaluated for its side effects
+        if expr.left.type is QsAnyType || expr.left.type is QsClass && !isString(expr.left.type) {
+            return unsupported("Type checks on anys and objects", on: expr)
+        }
+        let result = expr.left.type!.typeId == expr.rightType!.typeId
+        return "((void)(\(expression(expr.left))), \(result ? "true" : "false"))"
+    }
+    
+    func visitImplicitCastExprString(expr: ImplicitCastExpr) -> String {
+        return convert(expression(expr.expression), from: expr.expression.type, to: expr.type, expr: expr)
+    }
+    
+    // MARK: statements
+    
+    private func statement(_ stmt: Stmt) {
+        stmt.accept(visitor: self)
+    }
+    
+    private func statements(_ stmts: [Stmt]) {
+        for stmt in stmts {
+            statement(stmt)
+        }
+    }
+    
+    func visitClassStmt(stmt: ClassStmt) {
+        if !stmt.builtin {
+            unsupported("Classes", on: stmt)
+        }
+    }
+    
+    func visitMethodStmt(stmt: MethodStmt) {
+        unsupported("Methods", on: stmt)
+    }
+    
+    func visitFunctionStmt(stmt: FunctionStmt) {
+        // functions are generated separately, see transpileFunction
+    }
+    
+    func visitExpressionStmt(stmt: ExpressionStmt) {
+        emit("\(expression(stmt.expression));")
+    }
+    
+    func visitIfStmt(stmt: IfStmt) {
+        emit("if (\(expression(stmt.condition))) {")
+        indentation += 1
+        statement(stmt.thenBranch)
+        indentation -= 1
+        for branch in stmt.elseIfBranches {
+            emit("} else if (\(expression(branch.condition))) {")
+            indentation += 1
+            statement(branch.thenBranch)
+            indentation -= 1
+        }
+        if let elseBranch = stmt.elseBranch {
+            emit("} else {")
+            indentation += 1
+            statement(elseBranch)
+            indentation -= 1
+        }
+        emit("}")
+    }
+    
+    func visitOutputStmt(stmt: OutputStmt) {
+        for (i, expr) in stmt.expressions.enumerated() {
+            if expr.type is QsVoidType {
+                unsupported("Outputting the result of a function that doesn't return a value", on: stmt)
+                continue
+            }
+            _ = cType(of: expr)
+            emit(printStatement(expression(expr), type: expr.type!))
+            if i != stmt.expressions.count - 1 {
+                emit("putchar(' ');")
+            }
+        }
+        emit("putchar('\\n');")
+    }
+    
+    func visitInputStmt(stmt: InputStmt) {
+        for expr in stmt.expressions {
+            let value: String
+            switch expr.type {
+            case is QsInt:
+                value = "qsInputInt(\(location(expr)))"
+            case is QsDouble:
+                value = "qsInputDouble(\(location(expr)))"
+            default:
+                if !isString(expr.type) {
+                    unsupported("Inputting values of this type", on: stmt)
+                    continue
+                }
+                value = "qsReadLine()"
+            }
+            assign(value, type: expr.type!, to: expr)
+        }
+    }
+    
+    func visitReturnStmt(stmt: ReturnStmt) {
+        if let value = stmt.value {
+            emit("return \(expression(value));")
+        } else {
+            emit("return;")
+        }
+    }
+    
+    func visitLoopFromStmt(stmt: LoopFromStmt) {
+        let variable = useVariable(stmt.variable.symbolTableIndex!)
+        let counter = makeTemporary()
+        let upperBound = makeTemporary()
+        emit("for (long \(counter) = \(expression(stmt.lRange)), \(upperBound) = \(expression(stmt.rRange)); \(counter) <= \(upperBound); \(counter)++) {")
+        indentation += 1
+        emit("\(variable) = \(counter);")
+        statement(stmt.body)
+        indentation -= 1
+        emit("}")
+    }
+    
+    func visitWhileStmt(stmt: WhileStmt) {
+        emit("while (\(expression(stmt.expression))) {")
+        indentation += 1
+        statement(stmt.body)
+        indentation -= 1
+        emit("}")
+    }
+    
+    func visitBreakStmt(stmt: BreakStmt) {
+        emit("break;")
+    }
+    
+    func visitContinueStmt(stmt: ContinueStmt) {
+        emit("continue;")
+    }
+    
+    func visitBlockStmt(stmt: BlockStmt) {
+        statements(stmt.statements)
+    }
+    
+    func visitExitStmt(stmt: ExitStmt) {
+        emit("qsExit();")
+    }
+    
+    func visitMultiSetStmt(stmt: MultiSetStmt) {
+        for setStmt in stmt.setStmts {
+            statement(setStmt)
+        }
+    }
+    
+    private func assign(_ value: String, type: QsType, to lhs: Expr) {
+        switch lhs {
+        case is SubscriptExpr:
+            let lhs = lhs as! SubscriptExpr
+            let arraySet = evaluateInOrder([lhs.expression, lhs.index]) { operands in
+                "qsArraySet(\(operands[0]), \(operands[1]), \(toBits(value, type: type)), \(location(lhs.index)))"
+            }
+            emit("\(arraySet);")
+        case is VariableToSetExpr, is VariableExpr:
+            emit("\(expression(lhs)) = \(value);")
+        default:
+            unsupported("Assigning to fields", on: lhs)
+        }
+    }
+    
+    func visitSetStmt(stmt: SetStmt) {
+        let valueType = cType(of: stmt.value)
+        let value = expression(stmt.value)
+        if stmt.chained.isEmpty && !(stmt.left is SubscriptExpr) {
+            assign(value, type: stmt.value.type!, to: stmt.left)
+            return
+        }
+        // the value is evaluated before any of the targets, like the interpreter does
+        let temporary = makeTemporary()
+        emit("{")
+        indentation += 1
+        emit("\(valueType) \(temporary) = \(value);")
+        for chained in stmt.chained.reversed() {
+            assign(temporary, type: stmt.value.type!, to: chained)
+        }
+        assign(temporary, type: stmt.value.type!, to: stmt.left)
+        indentation -= 1
+        emit("}")
+    }
+    
+    // MARK: translation unit
+    
+    private func startFunction(params: Set<Int>) {
+        body = ""
+        indentation = 1
+        locals = []
+        localsSet = []
+        temporaryDeclarations = []
+        self.params = params
+    }
+    
+    private func localDeclarations() -> String {
+        var declarations = ""
+        for local in locals {
+            let type = (symbolTable.getSymbol(id: local) as! VariableSymbol).type
+            declarations += "    \(cType(type, start: .dub(), end: .dub())) \(variableName(local)) = \(defaultValue(type));\n"
+        }
+        for declaration in temporaryDeclarations {
+            declarations += "    \(declaration)\n"
+        }
+        return declarations
+    }
+    
+    private func transpileFunction(_ symbol: FunctionSymbol) -> (prototype: String, definition: String) {
+        let functionStmt = symbol.functionStmt!
+        var paramDeclarations: [String] = []
+        for param in functionStmt.params {
+            let type = (symbolTable.getSymbol(id: param.symbolTableIndex!) as! VariableSymbol).type
+            paramDeclarations.append("\(cType(type, start: param.name.startLocation, end: param.name.endLocation)) \(variableName(param.symbolTableIndex!))")
+        }
+        let returnType = cType(symbol.returnType, start: functionStmt.name.startLocation, end: functionStmt.name.endLocation)
+        let prototype = "static \(returnType) \(functionName(symbol.id))(\(paramDeclarations.isEmpty ? "void" : paramDeclarations.joined(separator: ", ")))"
+        
+        startFunction(params: Set(functionStmt.params.map { $0.symbolTableIndex! }))
+        statements(functionStmt.body)
+        if !(symbol.returnType is QsVoidType) {
+            // the type checker guarantees that every path returns, this only keeps the C compiler quiet
+            emit("return \(defaultValue(symbol.returnType));")
+        }
+        return (prototype: prototype + ";", definition: prototype + " {\n" + localDeclarations() + body + "}\n")
+    }
+    
+    /// Transpiles a type checked AST into a C translation unit. The returned source only compiles when there are no problems.
+    func transpileAst(statements: [Stmt], symbolTable: SymbolTable) -> (String, [InterpreterProblem]) {
+        self.symbolTable = symbolTable
+        stringClassId = symbolTable.queryAtGlobalOnly("String<>")?.id ?? -1
+        problems = []
+        stringLiterals = [:]
+        stringLiteralInitializers = []
+        generatedHelpers = []
+        helperPrototypes = []
+        helperDefinitions = []
+        temporaryCount = 0
+        
+        var globals: [Int] = []
+        var functionPrototypes: [String] = []
+        var functionDefinitions: [String] = []
+        for symbol in symbolTable.getAllSymbols() {
+            if symbol is GlobalVariableSymbol {
+                globals.append(symbol.id)
+            } else if let symbol = symbol as? FunctionSymbol, symbol.functionStmt != nil {
+                let (prototype, definition) = transpileFunction(symbol)
+                functionPrototypes.append(prototype)
+                functionDefinitions.append(definition)
+            }
+        }
+        
+        startFunction(params: [])
+        self.statements(statements)
+        
+        var result = CTranspiler.prelude + "\n"
+        for i in 0..<stringLiterals.count {
+            result += "static ObjString* s\(i);\n"
+        }
+        var globalInitializers = ""
+        for global in globals {
+            let type = (symbolTable.getSymbol(id: global) as! VariableSymbol).type
+            result += "static \(cType(type, start: .dub(), end: .dub())) \(variableName(global));\n"
+            globalInitializers += "    \(variableName(global)) = \(defaultValue(type));\n"
+        }
+        result += "\n" + helperPrototypes.joined(separator: "\n") + "\n" + functionPrototypes.joined(separator: "\n") + "\n\n"
+        result += helperDefinitions.joined(separator: "\n") + "\n" + functionDefinitions.joined(separator: "\n") + "\n"
+        result += "int main(void) {\n"
+        result += "    qsEmptyString = compilerCopyString(\"\", 0);\n"
+        for initializer in stringLiteralInitializers {
+            result += "    \(initializer)\n"
+        }
+        result += globalInitializers
+        result += localDeclarations()
+        result += body
+        result += "    fflush(stdout);\n    return 0;\n}\n"
+        
+        return (result, problems)
+    }
+    
+    // the runtime that every translation unit starts with. strings and arrays are allocated through memory.c, like the VM does
+    private static let prelude = #"""
+        #define _POSIX_C_SOURCE 200809L
+        
+        #include <stdio.h>
+        #include <string.h>
+        #include <stdint.h>
+        #include <stdbool.h>
+        #include <math.h>
+        #include <errno.h>
+        #include <ctype.h>
+        
+        #include "object.h"
+        #include "memory.h"
+        
+        typedef struct ObjString ObjString;
+        typedef struct ObjArray ObjArray;
+        
+        static ObjString* qsEmptyString;
+        
+        static void qsRuntimeError(const char* message, long row, long column) {
+            fflush(stdout);
+            fprintf(stderr, "Runtime error at %ld:%ld: %s\n", row, column, message);
+            exit(70);
+        }
+        
+        static void qsExit(void) {
+            fflush(stdout);
+            exit(0);
+        }
+        
+        // array elements are stored as raw 64 bit words, the same way the VM stores them
+        static inline unsigned long qsDoubleToBits(double value) {
+            unsigned long bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+        
+        static inline double qsBitsToDouble(unsigned long bits) {
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        
+        // quasicode integers wrap around on overflow
+        static inline long qsAddInt(long lhs, long rhs) {
+            return (long)((unsigned long)lhs + (unsigned long)rhs);
+        }
+        
+        static inline long qsSubtractInt(long lhs, long rhs) {
+            return (long)((unsigned long)lhs - (unsigned long)rhs);
+        }
+        
+        static inline long qsMultiplyInt(long lhs, long rhs) {
+            return (long)((unsigned long)lhs * (unsigned long)rhs);
+        }
+        
+        static inline long qsNegateInt(long value) {
+            return (long)(0UL - (unsigned long)value);
+        }
+        
+        // the smallest long divided by -1 overflows, which traps on x86 instead of wrapping around, so -1 is handled separately
+        static inline long qsDivideInt(long lhs, long rhs, long row, long column) {
+            if (rhs == 0) {
+                qsRuntimeError("Division by zero", row, column);
+            }
+            if (rhs == -1) {
+                return qsNegateInt(lhs);
+            }
+            return lhs / rhs;
+        }
+        
+        static inline long qsModInt(long lhs, long rhs, long row, long column) {
+            if (rhs == 0) {
+                qsRuntimeError("Division by zero", row, column);
+            }
+            if (rhs == -1) {
+                return 0;
+            }
+            return lhs % rhs;
+        }
+        
+        static ObjArray* qsAllocateArray(long length, long row, long column) {
+            if (length < 0) {
+                qsRuntimeError("Array length cannot be negative", row, column);
+            }
+            ObjArray* array = COMPILER_ALLOCATE_OBJ(ObjArray);
+            array->length = length;
+            array->data = NULL;
+            if (length != 0) {
+                array->data = COMPILER_MEM_ALLOCATE(unsigned long, length);
+                memset(array->data, 0, sizeof(unsigned long) * length);
+            }
+            return array;
+        }
+        
+        static ObjArray* qsArrayLiteral(long length, const unsigned long* values) {
+            ObjArray* array = qsAllocateArray(length, 0, 0);
+            memcpy(array->data, values, sizeof(unsigned long) * length);
+            return array;
+        }
+        
+        static inline unsigned long qsArrayGet(ObjArray* array, long index, long row, long column) {
+            if (index < 0 || index >= array->length) {
+                qsRuntimeError("Array access index out of range", row, column);
+            }
+            return array->data[index];
+        }
+        
+        static inline void qsArraySet(ObjArray* array, long index, unsigned long value, long row, long column) {
+            if (index < 0 || index >= array->length) {
+                qsRuntimeError("Array access index out of range", row, column);
+            }
+            array->data[index] = value;
+        }
+        
+        static ObjString* qsConcatStrings(ObjString* lhs, ObjString* rhs) {
+            long length = lhs->length + rhs->length;
+            char* chars = COMPILER_MEM_ALLOCATE(char, length);
+            if (lhs->length != 0) {
+                memcpy(chars, lhs->data, lhs->length);
+            }
+            if (rhs->length != 0) {
+                memcpy(chars + lhs->length, rhs->data, rhs->length);
+            }
+            ObjString* string = COMPILER_ALLOCATE_OBJ(ObjString);
+            string->length = length;
+            string->data = (unsigned char*)chars;
+            return string;
+        }
+        
+        static int qsCompareStrings(ObjString* lhs, ObjString* rhs) {
+            long length = lhs->length < rhs->length ? lhs->length : rhs->length;
+            int result = length == 0 ? 0 : memcmp(lhs->data, rhs->data, length);
+            if (result != 0) {
+                return result;
+            }
+            return (lhs->length > rhs->length) - (lhs->length < rhs->length);
+        }
+        
+        static inline bool qsStringsEqual(ObjString* lhs, ObjString* rhs) {
+            return qsCompareStrings(lhs, rhs) == 0;
+        }
+        
+        static void qsPrintString(ObjString* string) {
+            fwrite(string->data, 1, string->length, stdout);
+        }
+        
+        static void qsPrintBool(bool value) {
+            fputs(value ? "true" : "false", stdout);
+        }
+        
+        // prints a double the same way swift's description does: the shortest digits that round trip,
+        // in positional notation unless the magnitude is below 1e-4 or above 2^54
+        static void qsPrintDouble(double value) {
+            if (isnan(value)) {
+                fputs("nan", stdout);
+                return;
+            }
+            if (isinf(value)) {
+                fputs(value < 0 ? "-inf" : "inf", stdout);
+                return;
+            }
+            char scientific[40];
+            int precision;
+            for (precision = 1; precision < 17; precision++) {
+                snprintf(scientific, sizeof(scientific), "%.*e", precision - 1, value);
+                if (strtod(scientific, NULL) == value) {
+                    break;
+                }
+            }
+            snprintf(scientific, sizeof(scientific), "%.*e", precision - 1, value);
+            double magnitude = fabs(value);
+            if (magnitude != 0 && (magnitude < 1e-4 || magnitude > 18014398509481984.0)) {
+                fputs(scientific, stdout);
+                return;
+            }
+        
+            // split "-d.ddde+xx" into its digits and exponent
+            char digits[20];
+            int digitCount = 0;
+            char* current = scientific;
+            if (*current == '-') {
+                putchar('-');
+                current++;
+            }
+            while (*current != 'e') {
+                if (*current != '.') {
+                    digits[digitCount++] = *current;
+                }
+                current++;
+            }
+            int exponent = atoi(current + 1);
+            if (exponent < 0) {
+                fputs("0.", stdout);
+                for (int i = 0; i < -exponent - 1; i++) {
+                    putchar('0');
+                }
+                fwrite(digits, 1, digitCount, stdout);
+                return;
+            }
+            for (int i = 0; i <= exponent; i++) {
+                putchar(i < digitCount ? digits[i] : '0');
+            }
+            putchar('.');
+            if (exponent + 1 >= digitCount) {
+                putchar('0');
+            } else {
+                fwrite(digits + exponent + 1, 1, digitCount - exponent - 1, stdout);
+            }
+        }
+        
+        static ObjString* qsReadLine(void) {
+            char* line = NULL;
+            size_t capacity = 0;
+            ssize_t length = getline(&line, &capacity, stdin);
+            if (length <= 0) {
+                free(line);
+                return qsEmptyString;
+            }
+            if (line[length - 1] == '\n') {
+                length--;
+            }
+            ObjString* string = compilerCopyString(line, length);
+            free(line);
+            return string;
+        }
+        
+        // mirrors swift's Int(String) and Double(String), which reject surrounding whitespace
+        static bool qsParseInt(ObjString* string, long* result) {
+            if (string->length == 0 || string->length > 64 || isspace(string->data[0])) {
+                return false;
+            }
+            char buffer[65];
+            memcpy(buffer, string->data, string->length);
+            buffer[string->length] = '\0';
+            char* end;
+            errno = 0;
+            *result = strtol(buffer, &end, 10);
+            return errno == 0 && *end == '\0';
+        }
+        
+        static bool qsParseDouble(ObjString* string, double* result) {
+            if (string->length == 0 || string->length > 1024 || isspace(string->data[0])) {
+                return false;
+            }
+            char buffer[1025];
+            memcpy(buffer, string->data, string->length);
+            buffer[string->length] = '\0';
+            char* end;
+            *result = strtod(buffer, &end);
+            return *end == '\0';
+        }
+        
+        static long qsInputInt(long row, long column) {
+            ObjString* input = qsReadLine();
+            long intValue;
+            double doubleValue;
+            if (qsParseInt(input, &intValue)) {
+                return intValue;
+            }
+            if (qsParseDouble(input, &doubleValue)) {
+                return (long)doubleValue;
+            }
+            qsRuntimeError("Cannot cast input to type Int", row, column);
+            return 0;
+        }
+        
+        static double qsInputDouble(long row, long column) {
+            ObjString* input = qsReadLine();
+            double value;
+            if (!qsParseDouble(input, &value)) {
+                qsRuntimeError("Cannot cast input to type Double", row, column);
+            }
+            return value;
+        }
+        """#
+}
@@ -181,7 +181,8 @@ public class Compiler: ExprVisitor, StmtVisitor {
             _ intInstruction: OpCode,
             _ doubleInstruction: OpCode,
             stringInstruction: OpCode? = nil,
-            boolInstruction: OpCode? = nil
+            boolInstruction: OpCode? = nil,
+            anyInstruction: OpCode? = nil
         ) {
             if leftType is QsInt {
                 writeInstructionToChunk(op: intInstruction, expr: expr)
@@ -189,6 +190,10 @@ public class Compiler: ExprVisitor, StmtVisitor {
                 writeInstructionToChunk(op: doubleInstruction, expr: expr)
             } else if leftType is QsBoolean && boolInstruction != nil {
                 writeInstructionToChunk(op: boolInstruction!, expr: expr)
+            } else if leftType is QsAnyType && anyInstruction != nil {
+                // the VM quickens this into a variant specialised for the operand types it sees, the byte after it counts despecialisations
+                writeInstructionToChunk(op: anyInstruction!, expr: expr)
+                writeByteToChunk(data: 0, expr: expr)
             } else if typesEqual(leftType, stringClass, anyEqAny: true) {
                 writeInstructionToChunk(op: stringInstruction!, expr: expr)
             } else {
@@ -209,17 +214,17 @@ public class Compiler: ExprVisitor, StmtVisitor {
         case .BANG_EQUAL:
             writeInstruction(.OP_notEqualInt, .OP_notEqualDouble, stringInstruction: .OP_notEqualString, boolInstruction: .OP_notEqualBool)
         case .MINUS:
-            writeInstruction(.OP_minusInt, .OP_minusDouble)
+            writeInstruction(.OP_minusInt, .OP_minusDouble, anyInstruction: .OP_minusAny)
         case .SLASH:
             writeInstruction(.OP_divideInt, .OP_divideDouble)
         case .STAR:
-            writeInstruction(.OP_multiplyInt, .OP_multiplyDouble)
+            writeInstruction(.OP_multiplyInt, .OP_multiplyDouble, anyInstruction: .OP_multiplyAny)
         case .DIV:
             writeInstruction(.OP_intDivideInt, .OP_intDivideDouble)
         case .MOD:
             writeInstructionToChunk(op: .OP_modInt, expr: expr)
         case .PLUS:
-            writeInstruction(.OP_addInt, .OP_addDouble, stringInstruction: .OP_addString)
+            writeInstruction(.OP_addInt, .OP_addDouble, stringInstruction: .OP_addString, anyInstruction: .OP_addAny)
         default:
             assertionFailure("Unexpected binary operator \(expr.opr.tokenType)")
         }
@@ -300,6 +305,7 @@ public class Compiler: ExprVisitor, StmtVisitor {
                 writeInstructionToChunk(op: .OP_outputArray, expr: expr)
             case is QsAnyType:
                 writeInstructionToChunk(op: .OP_outputAny, expr: expr)
+                writeByteToChunk(data: 0, expr: expr)
             case is QsVoidType:
                 writeInstructionToChunk(op: .OP_outputVoid, expr: expr)
             default:
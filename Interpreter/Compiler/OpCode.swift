@@ -56,4 +56,36 @@ internal enum OpCode: Int {
     case OP_outputAny
     case OP_outputClass
     case OP_outputVoid
+    case OP_jump
+    case OP_jumpIfFalse
+    case OP_loop
+    case OP_getLocal
+    case OP_setLocal
+    case OP_countedLoop
+    case OP_addAny
+    case OP_addAnyInt
+    case OP_addAnyDouble
+    case OP_addAnyString
+    case OP_minusAny
+    case OP_minusAnyInt
+    case OP_minusAnyDouble
+    case OP_multiplyAny
+    case OP_multiplyAnyInt
+    case OP_multiplyAnyDouble
+    case OP_outputAnyInt
+    case OP_outputAnyDouble
+    case OP_outputAnyBoolean
+    case OP_outputAnyString
+    case OP_allocateInstance
+    case OP_getField
+    case OP_setField
+    case OP_getFieldExplicitlyTyped
+    case OP_setFieldExplicitlyTyped
+    case OP_inputInt
+    case OP_inputDouble
+    case OP_inputString
+    case OP_inputAny
+    case OP_call
+    case OP_tailCall
+    case OP_returnValue
 }
\ No newline at end of file
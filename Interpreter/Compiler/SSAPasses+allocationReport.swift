@@ -0,0 +1,33 @@
+import Foundation
+import QuasicodeInterpreter
+
+extension SSAPasses {
+    /// Counts the allocation sites that go through the heap in every program in `sourceFiles`, before and after optimising, and prints them
+    /// along with the totals. These are sites in the code, not allocations made at runtime: an allocation in a loop counts once. Nothing
+    /// lowers SSA to code yet, so the count is what escape analysis would save, not what any backend does. Programs that can't be lowered
+    /// to SSA are skipped.
+    static func allocationReport(sourceFiles: [String]) {
+        var totalBefore = 0
+        var totalAfter = 0
+        for sourceFile in sourceFiles {
+            guard let source = try? String(contentsOfFile: sourceFile) else {
+                print("\(sourceFile): could not be read")
+                continue
+            }
+            let (ast, symbolTable, problems) = CTranspiler.typeCheckedAst(source: source)
+            let (module, ssaProblems) = SSABuilder().buildModule(statements: ast, symbolTable: symbolTable)
+            if !problems.isEmpty || !ssaProblems.isEmpty {
+                print("\(sourceFile): skipped, has \(problems.count + ssaProblems.count) problems")
+                continue
+            }
+            let before = module.heapAllocationCount
+            let passes = SSAPasses(options: .all)
+            passes.optimise(module)
+            let after = module.heapAllocationCount
+            print("\(sourceFile): \(before) heap allocation sites before, \(after) after")
+            totalBefore += before
+            totalAfter += after
+        }
+        print("\(totalBefore) heap allocation sites before escape analysis, \(totalAfter) after")
+    }
+}
@@ -6,3 +6,5 @@
 #include "vm.h"
 #include "disassembler.h"
 #include "object.h"
+#include "host.h"
+#include "benchmark.h"
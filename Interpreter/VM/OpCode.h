@@ -58,6 +58,41 @@ enum OpCode {
     OP_outputAny=53,
     OP_outputClass=54,
     OP_outputVoid=55,
+    // control flow and frame slots. nothing compiles programs to bytecode yet (Compiler.swift is commented out), so for now these only
+    // come from hand-built chunks like the ones in Interpreter/VMTests
+    OP_jump=56,
+    OP_jumpIfFalse=57,
+    OP_loop=58,
+    OP_getLocal=59,
+    OP_setLocal=60,
+    OP_countedLoop=61,
+    OP_addAny=62,
+    OP_addAnyInt=63,
+    OP_addAnyDouble=64,
+    OP_addAnyString=65,
+    OP_minusAny=66,
+    OP_minusAnyInt=67,
+    OP_minusAnyDouble=68,
+    OP_multiplyAny=69,
+    OP_multiplyAnyInt=70,
+    OP_multiplyAnyDouble=71,
+    OP_outputAnyInt=72,
+    OP_outputAnyDouble=73,
+    OP_outputAnyBoolean=74,
+    OP_outputAnyString=75,
+    // instances and their fields, at the word offsets described in object.h. like the jump and slot opcodes, nothing emits these yet
+    OP_allocateInstance=76,
+    OP_getField=77,
+    OP_setField=78,
+    OP_getFieldExplicitlyTyped=79,
+    OP_setFieldExplicitlyTyped=80,
+    OP_inputInt=81,
+    OP_inputDouble=82,
+    OP_inputString=83,
+    OP_inputAny=84,
+    OP_call=85,
+    OP_tailCall=86,
+    OP_returnValue=87,
 };
 
 #endif /* opcode_h */
\ No newline at end of file
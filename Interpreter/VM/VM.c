@@ -5,22 +5,76 @@
 #include "disassembler.h"
 #include "ExplicitlyTypedValue.h"
 #include "object.h"
-#ifdef TIME_EXECUTION
+#include "jit.h"
+#include <stdarg.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
 #include <time.h>
-#endif
 
 typedef struct ObjString ObjString;
+typedef struct ObjInstance ObjInstance;
 
 static void resetStack(VM* vm) {
     vm->stackTop = vm->stack;
+    vm->slots = vm->stack;
+    vm->frameCount = 0;
+    vm->potentialObjectsOnStackListCount = 0;
 }
 
+// frees everything the last program left behind, so that the VM can run another one
 void resetVM(VM* vm) {
     resetStack(vm);
+    freeHeap(&vm->heap);
+    vm->outputLength = 0;
+    vm->runtimeErrorMessage = NULL;
+    vm->input = NULL;
+    vm->runState = VM_IDLE;
+    // an interrupt that came in after the last program finished was meant for it, not for the next one
+    atomic_store_explicit(&vm->interruptRequested, false, memory_order_relaxed);
+}
+
+static void freeVMClasses(VM* vm) {
+    COMPILER_MEM_FREE(int, vm->classNamesLength);
+    for (int i=0;i<vm->classesCount;i++) {
+        COMPILER_MEM_FREE(char, vm->classNamesArray[i]);
+    }
+    COMPILER_MEM_FREE(char*, vm->classNamesArray);
 }
 
 VM* initVM(const char** classNames, const int* classNamesLength, int classesCount) {
     VM* vm = malloc(sizeof *vm);
+    vm->classesCount = 0;
+    vm->classNamesLength = NULL;
+    vm->classNamesArray = NULL;
+    vm->stringClassId = -1;
+    vm->stack = COMPILER_MEM_ALLOCATE(uint64_t, STACK_INITIAL_WORDS);
+    vm->stackCapacity = STACK_INITIAL_WORDS;
+    vm->frames = NULL;
+    vm->frameCapacity = 0;
+    vm->potentialObjectsOnStackList = NULL;
+    vm->potentialObjectsOnStackListCount = 0;
+    vm->potentialObjectsOnStackListCapacity = 0;
+    vm->privateCode = NULL;
+    vm->privateCodeCapacity = 0;
+    initHeap(&vm->heap);
+    vm->bufferOutput = false;
+    vm->outputBuffer = NULL;
+    vm->outputCapacity = 0;
+    atomic_init(&vm->interruptRequested, false);
+    vm->safepointBudget = 0;
+    vm->secondsBudget = 0;
+    resetVM(vm);
+    if (!setVMClasses(vm, classNames, classNamesLength, classesCount)) {
+        freeVM(vm);
+        return NULL;
+    }
+    return vm;
+}
+
+// replaces the runtime class names, for a VM that is reused for programs with different classes
+bool setVMClasses(VM* vm, const char** classNames, const int* classNamesLength, int classesCount) {
+    freeVMClasses(vm);
     vm->classNamesLength = COMPILER_MEM_ALLOCATE(int, classesCount);
     vm->classesCount = classesCount;
     vm->classNamesArray = COMPILER_MEM_ALLOCATE(char*, classesCount);
@@ -29,19 +83,64 @@ VM* initVM(const char** classNames, const int* classNamesLength, int classesCoun
         vm->classNamesArray[i] = COMPILER_MEM_ALLOCATE(char, classNamesLength[i]);
         memcpy(vm->classNamesArray[i], classNames[i], classNamesLength[i]);
     }
-    resetVM(vm);
-    return vm;
+    vm->stringClassId = -1;
+    for (int i=0;i<vm->classesCount;i++) {
+        // the lengths count the terminating zero the way VMInterface passes them, but a length without it matches too
+        const int length = vm->classNamesLength[i];
+        if ((length == 6 || length == 7) && strncmp(vm->classNamesArray[i], "String", length) == 0) {
+            vm->stringClassId = i;
+        }
+    }
+    // class id 0 is never a class, since -Int is 0 and an ExplicitlyTypedValue with type 0 is an Int
+    return classesCount == 0 || vm->stringClassId > 0;
 }
 
 void freeVM(VM* vm) {
-    COMPILER_MEM_FREE(int, vm->classNamesLength);
-    for (int i=0;i<vm->classesCount;i++) {
-        COMPILER_MEM_FREE(char, vm->classNamesArray[i]);
-    }
-    COMPILER_MEM_FREE(char*, vm->classNamesArray);
+    freeVMClasses(vm);
+    freeHeap(&vm->heap);
+    COMPILER_FREE_ARRAY(uint64_t, vm->stack);
+    COMPILER_FREE_ARRAY(CallFrame, vm->frames);
+    COMPILER_FREE_ARRAY(uint32_t, vm->potentialObjectsOnStackList);
+    COMPILER_FREE_ARRAY(uint8_t, vm->privateCode);
+    COMPILER_FREE_ARRAY(char, vm->outputBuffer);
     vm = realloc(vm, 0);
 }
 
+char* takeVMOutput(VM* vm, size_t* length) {
+    char* output = vm->outputBuffer;
+    *length = vm->outputLength;
+    vm->outputBuffer = NULL;
+    vm->outputLength = 0;
+    vm->outputCapacity = 0;
+    return output;
+}
+
+void writeOutput(VM* vm, const char* format, ...) {
+    va_list arguments;
+    va_start(arguments, format);
+    if (!vm->bufferOutput) {
+        vprintf(format, arguments);
+        va_end(arguments);
+        return;
+    }
+    va_list retryArguments;
+    va_copy(retryArguments, arguments);
+    size_t available = vm->outputCapacity-vm->outputLength;
+    size_t length = vsnprintf(vm->outputBuffer == NULL ? NULL : vm->outputBuffer+vm->outputLength, available, format, arguments);
+    if (length+1 > available) {
+        size_t newOutputCapacity = GROW_CAPACITY(vm->outputCapacity);
+        while (newOutputCapacity < vm->outputLength+length+1) {
+            newOutputCapacity = GROW_CAPACITY(newOutputCapacity);
+        }
+        vm->outputBuffer = COMPILER_GROW_ARRAY(char, vm->outputBuffer, newOutputCapacity);
+        vm->outputCapacity = newOutputCapacity;
+        vsnprintf(vm->outputBuffer+vm->outputLength, length+1, format, retryArguments);
+    }
+    vm->outputLength += length;
+    va_end(retryArguments);
+    va_end(arguments);
+}
+
 inline void push(VM* vm, void* value) {
     *vm->stackTop = *(uint64_t*)value;
     vm->stackTop++;
@@ -78,6 +177,12 @@ inline static uint64_t readLong(VM* vm) {
     return val;
 }
 
+inline static uint16_t read2Byte(VM* vm) {
+    uint16_t val = *(uint16_t*)(vm->ip);
+    vm->ip+=2;
+    return val;
+}
+
 inline static uint32_t read4Byte(VM* vm) {
     uint32_t val = *(uint32_t*)(vm->ip);
     vm->ip+=4;
@@ -97,7 +202,12 @@ inline static void willAddPotentialObjectOnStack(VM* vm) {
 
 inline static void popExplicitlyTypedValueOnStack(VM* vm) {
     popCount(vm, 2);
-    vm->potentialObjectsOnStackListCount--;
+    // a value put on the stack a word at a time, like one read back from two frame slots, never got an entry, so the entries are dropped
+    // by where they are on the stack rather than by count
+    const uint32_t index = (uint32_t)(vm->stackTop - vm->stack);
+    while (vm->potentialObjectsOnStackListCount > 0 && vm->potentialObjectsOnStackList[vm->potentialObjectsOnStackListCount-1] >= index) {
+        vm->potentialObjectsOnStackListCount--;
+    }
 }
 
 inline static ExplicitlyTypedValue peekExplicitlyTypedValueOnStack(VM* vm, int longsDown) {
@@ -107,18 +217,375 @@ inline static ExplicitlyTypedValue peekExplicitlyTypedValueOnStack(VM* vm, int l
     return result;
 }
 
+inline static void pushExplicitlyTypedValueOnStack(VM* vm, ExplicitlyTypedValue value) {
+    willAddPotentialObjectOnStack(vm);
+    memcpy(vm->stackTop, &value, 16);
+    vm->stackTop+=2;
+}
+
 inline static ObjString peekStringOnStack(VM* vm, int longsDown) {
     ExplicitlyTypedValue explicitlyTypedValue = peekExplicitlyTypedValueOnStack(vm, longsDown);
     return *((ObjString*)explicitlyTypedValue.as.object);
 }
 
-static void run(VM* vm) {
+// quickening: the Any opcodes look at the types of their operands when they run and rewrite their own opcode byte into a variant
+// specialised for those types, whose only work besides the operation itself is a guard on the types. when a guard fails, the site
+// runs the generic path and is rewritten back, and every Any opcode carries one operand byte counting how often that has happened
+// so that a site whose types keep changing settles on the generic opcode instead of flipping back and forth.
+#ifdef QUICKENING_STATS
+#define COUNT_QUICKENING(counter) (vm->quickeningStats.counter++)
+#else
+#define COUNT_QUICKENING(counter)
+#endif
+
+inline static void quickenSite(VM* vm, uint8_t* site, uint8_t specialisedOp) {
+    (void)vm; // only counted with QUICKENING_STATS
+    if (site[1] < QUICKENING_MAX_DEOPTS) {
+        *site = specialisedOp;
+        COUNT_QUICKENING(rewrites);
+    }
+}
+
+inline static void deoptimizeSite(VM* vm, uint8_t* site, uint8_t genericOp) {
+    (void)vm; // only counted with QUICKENING_STATS
+    *site = genericOp;
+    if (site[1] < UINT8_MAX) {
+        site[1]++;
+    }
+    COUNT_QUICKENING(guardFailures);
+    COUNT_QUICKENING(rewrites);
+}
+
+inline static bool isStringValue(VM* vm, ExplicitlyTypedValue value) {
+    return value.arrayDepth == 0 && value.type == vm->stringClassId;
+}
+
+inline static bool isNumberValue(ExplicitlyTypedValue value) {
+    return value.arrayDepth == 0 && (TYPED_VAL_IS_OF_INT(value) || TYPED_VAL_IS_OF_DOUBLE(value));
+}
+
+inline static double numberValueAsDouble(ExplicitlyTypedValue value) {
+    return TYPED_VAL_IS_OF_INT(value) ? (double)TYPED_VAL_AS_INT_SCALAR(value) : TYPED_VAL_AS_DOUBLE_SCALAR(value);
+}
+
+// stops the program and makes interpret return INTERPRET_RUNTIME_ERROR
+static void runtimeError(VM* vm, const char* message) {
+    vm->runtimeErrorMessage = message;
+    if (!vm->bufferOutput) {
+        fflush(stdout);
+        fprintf(stderr, "Runtime error: %s\n", message);
+    }
+    longjmp(vm->runtimeErrorJump, 1);
+}
+
+// every object the program allocates goes through here, so that an allocation the heap can't fit ends the program with a runtime error
+// instead of taking down the process
+static void* checkAllocation(VM* vm, void* object) {
+    if (object == NULL) {
+        runtimeError(vm, vm->heap.bytesLimit == 0 ? "Out of memory" : "Out of memory: the program went over its heap limit");
+    }
+    return object;
+}
+
+// calls are made without recursing in C: a call pushes a frame onto vm->frames and jumps to the callee, and returning pops it and jumps back.
+// a call in tail position reuses the frame of the function making it, so tail recursion runs in constant space
+
+// makes room for `words` words above the innermost call's slots. the stack moves when it grows, so everything pointing into it is rebased
+static void growStack(VM* vm, size_t words) {
+    size_t slotsIndex = vm->slots-vm->stack;
+    size_t stackTopIndex = vm->stackTop-vm->stack;
+    if (slotsIndex+words > STACK_MAX_WORDS) {
+        runtimeError(vm, "Stack overflow");
+    }
+    size_t newStackCapacity = vm->stackCapacity;
+    while (newStackCapacity < slotsIndex+words) {
+        newStackCapacity *= 2;
+    }
+    if (newStackCapacity > STACK_MAX_WORDS) {
+        newStackCapacity = STACK_MAX_WORDS;
+    }
+    uint64_t* newStack = COMPILER_GROW_ARRAY(uint64_t, vm->stack, newStackCapacity);
+    if (newStack == NULL) {
+        runtimeError(vm, "Out of memory");
+    }
+    vm->stack = newStack;
+    vm->stackCapacity = newStackCapacity;
+    vm->slots = vm->stack+slotsIndex;
+    vm->stackTop = vm->stack+stackTopIndex;
+}
+
+inline static void reserveFrame(VM* vm, size_t words) {
+    if ((size_t)(vm->slots-vm->stack)+words > vm->stackCapacity) {
+        growStack(vm, words);
+    }
+}
+
+// the callee's slots start at its arguments, which are the top argumentWords words of the stack
+static void pushFrame(VM* vm, uint8_t argumentWords) {
+    if (vm->frameCount == vm->frameCapacity) {
+        if (vm->frameCount >= FRAMES_MAX) {
+            runtimeError(vm, "Stack overflow");
+        }
+        int newFrameCapacity = GROW_CAPACITY(vm->frameCapacity);
+        CallFrame* newFrames = COMPILER_GROW_ARRAY(CallFrame, vm->frames, newFrameCapacity);
+        if (newFrames == NULL) {
+            runtimeError(vm, "Out of memory");
+        }
+        vm->frames = newFrames;
+        vm->frameCapacity = newFrameCapacity;
+    }
+    vm->frames[vm->frameCount] = (CallFrame){vm->ip, vm->slots-vm->stack};
+    vm->frameCount++;
+    vm->slots = vm->stackTop-argumentWords;
+}
+
+// moves the top `words` words of the stack down to `to` and drops everything that was in between, which is how a call gets rid of its
+// frame when it returns or makes a tail call. the moved explicitly typed values take their potentialObjectsOnStackList entries along
+static void moveStackTopDown(VM* vm, uint64_t* to, int words) {
+    uint64_t* from = vm->stackTop-words;
+    memmove(to, from, words*sizeof(uint64_t));
+    vm->stackTop = to+words;
+    
+    // the list is in stack order, so the entries that move and the ones that get dropped are all at its end
+    const uint32_t toIndex = (uint32_t)(to-vm->stack);
+    const uint32_t fromIndex = (uint32_t)(from-vm->stack);
+    uint32_t* list = vm->potentialObjectsOnStackList;
+    uint32_t count = vm->potentialObjectsOnStackListCount;
+    uint32_t firstMoved = count;
+    while (firstMoved > 0 && list[firstMoved-1] >= fromIndex) {
+        firstMoved--;
+    }
+    uint32_t firstDropped = firstMoved;
+    while (firstDropped > 0 && list[firstDropped-1] >= toIndex) {
+        firstDropped--;
+    }
+    for (uint32_t i=firstMoved;i<count;i++) {
+        list[firstDropped+i-firstMoved] = list[i]-(fromIndex-toIndex);
+    }
+    vm->potentialObjectsOnStackListCount = firstDropped+count-firstMoved;
+}
+
+// pops the instance a field opcode works on, which is an ExplicitlyTypedValue whose type is the class it is statically known as. that
+// might be a superclass of the class it was allocated as, which is fine since a subclass's layout starts with its superclass's
+static ObjInstance* popInstanceForFieldAccess(VM* vm) {
+    ObjInstance* instance = peekExplicitlyTypedValueOnStack(vm, 0).as.object;
+    popExplicitlyTypedValueOnStack(vm);
+    if (instance == NULL) {
+        runtimeError(vm, "Accessing a field of an instance that was never set");
+    }
+    return instance;
+}
+
+// the generic path of OP_addAny, OP_minusAny and OP_multiplyAny. `site` is the opcode to quicken, or NULL when this is the fallback
+// of a failed guard, which shouldn't specialise the site again straight away
+static void anyBinaryOp(VM* vm, uint8_t genericOp, uint8_t* site) {
+    COUNT_QUICKENING(genericExecutions);
+    ExplicitlyTypedValue b = peekExplicitlyTypedValueOnStack(vm, 0);
+    ExplicitlyTypedValue a = peekExplicitlyTypedValueOnStack(vm, 2);
+    popExplicitlyTypedValueOnStack(vm);
+    popExplicitlyTypedValueOnStack(vm);
+    
+    ExplicitlyTypedValue result;
+    uint8_t specialisedOp;
+    if (a.arrayDepth == 0 && b.arrayDepth == 0 && TYPED_VAL_IS_OF_INT(a) && TYPED_VAL_IS_OF_INT(b)) {
+        long lhs = TYPED_VAL_AS_INT_SCALAR(a);
+        long rhs = TYPED_VAL_AS_INT_SCALAR(b);
+        switch (genericOp) {
+            case OP_addAny: result = TYPED_VAL_FROM_INT_SCALAR(lhs + rhs); specialisedOp = OP_addAnyInt; break;
+            case OP_minusAny: result = TYPED_VAL_FROM_INT_SCALAR(lhs - rhs); specialisedOp = OP_minusAnyInt; break;
+            default: result = TYPED_VAL_FROM_INT_SCALAR(lhs * rhs); specialisedOp = OP_multiplyAnyInt; break;
+        }
+    } else if (isNumberValue(a) && isNumberValue(b)) {
+        double lhs = numberValueAsDouble(a);
+        double rhs = numberValueAsDouble(b);
+        switch (genericOp) {
+            case OP_addAny: result = TYPED_VAL_FROM_DOUBLE_SCALAR(lhs + rhs); specialisedOp = OP_addAnyDouble; break;
+            case OP_minusAny: result = TYPED_VAL_FROM_DOUBLE_SCALAR(lhs - rhs); specialisedOp = OP_minusAnyDouble; break;
+            default: result = TYPED_VAL_FROM_DOUBLE_SCALAR(lhs * rhs); specialisedOp = OP_multiplyAnyDouble; break;
+        }
+        // the double variants only guard for two doubles, so a mix of an Int and a Double stays generic
+        if (!(TYPED_VAL_IS_OF_DOUBLE(a) && TYPED_VAL_IS_OF_DOUBLE(b))) {
+            specialisedOp = genericOp;
+        }
+    } else if (genericOp == OP_addAny && isStringValue(vm, a) && isStringValue(vm, b)) {
+        result = TYPED_VAL_FROM_OBJECT_SCALAR(vm->stringClassId, checkAllocation(vm, concatenateStrings(&vm->heap, a.as.object, b.as.object)));
+        specialisedOp = OP_addAnyString;
+    } else {
+        runtimeError(vm, "Unsupported operand types for binary operator");
+        return;
+    }
+    pushExplicitlyTypedValueOnStack(vm, result);
+    if (site != NULL && specialisedOp != genericOp) {
+        quickenSite(vm, site, specialisedOp);
+    }
+}
+
+static void outputExplicitlyTypedValue(VM* vm, ExplicitlyTypedValue value) {
+    if (value.arrayDepth != 0) {
+        // nothing in the VM creates arrays yet, so there is nothing to print one from
+        runtimeError(vm, "Outputting arrays is not supported by the VM yet");
+    } else if (TYPED_VAL_IS_OF_INT(value)) {
+        writeOutput(vm, "%li\n", TYPED_VAL_AS_INT_SCALAR(value));
+    } else if (TYPED_VAL_IS_OF_DOUBLE(value)) {
+        writeOutput(vm, "%f\n", TYPED_VAL_AS_DOUBLE_SCALAR(value));
+    } else if (TYPED_VAL_IS_OF_BOOLEAN(value)) {
+        writeOutput(vm, "%s\n", TYPED_VAL_AS_BOOLEAN_SCALAR(value) ? "true" : "false");
+    } else if (isStringValue(vm, value)) {
+        ObjString* string = TYPED_VAL_AS_OBJECT_SCALAR(value);
+        writeOutput(vm, "%.*s\n", (int)string->length, string->data);
+    } else if (TYPED_VAL_IS_OF_OBJECT(value)) {
+        writeOutput(vm, "<Instance of %.*s>\n", vm->classNamesLength[value.type], vm->classNamesArray[value.type]);
+    }
+}
+
+// the generic path of OP_outputAny, see anyBinaryOp
+static void anyOutput(VM* vm, uint8_t* site) {
+    COUNT_QUICKENING(genericExecutions);
+    ExplicitlyTypedValue value = peekExplicitlyTypedValueOnStack(vm, 0);
+    popExplicitlyTypedValueOnStack(vm);
+    outputExplicitlyTypedValue(vm, value);
+    if (site == NULL || value.arrayDepth != 0) {
+        return;
+    }
+    if (TYPED_VAL_IS_OF_INT(value)) {
+        quickenSite(vm, site, OP_outputAnyInt);
+    } else if (TYPED_VAL_IS_OF_DOUBLE(value)) {
+        quickenSite(vm, site, OP_outputAnyDouble);
+    } else if (TYPED_VAL_IS_OF_BOOLEAN(value)) {
+        quickenSite(vm, site, OP_outputAnyBoolean);
+    } else if (isStringValue(vm, value)) {
+        quickenSite(vm, site, OP_outputAnyString);
+    }
+}
+
+void setVMBudget(VM* vm, uint64_t safepoints, double seconds) {
+    vm->safepointBudget = safepoints;
+    vm->secondsBudget = seconds;
+}
+
+void setVMHeapLimit(VM* vm, size_t bytes) {
+    vm->heap.bytesLimit = bytes;
+}
+
+void requestInterrupt(VM* vm) {
+    atomic_store_explicit(&vm->interruptRequested, true, memory_order_relaxed);
+}
+
+static double monotonicSeconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+static void startSafepointSlice(VM* vm) {
+    vm->safepointSlice = SAFEPOINT_INTERVAL;
+    if (vm->safepointBudget != 0 && vm->safepointsLeft < SAFEPOINT_INTERVAL) {
+        vm->safepointSlice = (uint32_t)vm->safepointsLeft;
+    }
+    vm->safepointCountdown = vm->safepointSlice;
+}
+
+static void startRunBudget(VM* vm) {
+    vm->safepointsLeft = vm->safepointBudget;
+    vm->deadline = vm->secondsBudget == 0 ? 0 : monotonicSeconds()+vm->secondsBudget;
+    startSafepointSlice(vm);
+}
+
+InterpretResult checkSafepoint(VM* vm) {
+    if (vm->safepointBudget != 0) {
+        vm->safepointsLeft -= vm->safepointSlice;
+    }
+    if (atomic_load_explicit(&vm->interruptRequested, memory_order_relaxed)) {
+        atomic_store_explicit(&vm->interruptRequested, false, memory_order_relaxed);
+        return INTERPRET_INTERRUPTED;
+    }
+    if ((vm->safepointBudget != 0 && vm->safepointsLeft == 0) || (vm->deadline != 0 && monotonicSeconds() >= vm->deadline)) {
+        return INTERPRET_OUT_OF_BUDGET;
+    }
+    startSafepointSlice(vm);
+    return INTERPRET_OK;
+}
+
+// input is parsed the same way the tree-walk interpreter parses it, where the whole line has to be the number
+static bool parseInputInt(const ObjString* input, long* result) {
+    const char* chars = (const char*)input->data;
+    if (input->length == 0 || isspace(chars[0])) {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    long value = strtol(chars, &end, 10);
+    if (errno != 0 || end != chars+input->length) {
+        return false;
+    }
+    *result = value;
+    return true;
+}
+
+static bool parseInputDouble(const ObjString* input, double* result) {
+    const char* chars = (const char*)input->data;
+    if (input->length == 0 || isspace(chars[0])) {
+        return false;
+    }
+    char* end;
+    double value = strtod(chars, &end);
+    if (end != chars+input->length) {
+        return false;
+    }
+    *result = value;
+    return true;
+}
+
+static void pushInput(VM* vm, uint8_t instruction) {
+    ObjString* input = vm->input;
+    vm->input = NULL;
+    if (vm->stringClassId <= 0 && (instruction == OP_inputString || instruction == OP_inputAny)) {
+        // the line might have to be pushed as a String, which needs its class id
+        runtimeError(vm, "Cannot read input as a String without the String class");
+    }
+    long intValue;
+    double doubleValue;
+    switch (instruction) {
+        case OP_inputInt:
+            if (parseInputInt(input, &intValue)) {
+                push(vm, &intValue);
+            } else if (parseInputDouble(input, &doubleValue)) {
+                intValue = (long)doubleValue;
+                push(vm, &intValue);
+            } else {
+                runtimeError(vm, "Cannot cast input to type Int");
+            }
+            break;
+        case OP_inputDouble:
+            if (!parseInputDouble(input, &doubleValue)) {
+                runtimeError(vm, "Cannot cast input to type Double");
+            }
+            push(vm, &doubleValue);
+            break;
+        case OP_inputString:
+            pushExplicitlyTypedValueOnStack(vm, TYPED_VAL_FROM_OBJECT_SCALAR(vm->stringClassId, input));
+            break;
+        default:
+            // Any takes an Int if the line reads as one, then a Double, and otherwise the line as a String
+            if (parseInputInt(input, &intValue)) {
+                pushExplicitlyTypedValueOnStack(vm, TYPED_VAL_FROM_INT_SCALAR(intValue));
+            } else if (parseInputDouble(input, &doubleValue)) {
+                pushExplicitlyTypedValueOnStack(vm, TYPED_VAL_FROM_DOUBLE_SCALAR(doubleValue));
+            } else {
+                pushExplicitlyTypedValueOnStack(vm, TYPED_VAL_FROM_OBJECT_SCALAR(vm->stringClassId, input));
+            }
+            break;
+    }
+}
+
+static InterpretResult run(VM* vm) {
 #define READ_INSTRUCTION_BYTE() (*(vm->ip++))
 #define READ_LONG() (*(long*)popByReference(vm))
 #define READ_DOUBLE() (*(double*)popByReference(vm))
 #define READ_BOOL() (READ_DOUBLE() != 0)
 #define READ_CONSTANT() (&(vm->chunk->constants[READ_INSTRUCTION_BYTE()]))
 #define READ_LONG_CONSTANT() (&(vm->chunk->constants[read4Byte(vm)]))
+#define READ_SLOT() (vm->slots[READ_INSTRUCTION_BYTE()])
     
 #ifdef DEBUG_TRACE_EXECUTION
     int lineInformationIndex = 0;
@@ -136,14 +603,17 @@ static void run(VM* vm) {
         
         int lineNumber=0;
         bool showLineNumber = false;
-        int bytecodeLine = (int)(vm->ip - vm->chunk->code);
+        int bytecodeLine = (int)(vm->ip - vm->code);
         if (lineInformationIndex < vm->chunk->lineInformationCount && bytecodeLine == vm->chunk->lineInformation[lineInformationIndex].correspondingBytecodeIndex) {
             lineNumber = vm->chunk->lineInformation[lineInformationIndex].line;
             showLineNumber = true;
             lineInformationIndex++;
         }
         
-        disassembleInstruction(vm->classNamesArray, vm->chunk, (int)(vm->ip-vm->chunk->code), lineNumber, showLineNumber);
+        // the VM runs its own copy of the code, which quickening rewrites, so that is what gets disassembled
+        Chunk runningChunk = *vm->chunk;
+        runningChunk.code = vm->code;
+        disassembleInstruction((const char**)vm->classNamesArray, &runningChunk, (int)(vm->ip-vm->code), lineNumber, showLineNumber);
 #endif
         
 #define INT_BINARY_OP(op) \
@@ -158,6 +628,66 @@ do { \
     double result = (*((double*)topByReference(vm))) op b; \
     modifyTopInPlace(vm, &result); \
 } while (false)
+// the guarded fast path of a quickened Any opcode, whose site starts at the opcode byte that was just read
+#define QUICKENED_ANY_BINARY_OP(genericOp, guard, result) \
+do { \
+    uint8_t* site = vm->ip-1; \
+    vm->ip++; \
+    ExplicitlyTypedValue b = peekExplicitlyTypedValueOnStack(vm, 0); \
+    ExplicitlyTypedValue a = peekExplicitlyTypedValueOnStack(vm, 2); \
+    if (a.arrayDepth == 0 && b.arrayDepth == 0 && guard(a) && guard(b)) { \
+        COUNT_QUICKENING(specialisedHits); \
+        popExplicitlyTypedValueOnStack(vm); \
+        popExplicitlyTypedValueOnStack(vm); \
+        pushExplicitlyTypedValueOnStack(vm, result); \
+    } else { \
+        deoptimizeSite(vm, site, genericOp); \
+        anyBinaryOp(vm, genericOp, NULL); \
+    } \
+} while (false)
+#define QUICKENED_ANY_OUTPUT(guard, format, ...) \
+do { \
+    uint8_t* site = vm->ip-1; \
+    vm->ip++; \
+    ExplicitlyTypedValue value = peekExplicitlyTypedValueOnStack(vm, 0); \
+    if (value.arrayDepth == 0 && guard(value)) { \
+        COUNT_QUICKENING(specialisedHits); \
+        popExplicitlyTypedValueOnStack(vm); \
+        writeOutput(vm, format, __VA_ARGS__); \
+    } else { \
+        deoptimizeSite(vm, site, OP_outputAny); \
+        anyOutput(vm, NULL); \
+    } \
+} while (false)
+#define IS_STRING_VALUE(value) isStringValue(vm, value)
+// has to come right after the opcode is read, so that a program stopped here runs the whole instruction when it is resumed
+#define SAFEPOINT() \
+do { \
+    vm->safepointCountdown--; \
+    if (vm->safepointCountdown == 0) { \
+        InterpretResult stopReason = checkSafepoint(vm); \
+        if (stopReason != INTERPRET_OK) { \
+            vm->ip--; \
+            return stopReason; \
+        } \
+    } \
+} while (false)
+#ifdef USE_JIT
+// goes after a backward branch or a call has moved ip to a loop header or function entry. counts the arrival and, once the code from there
+// is compiled, runs it natively up to where it hands the program back
+#define TIER_UP() \
+do { \
+    JitFunction native = jitFunctionAt(vm->chunk, (int)(vm->ip-vm->code)); \
+    if (native != NULL) { \
+        InterpretResult nativeResult = native(vm); \
+        if (nativeResult != INTERPRET_OK) { \
+            return nativeResult; \
+        } \
+    } \
+} while (false)
+#else
+#define TIER_UP()
+#endif
 #define BOOL_BINARY_OP(op) \
 do { \
     bool b = READ_BOOL(); \
@@ -168,7 +698,7 @@ do { \
         uint8_t instruction;
         switch (instruction = READ_INSTRUCTION_BYTE()) {
             case OP_return: {
-                return;
+                return INTERPRET_OK;
             }
             case OP_true: {
                 long val = 1;
@@ -232,8 +762,9 @@ do { \
                 break;
             }
             case OP_notBool: {
-                bool val = !READ_BOOL();
-                modifyTopInPlace(vm, &val);
+                long val = !READ_BOOL();
+                push(vm, &val);
+                break;
             }
             case OP_greaterInt: {
                 INT_BINARY_OP(>);
@@ -370,58 +901,350 @@ do { \
             }
             case OP_outputInt: {
                 long val = READ_LONG();
-                printf("%li\n", val);
+                writeOutput(vm, "%li\n", val);
                 break;
             }
             case OP_outputDouble: {
                 double val = READ_DOUBLE();
-                printf("%f\n", val);
+                writeOutput(vm, "%f\n", val);
                 break;
             }
             case OP_outputBoolean: {
                 bool val = READ_BOOL();
-                printf("%s\n", val ? "true" : "false");
+                writeOutput(vm, "%s\n", val ? "true" : "false");
                 break;
             }
             case OP_outputString: {
                 ObjString str = peekStringOnStack(vm, 0);
-                printf("%s\n", str.data);
+                writeOutput(vm, "%.*s\n", (int)str.length, str.data);
                 popExplicitlyTypedValueOnStack(vm);
                 break;
             }
             case OP_outputArray: {
-                
+                runtimeError(vm, "Outputting arrays is not supported by the VM yet");
+                break;
             }
             case OP_outputAny: {
-                
+                uint8_t* site = vm->ip-1;
+                vm->ip++;
+                anyOutput(vm, site);
+                break;
             }
             case OP_outputClass: {
-                
+                ExplicitlyTypedValue value = peekExplicitlyTypedValueOnStack(vm, 0);
+                popExplicitlyTypedValueOnStack(vm);
+                outputExplicitlyTypedValue(vm, value);
+                break;
             }
             case OP_outputVoid: {
-                
+                // the result of a function that doesn't return a value, which the interpreter prints as nil
+                writeOutput(vm, "nil\n");
+                break;
+            }
+            case OP_jump: {
+                uint16_t offset = read2Byte(vm);
+                vm->ip += offset;
+                break;
+            }
+            case OP_jumpIfFalse: {
+                uint16_t offset = read2Byte(vm);
+                if (!READ_BOOL()) {
+                    vm->ip += offset;
+                }
+                break;
+            }
+            case OP_loop: {
+                SAFEPOINT();
+                uint16_t offset = read2Byte(vm);
+                vm->ip -= offset;
+                TIER_UP();
+                break;
+            }
+            case OP_getLocal: {
+                push(vm, &READ_SLOT());
+                break;
+            }
+            case OP_setLocal: {
+                READ_SLOT() = pop(vm);
+                break;
+            }
+            case OP_countedLoop: {
+                // the back edge of a loop from statement in a single dispatch: step the counter, copy it into the loop variable and branch
+                // back to the start of the body, or fall through once the counter has reached the bound
+                SAFEPOINT();
+                long* counter = (long*)&READ_SLOT();
+                long bound = *(long*)&READ_SLOT();
+                uint64_t* variable = &READ_SLOT();
+                uint16_t offset = read2Byte(vm);
+                if (*counter < bound) {
+                    (*counter)++;
+                    *variable = *counter;
+                    vm->ip -= offset;
+                    TIER_UP();
+                }
+                break;
+            }
+            case OP_addAny:
+            case OP_minusAny:
+            case OP_multiplyAny: {
+                uint8_t* site = vm->ip-1;
+                vm->ip++;
+                anyBinaryOp(vm, instruction, site);
+                break;
+            }
+            case OP_addAnyInt: {
+                QUICKENED_ANY_BINARY_OP(OP_addAny, TYPED_VAL_IS_OF_INT, TYPED_VAL_FROM_INT_SCALAR(a.as.qsInt + b.as.qsInt));
+                break;
+            }
+            case OP_addAnyDouble: {
+                QUICKENED_ANY_BINARY_OP(OP_addAny, TYPED_VAL_IS_OF_DOUBLE, TYPED_VAL_FROM_DOUBLE_SCALAR(a.as.qsDouble + b.as.qsDouble));
+                break;
+            }
+            case OP_addAnyString: {
+                QUICKENED_ANY_BINARY_OP(OP_addAny, IS_STRING_VALUE, TYPED_VAL_FROM_OBJECT_SCALAR(vm->stringClassId, checkAllocation(vm, concatenateStrings(&vm->heap, a.as.object, b.as.object))));
+                break;
+            }
+            case OP_minusAnyInt: {
+                QUICKENED_ANY_BINARY_OP(OP_minusAny, TYPED_VAL_IS_OF_INT, TYPED_VAL_FROM_INT_SCALAR(a.as.qsInt - b.as.qsInt));
+                break;
+            }
+            case OP_minusAnyDouble: {
+                QUICKENED_ANY_BINARY_OP(OP_minusAny, TYPED_VAL_IS_OF_DOUBLE, TYPED_VAL_FROM_DOUBLE_SCALAR(a.as.qsDouble - b.as.qsDouble));
+                break;
+            }
+            case OP_multiplyAnyInt: {
+                QUICKENED_ANY_BINARY_OP(OP_multiplyAny, TYPED_VAL_IS_OF_INT, TYPED_VAL_FROM_INT_SCALAR(a.as.qsInt * b.as.qsInt));
+                break;
+            }
+            case OP_multiplyAnyDouble: {
+                QUICKENED_ANY_BINARY_OP(OP_multiplyAny, TYPED_VAL_IS_OF_DOUBLE, TYPED_VAL_FROM_DOUBLE_SCALAR(a.as.qsDouble * b.as.qsDouble));
+                break;
+            }
+            case OP_outputAnyInt: {
+                QUICKENED_ANY_OUTPUT(TYPED_VAL_IS_OF_INT, "%li\n", value.as.qsInt);
+                break;
+            }
+            case OP_outputAnyDouble: {
+                QUICKENED_ANY_OUTPUT(TYPED_VAL_IS_OF_DOUBLE, "%f\n", value.as.qsDouble);
+                break;
+            }
+            case OP_outputAnyBoolean: {
+                QUICKENED_ANY_OUTPUT(TYPED_VAL_IS_OF_BOOLEAN, "%s\n", value.as.qsBoolean ? "true" : "false");
+                break;
+            }
+            case OP_outputAnyString: {
+                QUICKENED_ANY_OUTPUT(IS_STRING_VALUE, "%.*s\n", (int)((ObjString*)value.as.object)->length, ((ObjString*)value.as.object)->data);
+                break;
+            }
+            case OP_inputInt:
+            case OP_inputDouble:
+            case OP_inputString:
+            case OP_inputAny: {
+                if (vm->input == NULL) {
+                    // suspend with ip on the input instruction, which runs again once resumeWithInput has handed over the line
+                    vm->ip--;
+                    return INTERPRET_NEEDS_INPUT;
+                }
+                pushInput(vm, instruction);
+                break;
+            }
+            case OP_call: {
+                SAFEPOINT();
+                uint32_t entry = read4Byte(vm);
+                uint8_t argumentWords = READ_INSTRUCTION_BYTE();
+                uint16_t localsCount = read2Byte(vm);
+                pushFrame(vm, argumentWords);
+                reserveFrame(vm, localsCount+FRAME_TEMPORARIES_WORDS);
+                vm->stackTop = vm->slots+localsCount;
+                vm->ip = vm->code+entry;
+                TIER_UP();
+                break;
+            }
+            case OP_tailCall: {
+                SAFEPOINT();
+                uint32_t entry = read4Byte(vm);
+                uint8_t argumentWords = READ_INSTRUCTION_BYTE();
+                uint16_t localsCount = read2Byte(vm);
+                // the arguments take the place of the caller's slots, so the caller's frame becomes the callee's
+                moveStackTopDown(vm, vm->slots, argumentWords);
+                reserveFrame(vm, localsCount+FRAME_TEMPORARIES_WORDS);
+                vm->stackTop = vm->slots+localsCount;
+                vm->ip = vm->code+entry;
+                TIER_UP();
+                break;
+            }
+            case OP_returnValue: {
+                uint8_t resultWords = READ_INSTRUCTION_BYTE();
+                if (vm->frameCount == 0) {
+                    // a return outside of any call ends the program
+                    return INTERPRET_OK;
+                }
+                // the result takes the place of the arguments
+                moveStackTopDown(vm, vm->slots, resultWords);
+                vm->frameCount--;
+                vm->slots = vm->stack+vm->frames[vm->frameCount].callerSlots;
+                vm->ip = vm->frames[vm->frameCount].returnAddress;
+                break;
+            }
+            case OP_allocateInstance: {
+                int classId = read4Byte(vm);
+                uint16_t fieldWords = read2Byte(vm);
+                pushExplicitlyTypedValueOnStack(vm, TYPED_VAL_FROM_OBJECT_SCALAR(classId, checkAllocation(vm, allocateInstance(&vm->heap, classId, fieldWords))));
+                break;
+            }
+            case OP_getField: {
+                uint16_t fieldOffset = read2Byte(vm);
+                ObjInstance* instance = popInstanceForFieldAccess(vm);
+                push(vm, &instance->fields[fieldOffset]);
+                break;
+            }
+            case OP_setField: {
+                uint16_t fieldOffset = read2Byte(vm);
+                uint64_t value = pop(vm);
+                ObjInstance* instance = popInstanceForFieldAccess(vm);
+                instance->fields[fieldOffset] = value;
+                break;
+            }
+            case OP_getFieldExplicitlyTyped: {
+                uint16_t fieldOffset = read2Byte(vm);
+                ObjInstance* instance = popInstanceForFieldAccess(vm);
+                ExplicitlyTypedValue value;
+                memcpy(&value, &instance->fields[fieldOffset], 16);
+                pushExplicitlyTypedValueOnStack(vm, value);
+                break;
+            }
+            case OP_setFieldExplicitlyTyped: {
+                uint16_t fieldOffset = read2Byte(vm);
+                ExplicitlyTypedValue value = peekExplicitlyTypedValueOnStack(vm, 0);
+                popExplicitlyTypedValueOnStack(vm);
+                ObjInstance* instance = popInstanceForFieldAccess(vm);
+                memcpy(&instance->fields[fieldOffset], &value, 16);
+                break;
             }
         }
     }
     
+#undef QUICKENED_ANY_BINARY_OP
+#undef QUICKENED_ANY_OUTPUT
+#undef IS_STRING_VALUE
+#undef SAFEPOINT
+#undef TIER_UP
 #undef INT_BINARY_OP
 #undef READ_CONSTANT
+#undef READ_SLOT
 #undef READ_INSTRUCTION_BYTE
 #undef READ_LONG
 #undef READ_DOUBLE
 #undef READ_BOOL
 }
 
-void interpret(VM* vm, Chunk* chunk) {
+// quickening rewrites opcodes in place, which a finalised chunk doesn't allow, so VMs run their own copy of a finalised chunk's code
+static void useChunkCode(VM* vm, Chunk* chunk) {
+    if (!chunk->finalised) {
+        vm->code = chunk->code;
+        return;
+    }
+    if (vm->privateCodeCapacity < chunk->codeCount) {
+        vm->privateCode = COMPILER_GROW_ARRAY(uint8_t, vm->privateCode, chunk->codeCount);
+        vm->privateCodeCapacity = chunk->codeCount;
+    }
+    memcpy(vm->privateCode, chunk->code, chunk->codeCount);
+    vm->code = vm->privateCode;
+}
+
+static void reportFinishedRun(VM* vm, InterpretResult result) {
+    if (result == INTERPRET_NEEDS_INPUT) {
+        vm->runState = VM_NEEDS_INPUT;
+        return;
+    }
+    if (result == INTERPRET_INTERRUPTED || result == INTERPRET_OUT_OF_BUDGET) {
+        vm->runState = VM_STOPPED;
+        return;
+    }
+    vm->runState = VM_IDLE;
+#ifdef HEAP_STATS
+    printf("Heap: %zu objects, %zu bytes, %zu bytes at the high-water mark", vm->heap.objectsAllocated, vm->heap.bytesAllocated, vm->heap.peakBytesAllocated);
+    if (vm->heap.bytesLimit != 0) {
+        printf(" (%.1f%% of the %zu byte limit)", 100.0*vm->heap.peakBytesAllocated/vm->heap.bytesLimit, vm->heap.bytesLimit);
+    }
+    printf("\n\n");
+#endif
+#ifdef QUICKENING_STATS
+    QuickeningStats stats = vm->quickeningStats;
+    uint64_t anyExecutions = stats.specialisedHits + stats.genericExecutions;
+    printf("Quickening: %llu specialised hits, %llu generic executions, %llu guard failures, %llu rewrites (%.2f%% hit rate)\n\n",
+           (unsigned long long)stats.specialisedHits,
+           (unsigned long long)stats.genericExecutions,
+           (unsigned long long)stats.guardFailures,
+           (unsigned long long)stats.rewrites,
+           anyExecutions == 0 ? 0.0 : 100.0*stats.specialisedHits/anyExecutions);
+#endif
+}
+
+InterpretResult interpret(VM* vm, Chunk* chunk) {
 #ifdef TIME_EXECUTION
     clock_t start, end;
     start = clock();
 #endif
     vm->chunk = chunk;
-    vm->ip = vm->chunk->code;
-    run(vm);
+    useChunkCode(vm, chunk);
+    vm->ip = vm->code;
+    // the interrupt flag is left alone, so that an interrupt requested before the program got going still stops it
+    resetStack(vm);
+    vm->stackTop = vm->stack+chunk->localsCount;
+    vm->input = NULL;
+    vm->runState = VM_RUNNING;
+    startRunBudget(vm);
+#ifdef QUICKENING_STATS
+    vm->quickeningStats = (QuickeningStats){0, 0, 0, 0};
+#endif
+    if (setjmp(vm->runtimeErrorJump) != 0) {
+        reportFinishedRun(vm, INTERPRET_RUNTIME_ERROR);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    reserveFrame(vm, chunk->localsCount+chunk->maxDepth+FRAME_TEMPORARIES_WORDS);
+    // whatever the last program left in the slots must not be taken for objects of this one
+    memset(vm->slots, 0, chunk->localsCount*sizeof(uint64_t));
+    InterpretResult result = run(vm);
 #ifdef TIME_EXECUTION
+    // for a program that reads input, this is the time until it first waits on input
     end = clock();
     printf("Quasicode execution time %f seconds\n\n", ((double)(end-start))/CLOCKS_PER_SEC);
 #endif
+    reportFinishedRun(vm, result);
+    return result;
+}
+
+static InterpretResult continueRun(VM* vm) {
+    // the jump buffer interpret set up went away when it returned
+    if (setjmp(vm->runtimeErrorJump) != 0) {
+        reportFinishedRun(vm, INTERPRET_RUNTIME_ERROR);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    vm->runState = VM_RUNNING;
+    startRunBudget(vm);
+    InterpretResult result = run(vm);
+    reportFinishedRun(vm, result);
+    return result;
+}
+
+InterpretResult resumeVM(VM* vm) {
+    if (vm->runState != VM_STOPPED) {
+        vm->runtimeErrorMessage = vm->runState == VM_NEEDS_INPUT ? "The program is waiting on input, which only resumeWithInput can give it" : "There is no stopped program to resume";
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    return continueRun(vm);
+}
+
+InterpretResult resumeWithInput(VM* vm, const char* input, size_t length) {
+    if (vm->runState != VM_NEEDS_INPUT) {
+        vm->runtimeErrorMessage = "There is no program waiting on input";
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    if (setjmp(vm->runtimeErrorJump) != 0) {
+        reportFinishedRun(vm, INTERPRET_RUNTIME_ERROR);
+        return INTERPRET_RUNTIME_ERROR;
+    }
+    vm->input = checkAllocation(vm, heapCopyString(&vm->heap, input, length));
+    return continueRun(vm);
 }
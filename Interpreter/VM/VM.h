@@ -2,15 +2,63 @@
 #define VM_h
 
 #include <stdio.h>
+#include <setjmp.h>
+#include <stdatomic.h>
 #include "common.h"
 #include "chunk.h"
+#include "memory.h"
 
-#define FRAMES_MAX 8192
-#define BYTES_PER_FRAME 8*2048
-#define STACK_MAX (FRAMES_MAX * BYTES_PER_FRAME)/8
+// the value stack and the call frames start small and grow as calls need them. a program that goes past either limit ends with a stack
+// overflow runtime error instead of taking down the process
+#define STACK_INITIAL_WORDS (1 << 12)
+#define STACK_MAX_WORDS (1 << 28)
+#define FRAMES_MAX (1 << 24)
+// the room every frame gets above its slots for the temporaries of the expressions it evaluates, on top of Chunk.maxDepth for the
+// main chunk, since the compiler doesn't work out the deepest value stack of every function
+#define FRAME_TEMPORARIES_WORDS 256
 
+#ifdef QUICKENING_STATS
 typedef struct {
-    uint64_t stack[STACK_MAX];
+    uint64_t specialisedHits; // a quickened opcode whose guard held
+    uint64_t guardFailures; // a quickened opcode that had to fall back to the generic path
+    uint64_t genericExecutions; // a generic Any opcode, including the fallbacks from guard failures
+    uint64_t rewrites; // an opcode byte rewritten in either direction
+} QuickeningStats;
+#endif
+
+typedef enum {
+    INTERPRET_OK,
+    INTERPRET_RUNTIME_ERROR,
+    INTERPRET_NEEDS_INPUT, // the program is waiting on an input statement, see resumeWithInput
+    INTERPRET_INTERRUPTED, // another thread called requestInterrupt, see resumeVM
+    INTERPRET_OUT_OF_BUDGET, // the run used up the budget given to setVMBudget, see resumeVM
+} InterpretResult;
+
+// what the program on a VM can do next, which is what decides whether resumeVM or resumeWithInput may continue it
+typedef enum {
+    VM_IDLE, // no program, or the last one finished with INTERPRET_OK or INTERPRET_RUNTIME_ERROR
+    VM_RUNNING,
+    VM_NEEDS_INPUT, // stopped with INTERPRET_NEEDS_INPUT, only resumeWithInput continues it
+    VM_STOPPED, // stopped with INTERPRET_INTERRUPTED or INTERPRET_OUT_OF_BUDGET, only resumeVM continues it
+} VMRunState;
+
+// safepoints are where a running program can be stopped: backward branches and calls, since everything else runs straight through.
+// passing one only decrements safepointCountdown, and the interrupt flag, the budget and the clock are only looked at once every
+// SAFEPOINT_INTERVAL safepoints, so a loop pays a decrement and a branch per iteration and straight-line code pays nothing
+#define SAFEPOINT_INTERVAL 1024
+
+// a call that hasn't returned yet. the callee's slots start at the arguments the caller pushed, which returning replaces with the result,
+// so the frame only remembers where the caller left off. its slots are an index, since the stack moves when it grows
+typedef struct {
+    uint8_t* returnAddress;
+    size_t callerSlots;
+} CallFrame;
+
+// a VM only ever touches its own state and the chunk it runs, which it doesn't write to when the chunk is finalised. so different VMs
+// can run on different threads at the same time, see host.h, but a single VM can only run one program at a time
+typedef struct {
+    uint64_t* stack;
+    size_t stackCapacity; // in words
     uint64_t* stackTop;
     uint32_t* potentialObjectsOnStackList; // for the GC
     uint32_t potentialObjectsOnStackListCount;
@@ -18,14 +66,67 @@ typedef struct {
     char** classNamesArray;
     int* classNamesLength;
     int classesCount;
+    int stringClassId; // the class id of String, or -1 while the VM has no classes, see setVMClasses
     Chunk* chunk;
-    uint8_t* ip; // this is getting moved to a call frame soon
+    uint8_t* code; // the code being run. for a finalised chunk this is privateCode, a copy that quickening can rewrite
+    uint8_t* privateCode;
+    int privateCodeCapacity;
+    uint8_t* ip; // the next instruction of the innermost call
+    uint64_t* slots; // the local variable slots of the innermost call, which sit right below its value stack
+    CallFrame* frames; // the calls below the innermost one, with the innermost one's caller on top
+    int frameCount;
+    int frameCapacity;
+    Heap heap; // the objects created by the running program
+    bool bufferOutput; // collect the output in outputBuffer instead of writing it to stdout
+    char* outputBuffer;
+    size_t outputLength;
+    size_t outputCapacity;
+    VMRunState runState;
+    const char* runtimeErrorMessage; // set when interpret returns INTERPRET_RUNTIME_ERROR
+    struct ObjString* input; // the line handed over by resumeWithInput, until the input instruction that asked for it takes it
+    jmp_buf runtimeErrorJump;
+    atomic_bool interruptRequested;
+    uint32_t safepointCountdown; // safepoints until the next look at the interrupt flag and the budget
+    uint32_t safepointSlice; // what safepointCountdown started at
+    uint64_t safepointBudget; // how many safepoints a run may pass, or 0 for no limit
+    uint64_t safepointsLeft;
+    double secondsBudget; // how long a run may take, or 0 for no limit
+    double deadline;
+#ifdef QUICKENING_STATS
+    QuickeningStats quickeningStats;
+#endif
 } VM;
 
 void resetVM(VM* vm);
+// the class names are indexed by runtime class id, and their lengths count the terminating zero. every program has the builtin String class,
+// so both of these fail when there are classes but none of them is String, which leaves initVM returning NULL and setVMClasses returning
+// false. a VM can start out without any classes and get them from setVMClasses before every program it runs
 VM* initVM(const char** classNames, const int* classNamesLength, int classesCount);
+bool setVMClasses(VM* vm, const char** classNames, const int* classNamesLength, int classesCount);
 void freeVM(VM* vm);
-void interpret(VM* vm, Chunk* chunk);
+InterpretResult interpret(VM* vm, Chunk* chunk);
+// continues a program that stopped with INTERPRET_NEEDS_INPUT, with one line of input (without the newline). everything the program needs
+// to continue lives in the VM, so no thread waits on the input and the resuming thread doesn't have to be the one that started the program.
+// on a VM whose program isn't waiting on input, it returns INTERPRET_RUNTIME_ERROR and leaves the program as it was
+InterpretResult resumeWithInput(VM* vm, const char* input, size_t length);
+// the budget every call to interpret, resumeVM and resumeWithInput starts with. a limit of 0 means no limit. since straight-line code between two
+// safepoints is never longer than the chunk, a safepoint budget also bounds the number of instructions run
+void setVMBudget(VM* vm, uint64_t safepoints, double seconds);
+// how many bytes the heap of every program the VM runs may take, counting the header of every object, or 0 for no limit. an allocation that
+// would go over it ends the program with a runtime error. how much the program did allocate is left in vm->heap until the VM is reset
+void setVMHeapLimit(VM* vm, size_t bytes);
+// asks the program running on the VM to stop at its next check of the interrupt flag. can be called from any thread, also before the program
+// has started, in which case it stops at its first check. resetVM drops an interrupt that no program saw
+void requestInterrupt(VM* vm);
+// continues a program that stopped with INTERPRET_INTERRUPTED or INTERPRET_OUT_OF_BUDGET. on a VM in any other state, it returns
+// INTERPRET_RUNTIME_ERROR and leaves the program as it was
+InterpretResult resumeVM(VM* vm);
+// the slow path of a safepoint, once safepointCountdown has run out, for run() and the backward branches of jitted code. returns
+// INTERPRET_OK if the program can go on
+InterpretResult checkSafepoint(VM* vm);
+char* takeVMOutput(VM* vm, size_t* length); // the buffered output, which the caller now owns and has to free
+// everything the program outputs goes through here, including the output of jitted code, so that it ends up in the buffer when there is one
+void writeOutput(VM* vm, const char* format, ...);
 
 void push(VM* vm, void* value);
 uint64_t pop(VM* vm);
@@ -16,7 +16,19 @@ internal class VMInterface {
             free(UnsafeMutablePointer(mutating: ptr))
         }
         
-        interpret(vm, chunk)
+        if vm == nil {
+            print("The program has no String class")
+            return
+        }
+        
+        // nothing calls run until the bytecode compiler is revived (see Compiler.swift). the suspend and resume protocol this loop drives is
+        // covered by the VM tests in Interpreter/VMTests
+        var result = interpret(vm, chunk)
+        while result == INTERPRET_NEEDS_INPUT {
+            print("Expect input: ", terminator: "")
+            let line = readLine(strippingNewline: true) ?? ""
+            result = resumeWithInput(vm, line, line.utf8.count)
+        }
         
         freeVM(vm)
     }
@@ -0,0 +1,142 @@
+#include "benchmark.h"
+#include "chunk.h"
+#include "VM.h"
+#include <stdio.h>
+#include <time.h>
+
+static double wallClockSeconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+static void writeCall(Chunk* chunk, uint8_t op, uint32_t entry, uint8_t argumentWords, uint16_t localsCount) {
+    writeChunk(chunk, op, 1);
+    writeChunkUInt(chunk, entry, 1);
+    writeChunk(chunk, argumentWords, 1);
+    writeChunkShort(chunk, localsCount, 1);
+}
+
+static void writeLongConstant(Chunk* chunk, long value) {
+    writeChunk(chunk, OP_loadEmbeddedLongConstant, 1);
+    writeChunkLong(chunk, value, 1);
+}
+
+// jumps over the function that follows, so that the program starts at the code after it. returns the function's entry
+static int beginFunction(Chunk* chunk) {
+    writeChunk(chunk, OP_jump, 1);
+    writeChunkShort(chunk, 0, 1);
+    return getChunkCodeCount(chunk);
+}
+
+static void endFunction(Chunk* chunk, int entry) {
+    patchChunkShort(chunk, entry-2, getChunkCodeCount(chunk)-entry);
+}
+
+// function count(n, total)
+//     if n == 0 then
+//         return total
+//     end if
+//     return count(n-1, total+n)
+// end function
+// output count(depth, 0)
+static Chunk* makeTailRecursiveChunk(long depth) {
+    Chunk* chunk = initChunk();
+    int entry = beginFunction(chunk);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeLongConstant(chunk, 0);
+    writeChunk(chunk, OP_equalEqualInt, 1);
+    writeChunk(chunk, OP_jumpIfFalse, 1);
+    writeChunkShort(chunk, 4, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 1, 1);
+    writeChunk(chunk, OP_returnValue, 1);
+    writeChunk(chunk, 1, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeLongConstant(chunk, 1);
+    writeChunk(chunk, OP_minusInt, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 1, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeChunk(chunk, OP_addInt, 1);
+    writeCall(chunk, OP_tailCall, entry, 2, 2);
+    endFunction(chunk, entry);
+    
+    writeLongConstant(chunk, depth);
+    writeLongConstant(chunk, 0);
+    writeCall(chunk, OP_call, entry, 2, 2);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+    finaliseChunk(chunk);
+    return chunk;
+}
+
+// function sum(n)
+//     if n == 0 then
+//         return 0
+//     end if
+//     return n + sum(n-1)
+// end function
+// output sum(depth)
+static Chunk* makeRecursiveChunk(long depth) {
+    Chunk* chunk = initChunk();
+    int entry = beginFunction(chunk);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeLongConstant(chunk, 0);
+    writeChunk(chunk, OP_equalEqualInt, 1);
+    writeChunk(chunk, OP_jumpIfFalse, 1);
+    writeChunkShort(chunk, 11, 1);
+    writeLongConstant(chunk, 0);
+    writeChunk(chunk, OP_returnValue, 1);
+    writeChunk(chunk, 1, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeChunk(chunk, OP_getLocal, 1);
+    writeChunk(chunk, 0, 1);
+    writeLongConstant(chunk, 1);
+    writeChunk(chunk, OP_minusInt, 1);
+    writeCall(chunk, OP_call, entry, 1, 1);
+    writeChunk(chunk, OP_addInt, 1);
+    writeChunk(chunk, OP_returnValue, 1);
+    writeChunk(chunk, 1, 1);
+    endFunction(chunk, entry);
+    
+    writeLongConstant(chunk, depth);
+    writeCall(chunk, OP_call, entry, 1, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+    finaliseChunk(chunk);
+    return chunk;
+}
+
+static void runRecursion(VM* vm, const char* name, Chunk* chunk, long depth) {
+    double start = wallClockSeconds();
+    InterpretResult result = interpret(vm, chunk);
+    double seconds = wallClockSeconds()-start;
+    size_t outputLength;
+    char* output = takeVMOutput(vm, &outputLength);
+    if (result == INTERPRET_OK) {
+        printf("%-15s depth %9ld: %f seconds, %6.1f million calls/s, %9zu stack words, %8d frames, result %.*s",
+               name, depth, seconds, depth/seconds/1e6, vm->stackCapacity, vm->frameCapacity, (int)outputLength, output);
+    } else {
+        printf("%-15s depth %9ld: stopped with %d (%s)\n", name, depth, result, vm->runtimeErrorMessage == NULL ? "-" : vm->runtimeErrorMessage);
+    }
+    free(output);
+    resetVM(vm);
+    freeChunk(chunk);
+}
+
+void recursionBenchmark(long maxDepth) {
+    for (long depth=1000;depth<=maxDepth;depth*=10) {
+        // a fresh VM for every depth, so that the stack sizes are the ones this depth needed
+        VM* vm = initVM(NULL, NULL, 0);
+        vm->bufferOutput = true;
+        runRecursion(vm, "tail recursion", makeTailRecursiveChunk(depth), depth);
+        runRecursion(vm, "recursion", makeRecursiveChunk(depth), depth);
+        freeVM(vm);
+    }
+}
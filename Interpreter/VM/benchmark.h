@@ -0,0 +1,10 @@
+#ifndef benchmark_h
+#define benchmark_h
+
+#include "common.h"
+
+// runs a tail-recursive and a plain recursive function at depths from 10^3 to maxDepth on one VM, and prints how long the calls take
+// and how large the value stack and the frame stack had to get. tail recursion should stay at the initial sizes at every depth
+void recursionBenchmark(long maxDepth);
+
+#endif /* benchmark_h */
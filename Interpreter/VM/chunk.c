@@ -1,5 +1,6 @@
 #include "chunk.h"
 #include "ExplicitlyTypedValue.h"
+#include "jit.h"
 #include <stdlib.h>
 #include <string.h>
 
@@ -20,6 +21,11 @@ void resetChunk(Chunk* chunk) {
 #endif
     chunk->lineInformation = NULL;
     chunk->maxDepth = 0;
+    chunk->localsCount = 0;
+    chunk->finalised = false;
+#ifdef USE_JIT
+    chunk->jitSites = NULL;
+#endif
 }
 
 Chunk* initChunk() {
@@ -34,6 +40,9 @@ void freeChunk(Chunk* chunk) {
     COMPILER_FREE_ARRAY(uint64_t, chunk->constants);
 #endif
     COMPILER_FREE_ARRAY(LineInformation, chunk->lineInformation);
+#ifdef USE_JIT
+    jitFreeChunk(chunk);
+#endif
     resetChunk(chunk);
     chunk = compilerReallocate(chunk, 0);
 }
@@ -75,6 +84,14 @@ void writeChunkLong(Chunk* chunk, uint64_t val, int line) {
     }
 }
 
+void writeChunkShort(Chunk* chunk, uint16_t val, int line) {
+    for (int i=0;i<2;i++) {
+        uint8_t byte;
+        memcpy(&byte, ((uint8_t*)(&val))+i, 1);
+        writeChunk(chunk, byte, line);
+    }
+}
+
 void writeChunkUInt(Chunk* chunk, uint32_t val, int line) {
     for (int i=0;i<4;i++) {
         uint8_t byte;
@@ -133,3 +150,19 @@ int addConstant(Chunk* chunk, uint64_t data) {
 void setMaxDepth(Chunk* chunk, int maxDepth) {
     chunk->maxDepth = maxDepth;
 }
+
+void setLocalsCount(Chunk* chunk, int localsCount) {
+    chunk->localsCount = localsCount;
+}
+
+// used to fill in the offsets of forward jumps once their target is known
+void patchChunkShort(Chunk* chunk, int offset, uint16_t val) {
+    memcpy(&chunk->code[offset], &val, 2);
+}
+
+void finaliseChunk(Chunk* chunk) {
+#ifdef USE_JIT
+    jitPrepareChunk(chunk);
+#endif
+    chunk->finalised = true;
+}
@@ -24,11 +24,17 @@ typedef struct {
     uint64_t* constants;
 #endif
     int maxDepth;
+    int localsCount; // the number of frame slots below the value stack
+    bool finalised; // see finaliseChunk
+#ifdef USE_JIT
+    struct JitSite* jitSites; // one for every byte of code, see jit.h. allocated the first time the chunk is run, or by finaliseChunk
+#endif
 } Chunk;
 
 Chunk* initChunk(void);
 void freeChunk(Chunk* chunk);
 void writeChunk(Chunk* chunk, uint8_t byte, int line);
+void writeChunkShort(Chunk* chunk, uint16_t val, int line);
 void writeChunkUInt(Chunk* chunk, uint32_t val, int line);
 void writeChunkLong(Chunk* chunk, uint64_t val, int line);
 
@@ -40,5 +46,12 @@ void writeChunkExplicitlyTypedBoolean(Chunk* chunk, bool value, int line);
 int getChunkCodeCount(Chunk* chunk);
 int addConstant(Chunk* chunk, uint64_t data);
 void setMaxDepth(Chunk* chunk, int maxDepth);
+void setLocalsCount(Chunk* chunk, int localsCount);
+void patchChunkShort(Chunk* chunk, int offset, uint16_t val);
+
+// marks a chunk as complete. a finalised chunk is never written to again, not even by the VMs that run it, so any number of VMs on any
+// number of threads can run it at the same time. the exception is its JIT sites, which are atomic. nothing may write to it after this, and
+// it can only be freed once no VM is running it
+void finaliseChunk(Chunk* chunk);
 
 #endif
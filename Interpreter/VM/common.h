@@ -3,6 +3,7 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define INITIAL_ARRAY_CAPACITY 8
 #define ARRAY_GROW_FACTOR 2
@@ -12,4 +13,18 @@
 
 //#define USE_EXTERNAL_CONSTANTS
 
+// counts how often the quickened Any opcodes hit their specialised path, and prints the hit rate after every run
+//#define QUICKENING_STATS
+// a site that has been despecialised this many times stays generic
+#define QUICKENING_MAX_DEOPTS 4
+
+// prints the heap's object count, size and high-water mark after every run. the counters themselves are always kept, see Heap
+//#define HEAP_STATS
+
+// compiles hot loops and functions to native code, see jit.c. only available on x86-64 Linux
+//#define USE_JIT
+#if defined(USE_JIT) && !(defined(__x86_64__) && defined(__linux__))
+#undef USE_JIT
+#endif
+
 #endif /* common_h */
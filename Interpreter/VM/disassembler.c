@@ -57,7 +57,7 @@ static void debugPrintExplicitlyTypedValueScalar(ExplicitlyTypedValue value, con
     } else if (TYPED_VAL_IS_OF_OBJECT(value)) {
         if (strcmp(classNames[value.type], "String") == 0) {
             ObjString* string = value.as.object;
-            printf("%s", string->data);
+            printf("%.*s", (int)string->length, string->data);
         } else {
             printf("<Instance of %s>", classNames[value.type]);
         }
@@ -110,12 +110,56 @@ static int instructionWithByte(const char* name, Chunk* chunk, int offset) {
     return offset+2;
 }
 
+static int jumpInstruction(const char* name, int sign, Chunk* chunk, int offset) {
+    uint16_t jump = *(uint16_t*)&chunk->code[offset+1];
+    printf("%-44s %d -> %d\n", name, offset, offset+3+sign*jump);
+    return offset+3;
+}
+
+static int countedLoopInstruction(const char* name, Chunk* chunk, int offset) {
+    uint16_t jump = *(uint16_t*)&chunk->code[offset+4];
+    printf("%-44s [%hhu] to [%hhu] into [%hhu], %d -> %d\n", name, chunk->code[offset+1], chunk->code[offset+2], chunk->code[offset+3], offset, offset+6-jump);
+    return offset+6;
+}
+
+// every Any opcode is followed by the number of times its site has been despecialised
+static int quickenableInstruction(const char* name, Chunk* chunk, int offset) {
+    printf("%-44s deopts %hhu\n", name, chunk->code[offset+1]);
+    return offset+2;
+}
+
 static int instructionWith4Byte(const char* name, Chunk* chunk, int offset) {
     unsigned int value = *(unsigned int*)&chunk->code[offset+1];
     printf("%-44s %d\n", name, value);
     return offset+5;
 }
 
+static int allocateInstanceInstruction(const char* name, Chunk* chunk, int offset, const char** classNames) {
+    unsigned int classId = *(unsigned int*)&chunk->code[offset+1];
+    uint16_t fieldWords = *(uint16_t*)&chunk->code[offset+5];
+    printf("%-44s %s, %hu words\n", name, classNames[classId], fieldWords);
+    return offset+7;
+}
+
+// a call is followed by the offset of the function's first instruction, the number of words its arguments take and the number of its slots
+static int callInstruction(const char* name, Chunk* chunk, int offset) {
+    unsigned int entry = *(unsigned int*)&chunk->code[offset+1];
+    uint16_t localsCount = *(uint16_t*)&chunk->code[offset+6];
+    printf("%-44s %d, %hhu argument words, %hu slots\n", name, entry, chunk->code[offset+5], localsCount);
+    return offset+8;
+}
+
+static int byteOperandInstruction(const char* name, Chunk* chunk, int offset) {
+    printf("%-44s %hhu\n", name, chunk->code[offset+1]);
+    return offset+2;
+}
+
+static int fieldInstruction(const char* name, Chunk* chunk, int offset) {
+    uint16_t fieldOffset = *(uint16_t*)&chunk->code[offset+1];
+    printf("%-44s +%hu\n", name, fieldOffset);
+    return offset+3;
+}
+
 int disassembleInstruction(const char** classNames, Chunk* chunk, int offset, int lineNumber, bool showLineNumber) {
     printf("%04lld ", offset);
     
@@ -187,9 +231,57 @@ int disassembleInstruction(const char** classNames, Chunk* chunk, int offset, in
         SIMPLE_INSTRUCTION(OP_outputBoolean)
         SIMPLE_INSTRUCTION(OP_outputString)
         SIMPLE_INSTRUCTION(OP_outputArray)
-        SIMPLE_INSTRUCTION(OP_outputAny)
         SIMPLE_INSTRUCTION(OP_outputClass)
         SIMPLE_INSTRUCTION(OP_outputVoid)
+        SIMPLE_INSTRUCTION(OP_inputInt)
+        SIMPLE_INSTRUCTION(OP_inputDouble)
+        SIMPLE_INSTRUCTION(OP_inputString)
+        SIMPLE_INSTRUCTION(OP_inputAny)
+        case OP_jump:
+            return jumpInstruction("OP_jump", 1, chunk, offset);
+        case OP_jumpIfFalse:
+            return jumpInstruction("OP_jumpIfFalse", 1, chunk, offset);
+        case OP_loop:
+            return jumpInstruction("OP_loop", -1, chunk, offset);
+        case OP_getLocal:
+            return instructionWithByte("OP_getLocal", chunk, offset);
+        case OP_setLocal:
+            return instructionWithByte("OP_setLocal", chunk, offset);
+        case OP_countedLoop:
+            return countedLoopInstruction("OP_countedLoop", chunk, offset);
+#define QUICKENABLE_INSTRUCTION(name) case name: return quickenableInstruction(#name, chunk, offset);
+        QUICKENABLE_INSTRUCTION(OP_outputAny)
+        QUICKENABLE_INSTRUCTION(OP_addAny)
+        QUICKENABLE_INSTRUCTION(OP_addAnyInt)
+        QUICKENABLE_INSTRUCTION(OP_addAnyDouble)
+        QUICKENABLE_INSTRUCTION(OP_addAnyString)
+        QUICKENABLE_INSTRUCTION(OP_minusAny)
+        QUICKENABLE_INSTRUCTION(OP_minusAnyInt)
+        QUICKENABLE_INSTRUCTION(OP_minusAnyDouble)
+        QUICKENABLE_INSTRUCTION(OP_multiplyAny)
+        QUICKENABLE_INSTRUCTION(OP_multiplyAnyInt)
+        QUICKENABLE_INSTRUCTION(OP_multiplyAnyDouble)
+        QUICKENABLE_INSTRUCTION(OP_outputAnyInt)
+        QUICKENABLE_INSTRUCTION(OP_outputAnyDouble)
+        QUICKENABLE_INSTRUCTION(OP_outputAnyBoolean)
+        QUICKENABLE_INSTRUCTION(OP_outputAnyString)
+#undef QUICKENABLE_INSTRUCTION
+        case OP_allocateInstance:
+            return allocateInstanceInstruction("OP_allocateInstance", chunk, offset, classNames);
+        case OP_getField:
+            return fieldInstruction("OP_getField", chunk, offset);
+        case OP_setField:
+            return fieldInstruction("OP_setField", chunk, offset);
+        case OP_getFieldExplicitlyTyped:
+            return fieldInstruction("OP_getFieldExplicitlyTyped", chunk, offset);
+        case OP_setFieldExplicitlyTyped:
+            return fieldInstruction("OP_setFieldExplicitlyTyped", chunk, offset);
+        case OP_call:
+            return callInstruction("OP_call", chunk, offset);
+        case OP_tailCall:
+            return callInstruction("OP_tailCall", chunk, offset);
+        case OP_returnValue:
+            return byteOperandInstruction("OP_returnValue", chunk, offset);
         default:
             printf("Unknown opcode %d\n", instruction);
             return offset+1;
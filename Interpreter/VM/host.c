@@ -0,0 +1,218 @@
+#include "host.h"
+#include "memory.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+// the jobs a worker was given. the worker takes them from the back and thieves take them from the front, so a thief takes the job the
+// owner would have got to last
+typedef struct {
+    pthread_mutex_t lock;
+    int* jobIndices;
+    int front;
+    int back;
+} WorkQueue;
+
+typedef struct {
+    Host* host;
+    int index;
+} Worker;
+
+struct Host {
+    int threadCount;
+    VM** vms; // one for every worker
+    // whether every worker's VM is running a job, guarded by its lock. hostInterruptRunningJobs only interrupts a VM while it is, so an
+    // interrupt can't reach a job that starts after it or be left over from one that already ended
+    pthread_mutex_t* runningLocks;
+    bool* running;
+    WorkQueue* queues; // one for every worker
+    HostJob* jobs; // the jobs of the hostRun call in progress
+};
+
+Host* initHost(int threadCount) {
+    Host* host = malloc(sizeof *host);
+    host->threadCount = threadCount;
+    host->vms = COMPILER_MEM_ALLOCATE(VM*, threadCount);
+    host->queues = COMPILER_MEM_ALLOCATE(WorkQueue, threadCount);
+    host->runningLocks = COMPILER_MEM_ALLOCATE(pthread_mutex_t, threadCount);
+    host->running = COMPILER_MEM_ALLOCATE(bool, threadCount);
+    for (int i=0;i<threadCount;i++) {
+        host->vms[i] = initVM(NULL, NULL, 0);
+        host->vms[i]->bufferOutput = true;
+        pthread_mutex_init(&host->runningLocks[i], NULL);
+        host->running[i] = false;
+        pthread_mutex_init(&host->queues[i].lock, NULL);
+        host->queues[i].jobIndices = NULL;
+    }
+    host->jobs = NULL;
+    return host;
+}
+
+void freeHost(Host* host) {
+    for (int i=0;i<host->threadCount;i++) {
+        freeVM(host->vms[i]);
+        pthread_mutex_destroy(&host->queues[i].lock);
+        pthread_mutex_destroy(&host->runningLocks[i]);
+    }
+    COMPILER_MEM_FREE(VM*, host->vms);
+    COMPILER_MEM_FREE(pthread_mutex_t, host->runningLocks);
+    COMPILER_MEM_FREE(bool, host->running);
+    COMPILER_MEM_FREE(WorkQueue, host->queues);
+    host = realloc(host, 0);
+}
+
+void freeHostJobOutput(HostJob* job) {
+    COMPILER_FREE_ARRAY(char, job->output);
+    job->output = NULL;
+    job->outputLength = 0;
+}
+
+void hostInterruptRunningJobs(Host* host) {
+    for (int i=0;i<host->threadCount;i++) {
+        pthread_mutex_lock(&host->runningLocks[i]);
+        if (host->running[i]) {
+            requestInterrupt(host->vms[i]);
+        }
+        pthread_mutex_unlock(&host->runningLocks[i]);
+    }
+}
+
+static bool takeOwnJob(WorkQueue* queue, int* jobIndex) {
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->back > queue->front;
+    if (found) {
+        queue->back--;
+        *jobIndex = queue->jobIndices[queue->back];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool stealJob(WorkQueue* queue, int* jobIndex) {
+    pthread_mutex_lock(&queue->lock);
+    bool found = queue->back > queue->front;
+    if (found) {
+        *jobIndex = queue->jobIndices[queue->front];
+        queue->front++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static void setRunning(Host* host, int workerIndex, bool running) {
+    pthread_mutex_lock(&host->runningLocks[workerIndex]);
+    host->running[workerIndex] = running;
+    pthread_mutex_unlock(&host->runningLocks[workerIndex]);
+}
+
+static void runJob(Host* host, int workerIndex, HostJob* job) {
+    VM* vm = host->vms[workerIndex];
+    if (!setVMClasses(vm, job->classNames, job->classNamesLength, job->classesCount)) {
+        job->result = INTERPRET_RUNTIME_ERROR;
+        job->runtimeErrorMessage = "The program has no String class";
+        job->output = NULL;
+        job->outputLength = 0;
+        job->heapObjects = 0;
+        job->peakHeapBytes = 0;
+        return;
+    }
+    setVMBudget(vm, job->safepointBudget, job->secondsBudget);
+    setVMHeapLimit(vm, job->heapLimit);
+    // the VM's interrupt flag is clear here, since resetVM cleared it after the last job and nothing could set it while the VM wasn't
+    // running. an interrupt that comes in between this and the program's first safepoint still stops it there
+    setRunning(host, workerIndex, true);
+    job->result = interpret(vm, job->chunk);
+    setRunning(host, workerIndex, false);
+    job->runtimeErrorMessage = vm->runtimeErrorMessage;
+    job->output = takeVMOutput(vm, &job->outputLength);
+    job->heapObjects = vm->heap.objectsAllocated;
+    job->peakHeapBytes = vm->heap.peakBytesAllocated;
+    resetVM(vm);
+}
+
+static void* runWorker(void* argument) {
+    Worker* worker = argument;
+    Host* host = worker->host;
+    for (;;) {
+        int jobIndex;
+        bool found = takeOwnJob(&host->queues[worker->index], &jobIndex);
+        for (int i=1;i<host->threadCount && !found;i++) {
+            found = stealJob(&host->queues[(worker->index+i)%host->threadCount], &jobIndex);
+        }
+        if (!found) {
+            // no jobs get added while the host is running, so once every queue is empty the worker is done
+            return NULL;
+        }
+        runJob(host, worker->index, &host->jobs[jobIndex]);
+    }
+}
+
+void hostRun(Host* host, HostJob* jobs, int jobCount) {
+    host->jobs = jobs;
+    for (int i=0;i<host->threadCount;i++) {
+        host->queues[i].jobIndices = COMPILER_MEM_ALLOCATE(int, jobCount/host->threadCount+1);
+        host->queues[i].front = 0;
+        host->queues[i].back = 0;
+    }
+    for (int i=0;i<jobCount;i++) {
+        WorkQueue* queue = &host->queues[i%host->threadCount];
+        queue->jobIndices[queue->back] = i;
+        queue->back++;
+    }
+
+    // a worker whose thread can't be started leaves its queue to the others, which steal from every queue until all of them are empty. if
+    // no thread starts at all, the calling thread works through the jobs itself
+    pthread_t* threads = COMPILER_MEM_ALLOCATE(pthread_t, host->threadCount);
+    Worker* workers = COMPILER_MEM_ALLOCATE(Worker, host->threadCount);
+    int threadsStarted = 0;
+    for (int i=0;i<host->threadCount;i++) {
+        workers[i] = (Worker){host, i};
+        if (pthread_create(&threads[threadsStarted], NULL, runWorker, &workers[i]) == 0) {
+            threadsStarted++;
+        }
+    }
+    if (threadsStarted == 0) {
+        runWorker(&workers[0]);
+    }
+    for (int i=0;i<threadsStarted;i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    COMPILER_MEM_FREE(pthread_t, threads);
+    COMPILER_MEM_FREE(Worker, workers);
+    for (int i=0;i<host->threadCount;i++) {
+        COMPILER_FREE_ARRAY(int, host->queues[i].jobIndices);
+        host->queues[i].jobIndices = NULL;
+    }
+    host->jobs = NULL;
+}
+
+static double wallClockSeconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec/1e9;
+}
+
+void hostScalingBenchmark(Chunk* chunk, const char** classNames, const int* classNamesLength, int classesCount, int runs, int maxThreads) {
+    HostJob* jobs = COMPILER_MEM_ALLOCATE(HostJob, runs);
+    double singleThreadSeconds = 0;
+    for (int threadCount=1;threadCount<=maxThreads;threadCount++) {
+        for (int i=0;i<runs;i++) {
+            jobs[i] = (HostJob){chunk, classNames, classNamesLength, classesCount, 0, 0, 0, INTERPRET_OK, NULL, NULL, 0, 0, 0};
+        }
+        Host* host = initHost(threadCount);
+        double start = wallClockSeconds();
+        hostRun(host, jobs, runs);
+        double seconds = wallClockSeconds()-start;
+        freeHost(host);
+        for (int i=0;i<runs;i++) {
+            freeHostJobOutput(&jobs[i]);
+        }
+
+        if (threadCount == 1) {
+            singleThreadSeconds = seconds;
+        }
+        printf("%3d threads: %d runs in %f seconds, %.1f runs/s, %.2fx speedup\n", threadCount, runs, seconds, runs/seconds, singleThreadSeconds/seconds);
+    }
+    COMPILER_MEM_FREE(HostJob, jobs);
+}
@@ -0,0 +1,61 @@
+#ifndef host_h
+#define host_h
+
+#include "common.h"
+#include "chunk.h"
+#include "VM.h"
+
+/*
+ Runs many programs at once, for grading a lot of submissions in one process.
+
+ Thread safety contract:
+ - a chunk has to be finalised (see finaliseChunk) before it is handed to the host. finalised chunks are only ever read, so one chunk can
+   be in any number of jobs that run at the same time. the chunk, and the string constants in it, have to outlive the hostRun call
+ - every worker thread has its own VM, which it reuses for every job it runs. a VM has its own stack, heap and output buffer and is only
+   ever used by one thread at a time, objects never move between VMs
+ - the VM has no global state. the exceptions are the debug options in common.h (DEBUG_TRACE_EXECUTION, TIME_EXECUTION and
+   QUICKENING_STATS), which print straight to stdout and should be turned off for hosted runs
+ - with USE_JIT, the jobs running a chunk count its hot loops and functions together, in atomic counters that finaliseChunk sets up, and
+   whichever thread finds a site hot first compiles it once for all of them (see jit.h). the native code only reads the chunk and sends
+   its output through the job's VM, so it is collected like the rest. native loops pass a safepoint on every backward branch like run()
+   does, so interrupts and budgets work the same (see jit.c)
+ - output is collected per job and runtime errors, including going over heapLimit, end only the job that caused them. a job whose program
+   reads input ends with INTERPRET_NEEDS_INPUT, since its VM is reused for the next job. interactive sessions each get their own VM instead,
+   which any thread can resume with resumeWithInput once the input arrives, as long as only one thread uses it at a time
+ */
+
+typedef struct {
+    // set by the caller
+    Chunk* chunk;
+    const char** classNames;
+    const int* classNamesLength;
+    int classesCount;
+    uint64_t safepointBudget; // see setVMBudget, 0 for no limit
+    double secondsBudget;
+    size_t heapLimit; // see setVMHeapLimit, 0 for no limit
+    // set by the host
+    InterpretResult result;
+    const char* runtimeErrorMessage;
+    char* output; // owned by the job once it has run
+    size_t outputLength;
+    size_t heapObjects; // how many objects the program allocated
+    size_t peakHeapBytes; // the high-water mark of the program's heap
+} HostJob;
+
+typedef struct Host Host;
+
+Host* initHost(int threadCount);
+void freeHost(Host* host);
+// runs every job and returns once all of them are done. jobs are spread over the worker threads, which steal from each other when they
+// run out of their own
+void hostRun(Host* host, HostJob* jobs, int jobCount);
+void freeHostJobOutput(HostJob* job);
+// stops the jobs that are running right now at their next safepoint, which then end with INTERPRET_INTERRUPTED. jobs that haven't
+// started yet, or start after this returns, run as usual. can be called from any thread, including while hostRun is running
+void hostInterruptRunningJobs(Host* host);
+
+// runs the same chunk `runs` times with 1 to maxThreads worker threads and prints how the throughput scales. `vmTests hostScalingBenchmark`
+// runs it on a counting loop, see Interpreter/VMTests
+void hostScalingBenchmark(Chunk* chunk, const char** classNames, const int* classNamesLength, int classesCount, int runs, int maxThreads);
+
+#endif /* host_h */
@@ -0,0 +1,613 @@
+#include "jit.h"
+
+#ifdef USE_JIT
+
+#include <string.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include "OpCode.h"
+#include "memory.h"
+
+// a baseline template JIT: every supported opcode is translated to a fixed sequence of x86-64 instructions
+// that does exactly what run() does to the value stack. rbx holds the stack top, r12 the VM and r13 the frame slots for the whole
+// function, everything else is scratch.
+//
+// run() counts how often it arrives at every loop header and function entry, and once one of them is hot the code from there on is compiled,
+// up to the first opcode without a template, which covers everything that touches objects, explicitly typed values, input or calls. so a
+// hot loop is compiled from its header wherever it is in the chunk, and what comes before it doesn't matter. the native code leaves vm->ip
+// where the interpreter picks up: at the opcode without a template, at the target of a jump out of the compiled code, or at the OP_return
+// that ends the program. the interpreter then enters the native code again the next time it branches back to the header.
+//
+// the branches work like in run(): jumps within the compiled code branch to the native code of their target, and the backward branches
+// (OP_loop and OP_countedLoop) pass a safepoint first, so that a native loop can still be interrupted and still runs out of its budget
+
+typedef struct {
+    uint8_t* code;
+    int count;
+    int capacity;
+} Assembler;
+
+static void emitByte(Assembler* assembler, uint8_t byte) {
+    if (assembler->count+1>assembler->capacity) {
+        const int newCapacity = GROW_CAPACITY(assembler->capacity);
+        assembler->code = COMPILER_GROW_ARRAY(uint8_t, assembler->code, newCapacity);
+        assembler->capacity = newCapacity;
+    }
+    assembler->code[assembler->count] = byte;
+    assembler->count++;
+}
+
+static void emitBytes(Assembler* assembler, const uint8_t* bytes, int count) {
+    for (int i=0;i<count;i++) {
+        emitByte(assembler, bytes[i]);
+    }
+}
+
+static void emit32(Assembler* assembler, uint32_t val) {
+    uint8_t bytes[4];
+    memcpy(bytes, &val, 4);
+    emitBytes(assembler, bytes, 4);
+}
+
+static void emit64(Assembler* assembler, uint64_t val) {
+    uint8_t bytes[8];
+    memcpy(bytes, &val, 8);
+    emitBytes(assembler, bytes, 8);
+}
+
+static void patch32(Assembler* assembler, int position, uint32_t val) {
+    memcpy(assembler->code+position, &val, 4);
+}
+
+// a rel32 branch to the native code of a bytecode offset, which is filled in once the whole chunk is compiled
+typedef struct {
+    int position; // of the rel32
+    int target; // the bytecode offset
+} BranchFixup;
+
+typedef struct {
+    Assembler assembler;
+    int* nativeOffsets; // the native offset of every bytecode offset that starts a compiled instruction, -1 everywhere else
+    BranchFixup* fixups;
+    int fixupsCount;
+    int fixupsCapacity;
+} Compilation;
+
+#define EMIT(...) \
+do { \
+    const uint8_t bytes[] = {__VA_ARGS__}; \
+    emitBytes(assembler, bytes, sizeof(bytes)); \
+} while (false)
+
+// these are called from jitted code and output exactly what the output opcodes in run() output
+static void jitOutputInt(VM* vm, uint64_t bits) {
+    long val;
+    memcpy(&val, &bits, 8);
+    writeOutput(vm, "%li\n", val);
+}
+
+static void jitOutputDouble(VM* vm, uint64_t bits) {
+    double val;
+    memcpy(&val, &bits, 8);
+    writeOutput(vm, "%f\n", val);
+}
+
+static void jitOutputBoolean(VM* vm, uint64_t bits) {
+    double val;
+    memcpy(&val, &bits, 8);
+    writeOutput(vm, "%s\n", (val != 0) ? "true" : "false");
+}
+
+// the three pushes and the return address keep the stack 16 byte aligned for calls
+static void emitPrologue(Assembler* assembler) {
+    EMIT(0x53);                         // push rbx
+    EMIT(0x41, 0x54);                   // push r12
+    EMIT(0x41, 0x55);                   // push r13
+    EMIT(0x49, 0x89, 0xFC);             // mov r12, rdi
+    EMIT(0x49, 0x8B, 0x9C, 0x24);       // mov rbx, [r12+stackTop]
+    emit32(assembler, offsetof(VM, stackTop));
+    EMIT(0x4D, 0x8B, 0xAC, 0x24);       // mov r13, [r12+slots]
+    emit32(assembler, offsetof(VM, slots));
+}
+
+// hands the program back to the interpreter at `offset`, returning the InterpretResult in eax
+static void emitExitWithEax(Assembler* assembler, int offset) {
+    EMIT(0x49, 0x89, 0x9C, 0x24);       // mov [r12+stackTop], rbx
+    emit32(assembler, offsetof(VM, stackTop));
+    EMIT(0x49, 0x8B, 0x8C, 0x24);       // mov rcx, [r12+code]
+    emit32(assembler, offsetof(VM, code));
+    EMIT(0x48, 0x81, 0xC1);             // add rcx, offset
+    emit32(assembler, (uint32_t)offset);
+    EMIT(0x49, 0x89, 0x8C, 0x24);       // mov [r12+ip], rcx
+    emit32(assembler, offsetof(VM, ip));
+    EMIT(0x41, 0x5D);                   // pop r13
+    EMIT(0x41, 0x5C);                   // pop r12
+    EMIT(0x5B);                         // pop rbx
+    EMIT(0xC3);                         // ret
+}
+
+// hands the program back to the interpreter at `offset` to carry on from there
+static void emitExit(Assembler* assembler, int offset) {
+    EMIT(0xB8);                         // mov eax, INTERPRET_OK
+    emit32(assembler, INTERPRET_OK);
+    emitExitWithEax(assembler, offset);
+}
+
+// emits a rel32 branch (jmp or jcc) with a placeholder and returns where the rel32 is
+static int emitBranchPlaceholder(Assembler* assembler, const uint8_t* opcode, int opcodeLength) {
+    emitBytes(assembler, opcode, opcodeLength);
+    int position = assembler->count;
+    emit32(assembler, 0);
+    return position;
+}
+
+// points a branch emitted with emitBranchPlaceholder at the current end of the code
+static void patchBranchHere(Assembler* assembler, int position) {
+    patch32(assembler, position, (uint32_t)(assembler->count-position-4));
+}
+
+static void emitBranchToBytecode(Compilation* compilation, const uint8_t* opcode, int opcodeLength, int target) {
+    int position = emitBranchPlaceholder(&compilation->assembler, opcode, opcodeLength);
+    if (compilation->fixupsCount+1>compilation->fixupsCapacity) {
+        const int newCapacity = GROW_CAPACITY(compilation->fixupsCapacity);
+        compilation->fixups = COMPILER_GROW_ARRAY(BranchFixup, compilation->fixups, newCapacity);
+        compilation->fixupsCapacity = newCapacity;
+    }
+    compilation->fixups[compilation->fixupsCount] = (BranchFixup){position, target};
+    compilation->fixupsCount++;
+}
+
+static const uint8_t jmpOpcode[] = {0xE9};
+static const uint8_t jzOpcode[] = {0x0F, 0x84};
+static const uint8_t jnzOpcode[] = {0x0F, 0x85};
+static const uint8_t jgeOpcode[] = {0x0F, 0x8D};
+
+// the safepoint of a backward branch at `offset`, which stops the program there the same way SAFEPOINT in run() does, so that the
+// interpreter runs the whole branch again when the program is resumed
+static void emitSafepoint(Assembler* assembler, int offset) {
+    EMIT(0x41, 0x83, 0xAC, 0x24);       // sub dword [r12+safepointCountdown], 1
+    emit32(assembler, offsetof(VM, safepointCountdown));
+    EMIT(0x01);
+    int passed = emitBranchPlaceholder(assembler, jnzOpcode, sizeof(jnzOpcode));
+    EMIT(0x4C, 0x89, 0xE7);             // mov rdi, r12
+    EMIT(0x48, 0xB8);                   // mov rax, checkSafepoint
+    emit64(assembler, (uint64_t)checkSafepoint);
+    EMIT(0xFF, 0xD0);                   // call rax
+    EMIT(0x85, 0xC0);                   // test eax, eax
+    int resumed = emitBranchPlaceholder(assembler, jzOpcode, sizeof(jzOpcode));
+    emitExitWithEax(assembler, offset);
+    patchBranchHere(assembler, passed);
+    patchBranchHere(assembler, resumed);
+}
+
+// the displacement of a frame slot from r13
+static uint32_t slotDisplacement(uint8_t slot) {
+    return (uint32_t)slot*8;
+}
+
+static void emitPushImmediate(Assembler* assembler, int32_t value) {
+    EMIT(0x48, 0xC7, 0x03);             // mov qword [rbx], imm32
+    emit32(assembler, (uint32_t)value);
+    EMIT(0x48, 0x83, 0xC3, 0x08);       // add rbx, 8
+}
+
+static void emitPushLong(Assembler* assembler, uint64_t value) {
+    EMIT(0x48, 0xB8);                   // mov rax, imm64
+    emit64(assembler, value);
+    EMIT(0x48, 0x89, 0x03);             // mov [rbx], rax
+    EMIT(0x48, 0x83, 0xC3, 0x08);       // add rbx, 8
+}
+
+static void emitPopSlots(Assembler* assembler, int count) {
+    EMIT(0x48, 0x81, 0xEB);             // sub rbx, imm32
+    emit32(assembler, (uint32_t)(count*8));
+}
+
+// pops b into rcx and leaves a in rax, the result should then be written with emitStoreRaxToTop
+static void emitLoadIntOperands(Assembler* assembler) {
+    EMIT(0x48, 0x8B, 0x43, 0xF0);       // mov rax, [rbx-16]
+    EMIT(0x48, 0x8B, 0x4B, 0xF8);       // mov rcx, [rbx-8]
+    EMIT(0x48, 0x83, 0xEB, 0x08);       // sub rbx, 8
+}
+
+static void emitStoreRaxToTop(Assembler* assembler) {
+    EMIT(0x48, 0x89, 0x43, 0xF8);       // mov [rbx-8], rax
+}
+
+// pops b into xmm1 and leaves a in xmm0, the result should then be written with emitStoreXmm0ToTop
+static void emitLoadDoubleOperands(Assembler* assembler) {
+    EMIT(0xF2, 0x0F, 0x10, 0x43, 0xF0); // movsd xmm0, [rbx-16]
+    EMIT(0xF2, 0x0F, 0x10, 0x4B, 0xF8); // movsd xmm1, [rbx-8]
+    EMIT(0x48, 0x83, 0xEB, 0x08);       // sub rbx, 8
+}
+
+static void emitStoreXmm0ToTop(Assembler* assembler) {
+    EMIT(0xF2, 0x0F, 0x11, 0x43, 0xF8); // movsd [rbx-8], xmm0
+}
+
+static void emitIntCompare(Assembler* assembler, uint8_t setccOpcode) {
+    emitLoadIntOperands(assembler);
+    EMIT(0x48, 0x39, 0xC8);             // cmp rax, rcx
+    EMIT(0x0F, setccOpcode, 0xC0);      // setcc al
+    EMIT(0x0F, 0xB6, 0xC0);             // movzx eax, al
+    emitStoreRaxToTop(assembler);
+}
+
+// comparisons of doubles leave a double 1.0 or 0.0 on the stack, just like DOUBLE_BINARY_OP does
+static void emitDoubleCompare(Assembler* assembler, uint8_t predicate, bool swapOperands) {
+    emitLoadDoubleOperands(assembler);
+    if (swapOperands) {
+        EMIT(0xF2, 0x0F, 0xC2, 0xC8, predicate); // cmpsd xmm1, xmm0, predicate
+        EMIT(0x66, 0x0F, 0x28, 0xC1);            // movapd xmm0, xmm1
+    } else {
+        EMIT(0xF2, 0x0F, 0xC2, 0xC1, predicate); // cmpsd xmm0, xmm1, predicate
+    }
+    EMIT(0x48, 0xB8);                   // mov rax, 1.0
+    emit64(assembler, 0x3FF0000000000000);
+    EMIT(0x66, 0x48, 0x0F, 0x6E, 0xD0); // movq xmm2, rax
+    EMIT(0x66, 0x0F, 0x54, 0xC2);       // andpd xmm0, xmm2
+    emitStoreXmm0ToTop(assembler);
+}
+
+// reads the slot at [rbx+displacement] as a boolean into eax, the same way READ_BOOL does
+static void emitReadBool(Assembler* assembler, int8_t displacement) {
+    EMIT(0xF2, 0x0F, 0x10, 0x43, (uint8_t)displacement); // movsd xmm0, [rbx+displacement]
+    EMIT(0x66, 0x0F, 0x57, 0xC9);       // xorpd xmm1, xmm1
+    EMIT(0x66, 0x0F, 0x2E, 0xC1);       // ucomisd xmm0, xmm1
+    EMIT(0x0F, 0x95, 0xC0);             // setne al
+    EMIT(0x0F, 0x9A, 0xC2);             // setp dl
+    EMIT(0x08, 0xD0);                   // or al, dl
+    EMIT(0x0F, 0xB6, 0xC0);             // movzx eax, al
+}
+
+// leaves b in ecx and a in eax, both as 0 or 1
+static void emitLoadBoolOperands(Assembler* assembler) {
+    emitReadBool(assembler, -8);
+    EMIT(0x89, 0xC1);                   // mov ecx, eax
+    emitReadBool(assembler, -16);
+    EMIT(0x48, 0x83, 0xEB, 0x08);       // sub rbx, 8
+}
+
+static void emitOutput(Assembler* assembler, void (*outputFunction)(VM*, uint64_t)) {
+    EMIT(0x4C, 0x89, 0xE7);             // mov rdi, r12
+    EMIT(0x48, 0x8B, 0x73, 0xF8);       // mov rsi, [rbx-8]
+    EMIT(0x48, 0x83, 0xEB, 0x08);       // sub rbx, 8
+    EMIT(0x48, 0xB8);                   // mov rax, outputFunction
+    emit64(assembler, (uint64_t)outputFunction);
+    EMIT(0xFF, 0xD0);                   // call rax
+}
+
+// emits the template for the instruction at offset and returns its length in bytes, or 0 if it has no template
+static int compileInstruction(Compilation* compilation, Chunk* chunk, int offset) {
+    Assembler* assembler = &compilation->assembler;
+    const uint8_t* operands = chunk->code+offset+1;
+    uint16_t jumpOffset;
+    switch (chunk->code[offset]) {
+        case OP_return:
+            // the interpreter ends the program, which is where the checks and the reporting of a finished run are
+            emitExit(assembler, offset);
+            return 1;
+        case OP_true:
+            emitPushImmediate(assembler, 1);
+            return 1;
+        case OP_false:
+            emitPushImmediate(assembler, 0);
+            return 1;
+        case OP_pop:
+            emitPopSlots(assembler, 1);
+            return 1;
+        case OP_pop_n:
+            emitPopSlots(assembler, operands[0]);
+            return 2;
+        case OP_loadEmbeddedByteConstant:
+            emitPushImmediate(assembler, *(char*)operands);
+            return 2;
+        case OP_loadEmbeddedLongConstant: {
+            uint64_t value;
+            memcpy(&value, operands, 8);
+            emitPushLong(assembler, value);
+            return 9;
+        }
+        case OP_negateInt:
+            EMIT(0x48, 0xF7, 0x5B, 0xF8);   // neg qword [rbx-8]
+            return 1;
+        case OP_negateDouble:
+            EMIT(0x48, 0xB8);               // mov rax, sign bit
+            emit64(assembler, 0x8000000000000000);
+            EMIT(0x48, 0x31, 0x43, 0xF8);   // xor [rbx-8], rax
+            return 1;
+        case OP_greaterInt:
+            emitIntCompare(assembler, 0x9F);    // setg
+            return 1;
+        case OP_greaterOrEqualInt:
+            emitIntCompare(assembler, 0x9D);    // setge
+            return 1;
+        case OP_lessInt:
+            emitIntCompare(assembler, 0x9C);    // setl
+            return 1;
+        case OP_lessOrEqualInt:
+            emitIntCompare(assembler, 0x9E);    // setle
+            return 1;
+        case OP_equalEqualInt:
+            emitIntCompare(assembler, 0x94);    // sete
+            return 1;
+        case OP_notEqualInt:
+            emitIntCompare(assembler, 0x95);    // setne
+            return 1;
+        // a > b and a >= b are computed as b < a and b <= a so that they're false for NaN, like in C
+        case OP_greaterDouble:
+            emitDoubleCompare(assembler, 1, true);
+            return 1;
+        case OP_greaterOrEqualDouble:
+            emitDoubleCompare(assembler, 2, true);
+            return 1;
+        case OP_lessDouble:
+            emitDoubleCompare(assembler, 1, false);
+            return 1;
+        case OP_lessOrEqualDouble:
+            emitDoubleCompare(assembler, 2, false);
+            return 1;
+        case OP_equalEqualDouble:
+            emitDoubleCompare(assembler, 0, false);
+            return 1;
+        case OP_notEqualDouble:
+            emitDoubleCompare(assembler, 4, false);
+            return 1;
+        case OP_equalEqualBool:
+            emitLoadBoolOperands(assembler);
+            EMIT(0x39, 0xC8);               // cmp eax, ecx
+            EMIT(0x0F, 0x94, 0xC0);         // sete al
+            EMIT(0x0F, 0xB6, 0xC0);         // movzx eax, al
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_notEqualBool:
+            emitLoadBoolOperands(assembler);
+            EMIT(0x39, 0xC8);               // cmp eax, ecx
+            EMIT(0x0F, 0x95, 0xC0);         // setne al
+            EMIT(0x0F, 0xB6, 0xC0);         // movzx eax, al
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_orBool:
+            emitLoadBoolOperands(assembler);
+            EMIT(0x09, 0xC8);               // or eax, ecx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_andBool:
+            emitLoadBoolOperands(assembler);
+            EMIT(0x21, 0xC8);               // and eax, ecx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_minusInt:
+            emitLoadIntOperands(assembler);
+            EMIT(0x48, 0x29, 0xC8);         // sub rax, rcx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_addInt:
+            emitLoadIntOperands(assembler);
+            EMIT(0x48, 0x01, 0xC8);         // add rax, rcx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_multiplyInt:
+            emitLoadIntOperands(assembler);
+            EMIT(0x48, 0x0F, 0xAF, 0xC1);   // imul rax, rcx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_divideInt:
+        case OP_intDivideInt:
+            emitLoadIntOperands(assembler);
+            EMIT(0x48, 0x99);               // cqo
+            EMIT(0x48, 0xF7, 0xF9);         // idiv rcx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_modInt:
+            emitLoadIntOperands(assembler);
+            EMIT(0x48, 0x99);               // cqo
+            EMIT(0x48, 0xF7, 0xF9);         // idiv rcx
+            EMIT(0x48, 0x89, 0xD0);         // mov rax, rdx
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_minusDouble:
+            emitLoadDoubleOperands(assembler);
+            EMIT(0xF2, 0x0F, 0x5C, 0xC1);   // subsd xmm0, xmm1
+            emitStoreXmm0ToTop(assembler);
+            return 1;
+        case OP_addDouble:
+            emitLoadDoubleOperands(assembler);
+            EMIT(0xF2, 0x0F, 0x58, 0xC1);   // addsd xmm0, xmm1
+            emitStoreXmm0ToTop(assembler);
+            return 1;
+        case OP_multiplyDouble:
+            emitLoadDoubleOperands(assembler);
+            EMIT(0xF2, 0x0F, 0x59, 0xC1);   // mulsd xmm0, xmm1
+            emitStoreXmm0ToTop(assembler);
+            return 1;
+        case OP_divideDouble:
+            emitLoadDoubleOperands(assembler);
+            EMIT(0xF2, 0x0F, 0x5E, 0xC1);   // divsd xmm0, xmm1
+            emitStoreXmm0ToTop(assembler);
+            return 1;
+        case OP_intDivideDouble:
+            emitLoadDoubleOperands(assembler);
+            EMIT(0xF2, 0x0F, 0x5E, 0xC1);   // divsd xmm0, xmm1
+            EMIT(0xF2, 0x48, 0x0F, 0x2C, 0xC0); // cvttsd2si rax, xmm0
+            emitStoreRaxToTop(assembler);
+            return 1;
+        case OP_outputInt:
+            emitOutput(assembler, jitOutputInt);
+            return 1;
+        case OP_outputDouble:
+            emitOutput(assembler, jitOutputDouble);
+            return 1;
+        case OP_outputBoolean:
+            emitOutput(assembler, jitOutputBoolean);
+            return 1;
+        case OP_jump:
+            memcpy(&jumpOffset, operands, 2);
+            emitBranchToBytecode(compilation, jmpOpcode, sizeof(jmpOpcode), offset+3+jumpOffset);
+            return 3;
+        case OP_jumpIfFalse:
+            memcpy(&jumpOffset, operands, 2);
+            emitReadBool(assembler, -8);
+            EMIT(0x48, 0x83, 0xEB, 0x08);   // sub rbx, 8
+            EMIT(0x85, 0xC0);               // test eax, eax
+            emitBranchToBytecode(compilation, jzOpcode, sizeof(jzOpcode), offset+3+jumpOffset);
+            return 3;
+        case OP_loop:
+            memcpy(&jumpOffset, operands, 2);
+            emitSafepoint(assembler, offset);
+            emitBranchToBytecode(compilation, jmpOpcode, sizeof(jmpOpcode), offset+3-jumpOffset);
+            return 3;
+        case OP_getLocal:
+            EMIT(0x49, 0x8B, 0x85);         // mov rax, [r13+slot]
+            emit32(assembler, slotDisplacement(operands[0]));
+            EMIT(0x48, 0x89, 0x03);         // mov [rbx], rax
+            EMIT(0x48, 0x83, 0xC3, 0x08);   // add rbx, 8
+            return 2;
+        case OP_setLocal:
+            EMIT(0x48, 0x83, 0xEB, 0x08);   // sub rbx, 8
+            EMIT(0x48, 0x8B, 0x03);         // mov rax, [rbx]
+            EMIT(0x49, 0x89, 0x85);         // mov [r13+slot], rax
+            emit32(assembler, slotDisplacement(operands[0]));
+            return 2;
+        case OP_countedLoop: {
+            memcpy(&jumpOffset, operands+3, 2);
+            emitSafepoint(assembler, offset);
+            EMIT(0x49, 0x8B, 0x85);         // mov rax, [r13+counter]
+            emit32(assembler, slotDisplacement(operands[0]));
+            EMIT(0x49, 0x3B, 0x85);         // cmp rax, [r13+bound]
+            emit32(assembler, slotDisplacement(operands[1]));
+            int done = emitBranchPlaceholder(assembler, jgeOpcode, sizeof(jgeOpcode));
+            EMIT(0x48, 0xFF, 0xC0);         // inc rax
+            EMIT(0x49, 0x89, 0x85);         // mov [r13+counter], rax
+            emit32(assembler, slotDisplacement(operands[0]));
+            EMIT(0x49, 0x89, 0x85);         // mov [r13+variable], rax
+            emit32(assembler, slotDisplacement(operands[2]));
+            emitBranchToBytecode(compilation, jmpOpcode, sizeof(jmpOpcode), offset+6-jumpOffset);
+            patchBranchHere(assembler, done);
+            return 6;
+        }
+        default:
+            // anything that touches objects, explicitly typed values, input or calls stays in the interpreter
+            return 0;
+    }
+}
+
+#undef EMIT
+
+// compiles the code from `entry` on, up to the first instruction without a template, and returns NULL if not even the instruction at entry
+// has one
+static JitFunction compileFrom(Chunk* chunk, int entry, size_t* codeSize) {
+    Compilation compilation = {{NULL, 0, 0}, NULL, NULL, 0, 0};
+    compilation.nativeOffsets = COMPILER_MEM_ALLOCATE(int, chunk->codeCount+1);
+    for (int i=0;i<=chunk->codeCount;i++) {
+        compilation.nativeOffsets[i] = -1;
+    }
+    Assembler* assembler = &compilation.assembler;
+    emitPrologue(assembler);
+    int offset = entry;
+    while (offset < chunk->codeCount) {
+        compilation.nativeOffsets[offset] = assembler->count;
+        const int length = compileInstruction(&compilation, chunk, offset);
+        if (length == 0) {
+            break;
+        }
+        offset += length;
+    }
+    bool compiled = offset != entry;
+    if (compiled) {
+        // the interpreter picks up at the first instruction without a template, or at the end of a chunk that doesn't end in a return
+        compilation.nativeOffsets[offset] = assembler->count;
+        emitExit(assembler, offset);
+        
+        // a branch to an instruction that wasn't compiled, which includes everything before the entry, leaves the native code there
+        for (int i=0;i<compilation.fixupsCount;i++) {
+            const BranchFixup fixup = compilation.fixups[i];
+            if (fixup.target < 0 || fixup.target > chunk->codeCount) {
+                compiled = false;
+                break;
+            }
+            if (compilation.nativeOffsets[fixup.target] == -1) {
+                compilation.nativeOffsets[fixup.target] = assembler->count;
+                emitExit(assembler, fixup.target);
+            }
+            patch32(assembler, fixup.position, (uint32_t)(compilation.nativeOffsets[fixup.target]-fixup.position-4));
+        }
+    }
+    COMPILER_FREE_ARRAY(int, compilation.nativeOffsets);
+    COMPILER_FREE_ARRAY(BranchFixup, compilation.fixups);
+    if (!compiled) {
+        // the instruction at the entry has no template, or a branch goes somewhere outside of the chunk
+        COMPILER_FREE_ARRAY(uint8_t, assembler->code);
+        return NULL;
+    }
+    
+    void* code = mmap(NULL, assembler->count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        COMPILER_FREE_ARRAY(uint8_t, assembler->code);
+        return NULL;
+    }
+    memcpy(code, assembler->code, assembler->count);
+    *codeSize = assembler->count;
+    COMPILER_FREE_ARRAY(uint8_t, assembler->code);
+    if (mprotect(code, *codeSize, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, *codeSize);
+        return NULL;
+    }
+    return (JitFunction)code;
+}
+
+void jitPrepareChunk(Chunk* chunk) {
+    if (chunk->jitSites != NULL) {
+        return;
+    }
+    chunk->jitSites = COMPILER_MEM_ALLOCATE(JitSite, chunk->codeCount);
+    for (int i=0;i<chunk->codeCount;i++) {
+        atomic_init(&chunk->jitSites[i].code, NULL);
+        atomic_init(&chunk->jitSites[i].hotness, 0);
+        atomic_init(&chunk->jitSites[i].attempted, false);
+        chunk->jitSites[i].codeSize = 0;
+    }
+}
+
+JitFunction jitFunctionAt(Chunk* chunk, int offset) {
+    // a chunk that isn't finalised is only ever run by one VM at a time, so it can get its sites here
+    jitPrepareChunk(chunk);
+    JitSite* site = &chunk->jitSites[offset];
+    JitFunction code = atomic_load_explicit(&site->code, memory_order_acquire);
+    if (code != NULL || atomic_load_explicit(&site->attempted, memory_order_relaxed)) {
+        return code;
+    }
+    if (atomic_fetch_add_explicit(&site->hotness, 1, memory_order_relaxed)+1 < JIT_HOTNESS_THRESHOLD) {
+        return NULL;
+    }
+    if (atomic_exchange_explicit(&site->attempted, true, memory_order_relaxed)) {
+        // another thread got there first, and the code shows up here once it is done
+        return NULL;
+    }
+    size_t codeSize = 0;
+    code = compileFrom(chunk, offset, &codeSize);
+    site->codeSize = codeSize;
+    // the release makes the code itself visible to the threads that load the pointer
+    atomic_store_explicit(&site->code, code, memory_order_release);
+    return code;
+}
+
+bool jitCompiledAt(Chunk* chunk, int offset) {
+    return chunk->jitSites != NULL && atomic_load_explicit(&chunk->jitSites[offset].code, memory_order_acquire) != NULL;
+}
+
+void jitFreeChunk(Chunk* chunk) {
+    if (chunk->jitSites == NULL) {
+        return;
+    }
+    for (int i=0;i<chunk->codeCount;i++) {
+        JitFunction code = atomic_load_explicit(&chunk->jitSites[i].code, memory_order_relaxed);
+        if (code != NULL) {
+            munmap((void*)code, chunk->jitSites[i].codeSize);
+        }
+    }
+    COMPILER_FREE_ARRAY(JitSite, chunk->jitSites);
+    chunk->jitSites = NULL;
+}
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef jit_h
+#define jit_h
+
+#include "common.h"
+#include "chunk.h"
+#include "VM.h"
+
+#ifdef USE_JIT
+
+#include <stdatomic.h>
+
+// how many times run() has to arrive at a loop header (through a backward branch) or a function entry (through a call) before the code from
+// there on is compiled to native code
+#define JIT_HOTNESS_THRESHOLD 1000
+
+// jitted code runs the program on the VM from the loop header or function entry it was compiled from, with the value stack and the frame
+// slots laid out exactly like in run(). it leaves vm->ip and vm->stackTop where it stopped and returns INTERPRET_OK for the interpreter to
+// carry on from there, or the reason a safepoint stopped the program, which can be resumed with resumeVM like one stopped by the interpreter
+typedef InterpretResult (*JitFunction)(VM* vm);
+
+// the tiering state of one bytecode offset. a chunk has one for every byte of its code, but only the loop headers and function entries are
+// ever counted. the fields are atomic since the VMs running a finalised chunk on different threads all count into the same sites
+typedef struct JitSite {
+    _Atomic(JitFunction) code;
+    atomic_int hotness;
+    atomic_bool attempted; // set by whichever thread compiles the site, so that it is only compiled once
+    size_t codeSize;
+} JitSite;
+
+// called by run() every time it arrives at a loop header or function entry. counts the arrival and returns the native code that runs the
+// program from `offset`, once the site is hot and could be compiled, or NULL
+JitFunction jitFunctionAt(Chunk* chunk, int offset);
+bool jitCompiledAt(Chunk* chunk, int offset);
+// gives a chunk its sites before it is finalised, since a finalised chunk can't be written to anymore
+void jitPrepareChunk(Chunk* chunk);
+void jitFreeChunk(Chunk* chunk);
+
+#endif
+
+#endif /* jit_h */
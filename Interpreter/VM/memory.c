@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include "memory.h"
 
 void* compilerReallocate(void* pointer, size_t newSize) {
@@ -9,3 +10,46 @@ void* compilerReallocate(void* pointer, size_t newSize) {
     void* result = realloc(pointer, newSize);
     return result;
 }
+
+void initHeap(Heap* heap) {
+    heap->objects = NULL;
+    heap->bytesAllocated = 0;
+    heap->objectsAllocated = 0;
+    heap->peakBytesAllocated = 0;
+    heap->bytesLimit = 0;
+}
+
+void* heapAllocate(Heap* heap, size_t size) {
+    if (size > SIZE_MAX-sizeof(HeapObjectHeader)) {
+        return NULL;
+    }
+    size_t allocationSize = sizeof(HeapObjectHeader)+size;
+    if (heap->bytesLimit != 0 && (allocationSize > heap->bytesLimit || heap->bytesAllocated > heap->bytesLimit-allocationSize)) {
+        return NULL;
+    }
+    HeapObjectHeader* header = compilerReallocate(NULL, allocationSize);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->next = heap->objects;
+    header->size = size;
+    heap->objects = header;
+    heap->bytesAllocated += allocationSize;
+    heap->objectsAllocated++;
+    if (heap->bytesAllocated > heap->peakBytesAllocated) {
+        heap->peakBytesAllocated = heap->bytesAllocated;
+    }
+    return header+1;
+}
+
+void freeHeap(Heap* heap) {
+    HeapObjectHeader* object = heap->objects;
+    while (object != NULL) {
+        HeapObjectHeader* next = object->next;
+        compilerReallocate(object, 0);
+        object = next;
+    }
+    size_t bytesLimit = heap->bytesLimit;
+    initHeap(heap);
+    heap->bytesLimit = bytesLimit;
+}
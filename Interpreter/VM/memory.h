@@ -24,4 +24,25 @@
 
 void* compilerReallocate(void* pointer, size_t newSize); // note that calls to the reallocate function may return null
 
+// everything a VM allocates while running a program goes into that VM's heap, so that it can be freed all at once when the run is over
+// and so that VMs on different threads never share objects. every allocation is preceded by a header that links it into the heap
+typedef struct HeapObjectHeader {
+    struct HeapObjectHeader* next;
+    size_t size;
+} HeapObjectHeader;
+
+// the counters are kept on every allocation, which costs a few adds and a compare next to the malloc, so they are always on
+typedef struct {
+    HeapObjectHeader* objects;
+    size_t bytesAllocated; // including the headers
+    size_t objectsAllocated;
+    size_t peakBytesAllocated; // the high-water mark of bytesAllocated since the heap was last freed
+    size_t bytesLimit; // how large bytesAllocated may get, or 0 for no limit. kept when the heap is freed
+} Heap;
+
+void initHeap(Heap* heap);
+// returns NULL when the allocation would take the heap over its limit or when the system is out of memory
+void* heapAllocate(Heap* heap, size_t size);
+void freeHeap(Heap* heap);
+
 #endif /* memory_h */
@@ -6,6 +6,7 @@
 #include "ExplicitlyTypedValue.h"
 
 typedef struct ObjString ObjString;
+typedef struct ObjInstance ObjInstance;
 
 static ObjString* allocateString(unsigned char* chars, long length) {
     ObjString* string = COMPILER_ALLOCATE_OBJ(ObjString);
@@ -20,3 +21,46 @@ ObjString* compilerCopyString(const char* chars, long length) {
     
     return allocateString(heapAllocatedChars, length);
 }
+
+ObjString* heapCopyString(Heap* heap, const char* chars, long length) {
+    // the characters go right after the string in the same allocation, with a terminating zero that isn't part of the length so that
+    // they can be handed to the C string functions
+    ObjString* string = heapAllocate(heap, sizeof(ObjString)+length+1);
+    if (string == NULL) {
+        return NULL;
+    }
+    string->length = length;
+    string->data = (unsigned char*)(string+1);
+    memcpy(string->data, chars, length);
+    string->data[length] = '\0';
+    
+    return string;
+}
+
+ObjString* concatenateStrings(Heap* heap, const ObjString* lhs, const ObjString* rhs) {
+    // laid out like heapCopyString lays out a string, terminating zero included
+    long length = lhs->length + rhs->length;
+    ObjString* string = heapAllocate(heap, sizeof(ObjString)+length+1);
+    if (string == NULL) {
+        return NULL;
+    }
+    string->length = length;
+    string->data = (unsigned char*)(string+1);
+    memcpy(string->data, lhs->data, lhs->length);
+    memcpy(string->data+lhs->length, rhs->data, rhs->length);
+    string->data[length] = '\0';
+    
+    return string;
+}
+
+ObjInstance* allocateInstance(Heap* heap, int classId, int fieldWords) {
+    ObjInstance* instance = heapAllocate(heap, sizeof(ObjInstance)+sizeof(uint64_t)*fieldWords);
+    if (instance == NULL) {
+        return NULL;
+    }
+    instance->classId = classId;
+    instance->fieldWords = fieldWords;
+    // every field starts out zeroed, which is 0, 0.0, false or a null object until the initializer sets it
+    memset(instance->fields, 0, sizeof(uint64_t)*fieldWords);
+    return instance;
+}
@@ -1,6 +1,9 @@
 #ifndef object_h
 #define object_h
 
+#include <stdint.h>
+#include "memory.h"
+
 struct ObjString {
     long length;
     unsigned char* data;
@@ -11,10 +14,19 @@ struct ObjArray {
     unsigned long* data;
 };
 
+// an instance is a single allocation: a header followed by its fields inline. the field opcodes address fields by fixed word offsets,
+// meant to be laid out with a subclass's own fields appended after its superclass's, so a subclass instance is also a valid superclass instance.
+// fields stored as ExplicitlyTypedValues (objects and Any) take two words, everything else takes one
 struct ObjInstance {
-    long* fields;
+    int classId; // the runtime id of the class the instance was allocated as
+    int fieldWords;
+    uint64_t fields[];
 };
 
 struct ObjString* compilerCopyString(const char* chars, long length);
+// objects created by a running program live in the running VM's heap. these return NULL when the heap can't fit the object
+struct ObjString* heapCopyString(Heap* heap, const char* chars, long length);
+struct ObjString* concatenateStrings(Heap* heap, const struct ObjString* lhs, const struct ObjString* rhs);
+struct ObjInstance* allocateInstance(Heap* heap, int classId, int fieldWords);
 
 #endif /* object_h */
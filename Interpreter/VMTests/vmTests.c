@@ -0,0 +1,973 @@
+// tests for the VM that don't go through the compiler: every test builds the chunk it runs by hand. build and run them from this directory
+// with
+//     cc -std=gnu11 -I../VM ../VM/*.c vmTests.c -o vmTests -lpthread && ./vmTests
+// and again with -DUSE_JIT added to run the chunks as native code where they can be. the debug options in common.h print to stdout, so
+// the results go to stderr. instead of the tests, ./vmTests hostScalingBenchmark [runs] [maxThreads] and ./vmTests recursionBenchmark [maxDepth]
+// run the benchmarks, which print to stdout. they only mean something with DEBUG_TRACE_EXECUTION and TIME_EXECUTION commented out in common.h
+
+#include "VM.h"
+#include "host.h"
+#include "ExplicitlyTypedValue.h"
+#include "object.h"
+#include "benchmark.h"
+#include "jit.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+static int failures = 0;
+
+#define CHECK(condition) \
+do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: %s failed\n", __func__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (false)
+
+// runtime id 0 is never a class, which is why the table starts with an empty name. the lengths count the terminating zero
+static const char* classNames[] = {"", "String"};
+static const int classNamesLength[] = {1, 7};
+static const int classesCount = 2;
+
+static VM* makeVM(void) {
+    VM* vm = initVM(classNames, classNamesLength, classesCount);
+    vm->bufferOutput = true;
+    return vm;
+}
+
+static void writeOpWithByte(Chunk* chunk, uint8_t op, uint8_t byte) {
+    writeChunk(chunk, op, 1);
+    writeChunk(chunk, byte, 1);
+}
+
+static void writeLongConstant(Chunk* chunk, long value) {
+    writeChunk(chunk, OP_loadEmbeddedLongConstant, 1);
+    writeChunkLong(chunk, value, 1);
+}
+
+// writes a forward jump whose offset is filled in by patchJump, and returns where the offset is
+static int writeJump(Chunk* chunk, uint8_t op) {
+    writeChunk(chunk, op, 1);
+    writeChunkShort(chunk, 0, 1);
+    return getChunkCodeCount(chunk)-2;
+}
+
+static void patchJump(Chunk* chunk, int operandOffset) {
+    patchChunkShort(chunk, operandOffset, getChunkCodeCount(chunk)-operandOffset-2);
+}
+
+// the offset of a backward branch ending at the current end of the chunk, which is measured from the end of the instruction
+static void writeBackwardsOffset(Chunk* chunk, int target) {
+    writeChunkShort(chunk, getChunkCodeCount(chunk)+2-target, 1);
+}
+
+// checks the output the VM buffered since it was last taken, and takes it
+static void checkOutput(VM* vm, const char* expected) {
+    size_t length;
+    char* output = takeVMOutput(vm, &length);
+    bool matches = length == strlen(expected) && (length == 0 || memcmp(output, expected, length) == 0);
+    if (!matches) {
+        fprintf(stderr, "expected output \"%s\", got \"%.*s\"\n", expected, (int)length, output == NULL ? "" : output);
+    }
+    CHECK(matches);
+    free(output);
+}
+
+// a concatenation is laid out like a copied string, with a terminating zero that the heap counts like the rest of it
+static void testConcatenatedStringIsTerminated(void) {
+    Heap heap;
+    initHeap(&heap);
+    struct ObjString* lhs = heapCopyString(&heap, "foo", 3);
+    struct ObjString* rhs = heapCopyString(&heap, "bar!", 4);
+    size_t before = heap.bytesAllocated;
+    struct ObjString* joined = concatenateStrings(&heap, lhs, rhs);
+    CHECK(joined != NULL);
+    CHECK(joined->length == 7);
+    CHECK(strcmp((const char*)joined->data, "foobar!") == 0);
+    CHECK(heap.bytesAllocated-before == sizeof(HeapObjectHeader)+sizeof(struct ObjString)+7+1);
+    CHECK(heap.objectsAllocated == 3);
+
+    // one byte short of the concatenation, counting its terminating zero
+    heap.bytesLimit = heap.bytesAllocated+sizeof(HeapObjectHeader)+sizeof(struct ObjString)+7;
+    CHECK(concatenateStrings(&heap, lhs, rhs) == NULL);
+    heap.bytesLimit += 1;
+    CHECK(concatenateStrings(&heap, lhs, rhs) != NULL);
+    freeHeap(&heap);
+}
+
+static void testInputStringIsOutputBack(void) {
+    Chunk* chunk = initChunk();
+    writeChunk(chunk, OP_inputString, 1);
+    writeChunk(chunk, OP_outputString, 1);
+    writeChunk(chunk, OP_inputString, 1);
+    writeOpWithByte(chunk, OP_outputAny, 0);
+    writeChunk(chunk, OP_return, 1);
+
+    VM* vm = makeVM();
+    CHECK(vm->stringClassId == 1);
+    CHECK(interpret(vm, chunk) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "hello", 5) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "world", 5) == INTERPRET_OK);
+    checkOutput(vm, "hello\nworld\n");
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+static void testInputStringWithoutStringClass(void) {
+    const char* names[] = {"", "Object"};
+    const int lengths[] = {1, 7};
+    CHECK(initVM(names, lengths, 2) == NULL);
+
+    Chunk* chunk = initChunk();
+    writeChunk(chunk, OP_inputString, 1);
+    writeChunk(chunk, OP_outputString, 1);
+    writeChunk(chunk, OP_return, 1);
+    VM* vm = initVM(NULL, NULL, 0);
+    vm->bufferOutput = true;
+    CHECK(interpret(vm, chunk) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "hello", 5) == INTERPRET_RUNTIME_ERROR);
+    checkOutput(vm, "");
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+typedef struct {
+    VM* vm;
+    const char* input;
+    InterpretResult result;
+} Resumption;
+
+static void* resumeOnThread(void* argument) {
+    Resumption* resumption = argument;
+    resumption->result = resumeWithInput(resumption->vm, resumption->input, strlen(resumption->input));
+    return NULL;
+}
+
+// the program suspends on every input instruction and carries on where it stopped once it has the line, including on another thread
+static void testSuspendAndResume(void) {
+    Chunk* chunk = initChunk();
+    writeChunk(chunk, OP_inputInt, 1);
+    writeChunk(chunk, OP_inputInt, 1);
+    writeChunk(chunk, OP_addInt, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_inputDouble, 1);
+    writeChunk(chunk, OP_outputDouble, 1);
+    writeChunk(chunk, OP_inputAny, 1);
+    writeOpWithByte(chunk, OP_outputAny, 0);
+    writeChunk(chunk, OP_inputInt, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+
+    VM* vm = makeVM();
+    CHECK(interpret(vm, chunk) == INTERPRET_NEEDS_INPUT);
+    checkOutput(vm, "");
+    CHECK(resumeWithInput(vm, "40", 2) == INTERPRET_NEEDS_INPUT);
+    Resumption resumption = {vm, "2", INTERPRET_OK};
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, resumeOnThread, &resumption) == 0);
+    pthread_join(thread, NULL);
+    CHECK(resumption.result == INTERPRET_NEEDS_INPUT);
+    checkOutput(vm, "42\n");
+    CHECK(resumeWithInput(vm, "2.5", 3) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "seven", 5) == INTERPRET_NEEDS_INPUT);
+    checkOutput(vm, "2.500000\nseven\n");
+    // the whole line has to be the number
+    CHECK(resumeWithInput(vm, "7 apples", 8) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "Cannot cast input to type Int") == 0);
+    checkOutput(vm, "");
+
+    // the VM can start over once it is reset
+    resetVM(vm);
+    CHECK(interpret(vm, chunk) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "1", 1) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeWithInput(vm, "1", 1) == INTERPRET_NEEDS_INPUT);
+    checkOutput(vm, "2\n");
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+// runs the chunk on fresh VMs and checks that every run gives the same result and output as the first one. the first run is interpreted,
+// as long as none of its loops gets to JIT_HOTNESS_THRESHOLD on its own. with USE_JIT, the hotness adds up over the runs, so the loops get
+// compiled at some point in one of the runs after it. that run switches to native code halfway through, and the runs after it are native
+// from the first back edge on. the runs stop at the first of those, once the loop at loopHeader is compiled
+static void checkInterpretedAndNativeAgree(Chunk* chunk, int loopHeader, const char* expected) {
+    (void)loopHeader; // only looked at with USE_JIT
+    InterpretResult firstResult = INTERPRET_OK;
+    char* firstOutput = NULL;
+    size_t firstLength = 0;
+    for (int run=0;;run++) {
+#ifdef USE_JIT
+        const bool nativeFromTheStart = jitCompiledAt(chunk, loopHeader);
+        CHECK(run != 0 || !nativeFromTheStart);
+#endif
+        VM* vm = makeVM();
+        InterpretResult result = interpret(vm, chunk);
+        size_t length;
+        char* output = takeVMOutput(vm, &length);
+        freeVM(vm);
+        if (run == 0) {
+            firstResult = result;
+            firstOutput = output;
+            firstLength = length;
+        } else {
+            bool agree = result == firstResult && length == firstLength && (length == 0 || memcmp(output, firstOutput, length) == 0);
+            if (!agree) {
+                fprintf(stderr, "interpreted run gave \"%.*s\", run %d \"%.*s\"\n", (int)firstLength, firstOutput == NULL ? "" : firstOutput,
+                        run, (int)length, output == NULL ? "" : output);
+            }
+            CHECK(agree);
+            free(output);
+        }
+#ifdef USE_JIT
+        if (nativeFromTheStart || run > 2*JIT_HOTNESS_THRESHOLD) {
+            CHECK(nativeFromTheStart);
+            break;
+        }
+#else
+        break;
+#endif
+    }
+    CHECK(firstResult == INTERPRET_OK);
+    if (expected != NULL) {
+        CHECK(firstLength == strlen(expected) && (firstLength == 0 || memcmp(firstOutput, expected, firstLength) == 0));
+    }
+    free(firstOutput);
+}
+
+// loop total from 1 to 10 the way the compiler lowers it, with the counter and the bound in hidden slots, followed by a while loop counting
+// down with an if inside
+static void testLoops(void) {
+    enum { counter, bound, variable, total, n };
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, 5);
+    writeLongConstant(chunk, 1);
+    writeOpWithByte(chunk, OP_setLocal, counter);
+    writeLongConstant(chunk, 10);
+    writeOpWithByte(chunk, OP_setLocal, bound);
+    writeLongConstant(chunk, 0);
+    writeOpWithByte(chunk, OP_setLocal, total);
+    writeOpWithByte(chunk, OP_getLocal, counter);
+    writeOpWithByte(chunk, OP_getLocal, bound);
+    writeChunk(chunk, OP_lessOrEqualInt, 1);
+    int exitJump = writeJump(chunk, OP_jumpIfFalse);
+    writeOpWithByte(chunk, OP_getLocal, counter);
+    writeOpWithByte(chunk, OP_setLocal, variable);
+    int bodyStart = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeOpWithByte(chunk, OP_getLocal, variable);
+    writeChunk(chunk, OP_addInt, 1);
+    writeOpWithByte(chunk, OP_setLocal, total);
+    writeOpWithByte(chunk, OP_countedLoop, counter);
+    writeChunk(chunk, bound, 1);
+    writeChunk(chunk, variable, 1);
+    writeBackwardsOffset(chunk, bodyStart);
+    patchJump(chunk, exitJump);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeChunk(chunk, OP_outputInt, 1);
+
+    writeLongConstant(chunk, 4);
+    writeOpWithByte(chunk, OP_setLocal, n);
+    int loopStart = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_getLocal, n);
+    writeLongConstant(chunk, 0);
+    writeChunk(chunk, OP_greaterInt, 1);
+    int whileExitJump = writeJump(chunk, OP_jumpIfFalse);
+    writeOpWithByte(chunk, OP_getLocal, n);
+    writeLongConstant(chunk, 2);
+    writeChunk(chunk, OP_equalEqualInt, 1);
+    int elseJump = writeJump(chunk, OP_jumpIfFalse);
+    writeChunk(chunk, OP_true, 1);
+    writeChunk(chunk, OP_outputBoolean, 1);
+    int endIfJump = writeJump(chunk, OP_jump);
+    patchJump(chunk, elseJump);
+    writeOpWithByte(chunk, OP_getLocal, n);
+    writeChunk(chunk, OP_outputInt, 1);
+    patchJump(chunk, endIfJump);
+    writeOpWithByte(chunk, OP_getLocal, n);
+    writeLongConstant(chunk, 1);
+    writeChunk(chunk, OP_minusInt, 1);
+    writeOpWithByte(chunk, OP_setLocal, n);
+    writeChunk(chunk, OP_loop, 1);
+    writeBackwardsOffset(chunk, loopStart);
+    patchJump(chunk, whileExitJump);
+    writeChunk(chunk, OP_return, 1);
+
+    // the native code of the first loop runs the while loop after it as well
+    checkInterpretedAndNativeAgree(chunk, bodyStart, "55\n4\n3\ntrue\n1\n");
+    freeChunk(chunk);
+}
+
+// loop i from 1 to 5000, then outputs i. the loop starts at loopHeader
+static Chunk* makeCountingLoop(int* loopHeader) {
+    enum { counter, bound, variable };
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, 3);
+    writeLongConstant(chunk, 1);
+    writeOpWithByte(chunk, OP_setLocal, counter);
+    writeLongConstant(chunk, 5000);
+    writeOpWithByte(chunk, OP_setLocal, bound);
+    *loopHeader = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_countedLoop, counter);
+    writeChunk(chunk, bound, 1);
+    writeChunk(chunk, variable, 1);
+    writeBackwardsOffset(chunk, *loopHeader);
+    writeOpWithByte(chunk, OP_getLocal, variable);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+    return chunk;
+}
+
+// a loop that runs out of its budget many times over, and is resumed every time, counts exactly as far as one that runs in one go
+static void testLoopResumedAfterBudget(void) {
+    int loopHeader;
+    Chunk* chunk = makeCountingLoop(&loopHeader);
+
+    // with USE_JIT, the loop gets hot partway through the first run, and the second run is native from its first back edge on
+    for (int i=0;i<2;i++) {
+        VM* vm = makeVM();
+        setVMBudget(vm, 100, 0);
+        int stops = 0;
+        InterpretResult result = interpret(vm, chunk);
+        while (result == INTERPRET_OUT_OF_BUDGET && stops < 1000) {
+            stops++;
+            result = resumeVM(vm);
+        }
+        CHECK(result == INTERPRET_OK);
+        CHECK(stops >= 40);
+        checkOutput(vm, "5000\n");
+        freeVM(vm);
+    }
+#ifdef USE_JIT
+    CHECK(jitCompiledAt(chunk, loopHeader));
+#endif
+    freeChunk(chunk);
+}
+
+// an interrupt that comes in before the program starts stops it at its first check, and one that no program saw is dropped by resetVM
+static void testInterruptBeforeStart(void) {
+    int loopHeader;
+    Chunk* chunk = makeCountingLoop(&loopHeader);
+    VM* vm = makeVM();
+    requestInterrupt(vm);
+    CHECK(interpret(vm, chunk) == INTERPRET_INTERRUPTED);
+    checkOutput(vm, "");
+    CHECK(resumeVM(vm) == INTERPRET_OK);
+    checkOutput(vm, "5000\n");
+
+    requestInterrupt(vm);
+    resetVM(vm);
+    CHECK(interpret(vm, chunk) == INTERPRET_OK);
+    checkOutput(vm, "5000\n");
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+// a resume that doesn't match how the program stopped is turned down, and leaves the program waiting for the right one
+static void testResumeChecksRunState(void) {
+    VM* vm = makeVM();
+    CHECK(resumeVM(vm) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "There is no stopped program to resume") == 0);
+    CHECK(resumeWithInput(vm, "hello", 5) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "There is no program waiting on input") == 0);
+
+    Chunk* reading = initChunk();
+    writeChunk(reading, OP_inputString, 1);
+    writeChunk(reading, OP_outputString, 1);
+    writeChunk(reading, OP_return, 1);
+    CHECK(interpret(vm, reading) == INTERPRET_NEEDS_INPUT);
+    CHECK(resumeVM(vm) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "The program is waiting on input, which only resumeWithInput can give it") == 0);
+    CHECK(resumeWithInput(vm, "hello", 5) == INTERPRET_OK);
+    checkOutput(vm, "hello\n");
+    CHECK(resumeWithInput(vm, "world", 5) == INTERPRET_RUNTIME_ERROR);
+    CHECK(resumeVM(vm) == INTERPRET_RUNTIME_ERROR);
+    checkOutput(vm, "");
+
+    int loopHeader;
+    Chunk* counting = makeCountingLoop(&loopHeader);
+    requestInterrupt(vm);
+    CHECK(interpret(vm, counting) == INTERPRET_INTERRUPTED);
+    CHECK(resumeWithInput(vm, "hello", 5) == INTERPRET_RUNTIME_ERROR);
+    CHECK(resumeVM(vm) == INTERPRET_OK);
+    checkOutput(vm, "5000\n");
+
+    // a reset VM has nothing left to resume
+    requestInterrupt(vm);
+    CHECK(interpret(vm, counting) == INTERPRET_INTERRUPTED);
+    resetVM(vm);
+    CHECK(resumeVM(vm) == INTERPRET_RUNTIME_ERROR);
+    checkOutput(vm, "");
+    freeVM(vm);
+    freeChunk(reading);
+    freeChunk(counting);
+}
+
+// every program starts with its slots zeroed, whatever the program before it left in them
+static void testSlotsStartZeroed(void) {
+    Chunk* setting = initChunk();
+    setLocalsCount(setting, 2);
+    writeLongConstant(setting, 42);
+    writeOpWithByte(setting, OP_setLocal, 1);
+    writeChunk(setting, OP_return, 1);
+    Chunk* reading = initChunk();
+    setLocalsCount(reading, 2);
+    writeOpWithByte(reading, OP_getLocal, 1);
+    writeChunk(reading, OP_outputInt, 1);
+    writeChunk(reading, OP_return, 1);
+
+    VM* vm = makeVM();
+    CHECK(interpret(vm, setting) == INTERPRET_OK);
+    CHECK(interpret(vm, reading) == INTERPRET_OK);
+    checkOutput(vm, "0\n");
+    CHECK(interpret(vm, setting) == INTERPRET_OK);
+    resetVM(vm);
+    CHECK(interpret(vm, reading) == INTERPRET_OK);
+    checkOutput(vm, "0\n");
+    freeVM(vm);
+    freeChunk(setting);
+    freeChunk(reading);
+}
+
+// instances are output with their class name, and arrays, which nothing in the VM creates yet, are a runtime error instead of printing nothing
+static void testOutputObjectsAndArrays(void) {
+    const char* names[] = {"", "String", "Point"};
+    const int lengths[] = {1, 7, 6};
+    VM* vm = initVM(names, lengths, 3);
+    vm->bufferOutput = true;
+    Chunk* instance = initChunk();
+    writeChunk(instance, OP_allocateInstance, 1);
+    writeChunkUInt(instance, 2, 1);
+    writeChunkShort(instance, 0, 1);
+    writeChunk(instance, OP_outputClass, 1);
+    writeChunk(instance, OP_outputVoid, 1);
+    writeChunk(instance, OP_return, 1);
+    CHECK(interpret(vm, instance) == INTERPRET_OK);
+    checkOutput(vm, "<Instance of Point>\nnil\n");
+
+    // an Any holding an array of ints. the array itself is never looked at
+    Chunk* anyArray = initChunk();
+    writeChunk(anyArray, OP_loadEmbeddedExplicitlyTypedConstant, 1);
+    ExplicitlyTypedValue array = {0, 1, {.object = NULL}};
+    uint64_t words[2];
+    memcpy(words, &array, sizeof(words));
+    writeChunkLong(anyArray, words[0], 1);
+    writeChunkLong(anyArray, words[1], 1);
+    writeOpWithByte(anyArray, OP_outputAny, 0);
+    writeChunk(anyArray, OP_return, 1);
+    resetVM(vm);
+    CHECK(interpret(vm, anyArray) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "Outputting arrays is not supported by the VM yet") == 0);
+
+    Chunk* typedArray = initChunk();
+    writeChunk(typedArray, OP_loadEmbeddedExplicitlyTypedConstant, 1);
+    writeChunkLong(typedArray, words[0], 1);
+    writeChunkLong(typedArray, words[1], 1);
+    writeChunk(typedArray, OP_outputArray, 1);
+    writeChunk(typedArray, OP_return, 1);
+    resetVM(vm);
+    CHECK(interpret(vm, typedArray) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "Outputting arrays is not supported by the VM yet") == 0);
+    checkOutput(vm, "");
+    freeVM(vm);
+    freeChunk(instance);
+    freeChunk(anyArray);
+    freeChunk(typedArray);
+}
+
+// an instance kept in two frame slots, with an int field at offset 0 and a field holding the instance itself at offsets 1 and 2
+static void testInstanceFields(void) {
+    const char* names[] = {"", "String", "Node"};
+    const int lengths[] = {1, 7, 5};
+    VM* vm = initVM(names, lengths, 3);
+    vm->bufferOutput = true;
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, 4);
+    writeChunk(chunk, OP_allocateInstance, 1);
+    writeChunkUInt(chunk, 2, 1);
+    writeChunkShort(chunk, 3, 1);
+    writeOpWithByte(chunk, OP_setLocal, 1);
+    writeOpWithByte(chunk, OP_setLocal, 0);
+
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeLongConstant(chunk, 7);
+    writeChunk(chunk, OP_setField, 1);
+    writeChunkShort(chunk, 0, 1);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeChunk(chunk, OP_setFieldExplicitlyTyped, 1);
+    writeChunkShort(chunk, 1, 1);
+
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeChunk(chunk, OP_getField, 1);
+    writeChunkShort(chunk, 0, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeChunk(chunk, OP_getFieldExplicitlyTyped, 1);
+    writeChunkShort(chunk, 1, 1);
+    writeChunk(chunk, OP_getField, 1);
+    writeChunkShort(chunk, 0, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 1);
+    writeChunk(chunk, OP_getFieldExplicitlyTyped, 1);
+    writeChunkShort(chunk, 1, 1);
+    writeChunk(chunk, OP_outputClass, 1);
+
+    // slots 2 and 3 were never set, so they hold a null instance
+    writeOpWithByte(chunk, OP_getLocal, 2);
+    writeOpWithByte(chunk, OP_getLocal, 3);
+    writeChunk(chunk, OP_getField, 1);
+    writeChunkShort(chunk, 0, 1);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+
+    CHECK(interpret(vm, chunk) == INTERPRET_RUNTIME_ERROR);
+    CHECK(strcmp(vm->runtimeErrorMessage, "Accessing a field of an instance that was never set") == 0);
+    checkOutput(vm, "7\n7\n<Instance of Node>\n");
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+// a tiny deterministic generator, so that a failing program can be rebuilt from its seed
+static uint64_t randomState;
+
+static int randomBelow(int bound) {
+    randomState = randomState*6364136223846793005ULL+1442695040888963407ULL;
+    return (int)((randomState >> 33)%(uint64_t)bound);
+}
+
+enum { generatedLocalsCount = 4 };
+
+static void writeDoubleConstant(Chunk* chunk, double value) {
+    long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeLongConstant(chunk, bits);
+}
+
+static void writeRandomDouble(Chunk* chunk, int depth);
+static void writeRandomBool(Chunk* chunk, int depth);
+
+// the values stay small enough that nothing overflows, and every divisor is a constant that isn't zero
+static void writeRandomInt(Chunk* chunk, int depth) {
+    int choice = depth == 0 ? randomBelow(3) : randomBelow(10);
+    switch (choice) {
+        case 0:
+            writeLongConstant(chunk, randomBelow(201)-100);
+            return;
+        case 1:
+            writeOpWithByte(chunk, OP_loadEmbeddedByteConstant, (uint8_t)randomBelow(100));
+            return;
+        case 2:
+            writeOpWithByte(chunk, OP_getLocal, (uint8_t)randomBelow(generatedLocalsCount));
+            return;
+        case 3:
+            writeRandomInt(chunk, depth-1);
+            writeChunk(chunk, OP_negateInt, 1);
+            return;
+        case 4: {
+            const uint8_t ops[] = {OP_addInt, OP_minusInt, OP_multiplyInt};
+            writeRandomInt(chunk, depth-1);
+            writeRandomInt(chunk, depth-1);
+            writeChunk(chunk, ops[randomBelow(3)], 1);
+            return;
+        }
+        case 5: {
+            const uint8_t ops[] = {OP_divideInt, OP_intDivideInt, OP_modInt};
+            writeRandomInt(chunk, depth-1);
+            writeLongConstant(chunk, randomBelow(2) == 0 ? randomBelow(9)+1 : -(randomBelow(9)+1));
+            writeChunk(chunk, ops[randomBelow(3)], 1);
+            return;
+        }
+        case 6: {
+            writeRandomDouble(chunk, depth-1);
+            writeDoubleConstant(chunk, (randomBelow(16)+1)/4.0);
+            writeChunk(chunk, OP_intDivideDouble, 1);
+            return;
+        }
+        default: {
+            // if then else as an expression, through a local so that the stack is balanced on both branches
+            uint8_t slot = (uint8_t)randomBelow(generatedLocalsCount);
+            writeRandomBool(chunk, depth-1);
+            int elseJump = writeJump(chunk, OP_jumpIfFalse);
+            writeRandomInt(chunk, depth-1);
+            writeOpWithByte(chunk, OP_setLocal, slot);
+            int endJump = writeJump(chunk, OP_jump);
+            patchJump(chunk, elseJump);
+            writeRandomInt(chunk, depth-1);
+            writeOpWithByte(chunk, OP_setLocal, slot);
+            patchJump(chunk, endJump);
+            writeOpWithByte(chunk, OP_getLocal, slot);
+            return;
+        }
+    }
+}
+
+static void writeRandomDouble(Chunk* chunk, int depth) {
+    int choice = depth == 0 ? 0 : randomBelow(4);
+    switch (choice) {
+        case 0:
+            writeDoubleConstant(chunk, (randomBelow(2001)-1000)/8.0);
+            return;
+        case 1:
+            writeRandomDouble(chunk, depth-1);
+            writeChunk(chunk, OP_negateDouble, 1);
+            return;
+        case 2: {
+            const uint8_t ops[] = {OP_addDouble, OP_minusDouble, OP_multiplyDouble};
+            writeRandomDouble(chunk, depth-1);
+            writeRandomDouble(chunk, depth-1);
+            writeChunk(chunk, ops[randomBelow(3)], 1);
+            return;
+        }
+        default:
+            writeRandomDouble(chunk, depth-1);
+            writeDoubleConstant(chunk, (randomBelow(16)+1)/4.0);
+            writeChunk(chunk, OP_divideDouble, 1);
+            return;
+    }
+}
+
+static void writeRandomBool(Chunk* chunk, int depth) {
+    int choice = depth == 0 ? randomBelow(2) : randomBelow(6);
+    switch (choice) {
+        case 0:
+            writeChunk(chunk, OP_true, 1);
+            return;
+        case 1:
+            writeChunk(chunk, OP_false, 1);
+            return;
+        case 2: {
+            const uint8_t ops[] = {OP_greaterInt, OP_greaterOrEqualInt, OP_lessInt, OP_lessOrEqualInt, OP_equalEqualInt, OP_notEqualInt};
+            writeRandomInt(chunk, depth-1);
+            writeRandomInt(chunk, depth-1);
+            writeChunk(chunk, ops[randomBelow(6)], 1);
+            return;
+        }
+        case 3: {
+            const uint8_t ops[] = {OP_greaterDouble, OP_greaterOrEqualDouble, OP_lessDouble, OP_lessOrEqualDouble, OP_equalEqualDouble,
+                OP_notEqualDouble};
+            writeRandomDouble(chunk, depth-1);
+            writeRandomDouble(chunk, depth-1);
+            writeChunk(chunk, ops[randomBelow(6)], 1);
+            return;
+        }
+        default: {
+            const uint8_t ops[] = {OP_equalEqualBool, OP_notEqualBool, OP_orBool, OP_andBool};
+            writeRandomBool(chunk, depth-1);
+            writeRandomBool(chunk, depth-1);
+            writeChunk(chunk, ops[randomBelow(4)], 1);
+            return;
+        }
+    }
+}
+
+// a straight-line program of outputs and assignments to the locals, with the branches coming from the if expressions in it. it runs
+// generatedIterations times in a counted loop starting at loopHeader, so that the JIT gets to compile it
+enum { generatedIterations = 50 };
+
+static Chunk* makeRandomProgram(uint64_t seed, int* loopHeader) {
+    enum { counter = generatedLocalsCount, bound, variable };
+    randomState = seed;
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, generatedLocalsCount+3);
+    writeLongConstant(chunk, 1);
+    writeOpWithByte(chunk, OP_setLocal, counter);
+    writeLongConstant(chunk, generatedIterations);
+    writeOpWithByte(chunk, OP_setLocal, bound);
+    *loopHeader = getChunkCodeCount(chunk);
+    // every iteration starts from the same locals, so that nothing adds up over the iterations until it overflows
+    for (int slot=0;slot<generatedLocalsCount;slot++) {
+        writeLongConstant(chunk, randomBelow(21)-10);
+        writeOpWithByte(chunk, OP_setLocal, (uint8_t)slot);
+    }
+    int statements = randomBelow(20)+1;
+    for (int i=0;i<statements;i++) {
+        switch (randomBelow(5)) {
+            case 0:
+                writeRandomInt(chunk, 3);
+                writeChunk(chunk, OP_outputInt, 1);
+                break;
+            case 1:
+                writeRandomDouble(chunk, 3);
+                writeChunk(chunk, OP_outputDouble, 1);
+                break;
+            case 2:
+                writeRandomBool(chunk, 3);
+                writeChunk(chunk, OP_outputBoolean, 1);
+                break;
+            case 3:
+                writeLongConstant(chunk, randomBelow(201)-100);
+                writeOpWithByte(chunk, OP_setLocal, (uint8_t)randomBelow(generatedLocalsCount));
+                break;
+            default:
+                writeRandomInt(chunk, 2);
+                writeRandomBool(chunk, 2);
+                writeOpWithByte(chunk, OP_pop_n, 2);
+                writeRandomInt(chunk, 1);
+                writeChunk(chunk, OP_pop, 1);
+                break;
+        }
+    }
+    writeOpWithByte(chunk, OP_countedLoop, counter);
+    writeChunk(chunk, bound, 1);
+    writeChunk(chunk, variable, 1);
+    writeBackwardsOffset(chunk, *loopHeader);
+    writeChunk(chunk, OP_return, 1);
+    return chunk;
+}
+
+static void testRandomProgramsAgree(void) {
+    for (uint64_t seed=1;seed<=100;seed++) {
+        int loopHeader;
+        Chunk* chunk = makeRandomProgram(seed, &loopHeader);
+        int failuresBefore = failures;
+        checkInterpretedAndNativeAgree(chunk, loopHeader, NULL);
+        if (failures != failuresBefore) {
+            fprintf(stderr, "in the program generated from seed %llu\n", (unsigned long long)seed);
+        }
+        freeChunk(chunk);
+    }
+}
+
+// a single run of a long loop is enough to get it compiled, also when the code before the loop has no templates
+static void testHotLoopCompiledWithinOneRun(void) {
+    enum { counter, bound, variable, total };
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, 4);
+    // not has no template
+    writeChunk(chunk, OP_true, 1);
+    writeChunk(chunk, OP_notBool, 1);
+    writeChunk(chunk, OP_pop, 1);
+    writeLongConstant(chunk, 1);
+    writeOpWithByte(chunk, OP_setLocal, counter);
+    writeOpWithByte(chunk, OP_getLocal, counter);
+    writeOpWithByte(chunk, OP_setLocal, variable);
+    writeLongConstant(chunk, 5000);
+    writeOpWithByte(chunk, OP_setLocal, bound);
+    int loopHeader = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeOpWithByte(chunk, OP_getLocal, variable);
+    writeChunk(chunk, OP_addInt, 1);
+    writeOpWithByte(chunk, OP_setLocal, total);
+    writeOpWithByte(chunk, OP_countedLoop, counter);
+    writeChunk(chunk, bound, 1);
+    writeChunk(chunk, variable, 1);
+    writeBackwardsOffset(chunk, loopHeader);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+
+    VM* vm = makeVM();
+    CHECK(interpret(vm, chunk) == INTERPRET_OK);
+    checkOutput(vm, "12502500\n");
+#ifdef USE_JIT
+    CHECK(jitCompiledAt(chunk, loopHeader));
+#endif
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+static void writeCall(Chunk* chunk, uint8_t op, uint32_t entry, uint8_t argumentWords, uint16_t localsCount) {
+    writeChunk(chunk, op, 1);
+    writeChunkUInt(chunk, entry, 1);
+    writeChunk(chunk, argumentWords, 1);
+    writeChunkShort(chunk, localsCount, 1);
+}
+
+// function square(x) returns x*x, called in a loop often enough for its entry to get hot. the native code of the function hands the program
+// back at the return, and the native code of the loop at the call, so the program goes back and forth between the two
+static void testHotFunctionCompiled(void) {
+    enum { counter, bound, variable, total };
+    Chunk* chunk = initChunk();
+    setLocalsCount(chunk, 4);
+    int skipFunction = writeJump(chunk, OP_jump);
+    int entry = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeOpWithByte(chunk, OP_getLocal, 0);
+    writeChunk(chunk, OP_multiplyInt, 1);
+    writeOpWithByte(chunk, OP_returnValue, 1);
+    patchJump(chunk, skipFunction);
+
+    writeLongConstant(chunk, 1);
+    writeOpWithByte(chunk, OP_setLocal, counter);
+    writeOpWithByte(chunk, OP_getLocal, counter);
+    writeOpWithByte(chunk, OP_setLocal, variable);
+    writeLongConstant(chunk, 2000);
+    writeOpWithByte(chunk, OP_setLocal, bound);
+    int loopHeader = getChunkCodeCount(chunk);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeOpWithByte(chunk, OP_getLocal, variable);
+    writeCall(chunk, OP_call, entry, 1, 1);
+    writeChunk(chunk, OP_addInt, 1);
+    writeOpWithByte(chunk, OP_setLocal, total);
+    writeOpWithByte(chunk, OP_countedLoop, counter);
+    writeChunk(chunk, bound, 1);
+    writeChunk(chunk, variable, 1);
+    writeBackwardsOffset(chunk, loopHeader);
+    writeOpWithByte(chunk, OP_getLocal, total);
+    writeChunk(chunk, OP_outputInt, 1);
+    writeChunk(chunk, OP_return, 1);
+
+    VM* vm = makeVM();
+    CHECK(interpret(vm, chunk) == INTERPRET_OK);
+    checkOutput(vm, "2668667000\n");
+#ifdef USE_JIT
+    CHECK(jitCompiledAt(chunk, entry));
+    CHECK(jitCompiledAt(chunk, loopHeader));
+#endif
+    freeVM(vm);
+    freeChunk(chunk);
+}
+
+// a hosted job's output goes into the job, also when the chunk is run as native code. under USE_JIT the jobs count the loop's hotness
+// together, so it gets compiled once while they run, and the jobs that come after that, or are still going, run the native code
+static void testHostCollectsOutput(void) {
+    int loopHeader;
+    Chunk* chunk = makeCountingLoop(&loopHeader);
+    finaliseChunk(chunk);
+
+    enum { jobCount = 8 };
+    HostJob jobs[jobCount];
+    for (int i=0;i<jobCount;i++) {
+        jobs[i] = (HostJob){chunk, classNames, classNamesLength, classesCount, 0, 0, 0, INTERPRET_OK, NULL, NULL, 0, 0, 0};
+    }
+    Host* host = initHost(4);
+    CHECK(host != NULL);
+    hostRun(host, jobs, jobCount);
+    freeHost(host);
+    for (int i=0;i<jobCount;i++) {
+        CHECK(jobs[i].result == INTERPRET_OK);
+        CHECK(jobs[i].outputLength == 5 && memcmp(jobs[i].output, "5000\n", 5) == 0);
+        freeHostJobOutput(&jobs[i]);
+    }
+#ifdef USE_JIT
+    CHECK(jitCompiledAt(chunk, loopHeader));
+#endif
+    freeChunk(chunk);
+}
+
+typedef struct {
+    Host* host;
+    atomic_bool done;
+} Interrupter;
+
+static void* keepInterrupting(void* argument) {
+    Interrupter* interrupter = argument;
+    while (!atomic_load(&interrupter->done)) {
+        hostInterruptRunningJobs(interrupter->host);
+        nanosleep(&(struct timespec){0, 1000000}, NULL);
+    }
+    return NULL;
+}
+
+// an interrupt only reaches the jobs that are running when it comes in. one that comes in while the host is idle doesn't stop the jobs of
+// the next hostRun, and jobs that never end on their own are all stopped by the interrupts that come in while they run
+static void testHostInterruptsOnlyRunningJobs(void) {
+    int loopHeader;
+    Chunk* counting = makeCountingLoop(&loopHeader);
+    finaliseChunk(counting);
+    Chunk* endless = initChunk();
+    int loopStart = getChunkCodeCount(endless);
+    writeChunk(endless, OP_loop, 1);
+    writeBackwardsOffset(endless, loopStart);
+    writeChunk(endless, OP_return, 1);
+    finaliseChunk(endless);
+
+    enum { jobCount = 8 };
+    HostJob jobs[jobCount];
+    Host* host = initHost(4);
+    hostInterruptRunningJobs(host);
+    for (int i=0;i<jobCount;i++) {
+        jobs[i] = (HostJob){counting, classNames, classNamesLength, classesCount, 0, 0, 0, INTERPRET_OK, NULL, NULL, 0, 0, 0};
+    }
+    hostRun(host, jobs, jobCount);
+    for (int i=0;i<jobCount;i++) {
+        CHECK(jobs[i].result == INTERPRET_OK);
+        freeHostJobOutput(&jobs[i]);
+    }
+
+    // the seconds budget only runs out if an interrupt gets lost
+    for (int i=0;i<jobCount;i++) {
+        jobs[i] = (HostJob){endless, classNames, classNamesLength, classesCount, 0, 10, 0, INTERPRET_OK, NULL, NULL, 0, 0, 0};
+    }
+    Interrupter interrupter = {host};
+    atomic_init(&interrupter.done, false);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, keepInterrupting, &interrupter) == 0);
+    hostRun(host, jobs, jobCount);
+    atomic_store(&interrupter.done, true);
+    pthread_join(thread, NULL);
+    for (int i=0;i<jobCount;i++) {
+        CHECK(jobs[i].result == INTERPRET_INTERRUPTED);
+        freeHostJobOutput(&jobs[i]);
+    }
+    freeHost(host);
+    freeChunk(counting);
+    freeChunk(endless);
+}
+
+// `./vmTests hostScalingBenchmark [runs] [maxThreads]` times the counting loop on 1 to maxThreads worker threads instead of running the
+// tests. turn the debug options in common.h off first, or it times the tracing
+static int runHostScalingBenchmark(int argc, char** argv) {
+    int runs = argc > 2 ? atoi(argv[2]) : 1000;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : 8;
+    if (runs <= 0 || maxThreads <= 0) {
+        fprintf(stderr, "usage: %s hostScalingBenchmark [runs] [maxThreads]\n", argv[0]);
+        return 1;
+    }
+    int loopHeader;
+    Chunk* chunk = makeCountingLoop(&loopHeader);
+    finaliseChunk(chunk);
+    hostScalingBenchmark(chunk, classNames, classNamesLength, classesCount, runs, maxThreads);
+    freeChunk(chunk);
+    return 0;
+}
+
+static int runRecursionBenchmark(int argc, char** argv) {
+    long maxDepth = argc > 2 ? atol(argv[2]) : 1000000;
+    if (maxDepth < 1000) {
+        fprintf(stderr, "usage: %s recursionBenchmark [maxDepth], with a maxDepth of at least 1000\n", argv[0]);
+        return 1;
+    }
+    recursionBenchmark(maxDepth);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && strcmp(argv[1], "hostScalingBenchmark") == 0) {
+        return runHostScalingBenchmark(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "recursionBenchmark") == 0) {
+        return runRecursionBenchmark(argc, argv);
+    }
+    testConcatenatedStringIsTerminated();
+    testInputStringIsOutputBack();
+    testInputStringWithoutStringClass();
+    testSuspendAndResume();
+    testLoops();
+    testLoopResumedAfterBudget();
+    testInterruptBeforeStart();
+    testResumeChecksRunState();
+    testSlotsStartZeroed();
+    testOutputObjectsAndArrays();
+    testInstanceFields();
+    testRandomProgramsAgree();
+    testHotLoopCompiledWithinOneRun();
+    testHotFunctionCompiled();
+    testHostCollectsOutput();
+    testHostInterruptsOnlyRunningJobs();
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "all checks passed\n");
+    return 0;
+}
@@ -4,12 +4,46 @@ import QuasicodeInterpreter
 // swiftlint:disable identifier_name
 let INCLUDE_STRING = true
 let INCLUDE_BUILTIN_CLASSES = false
+let TYPE_CHECK_IN_PARALLEL = true // function and method bodies are type checked on all cores, see TypeChecker.typeCheckAst
 // swiftlint:enable identifier_name
 enum ExecutionMode {
-    case compilerAndVM
+    case compilerAndVM // not available until the bytecode compiler is revived, see Compiler.swift
     case interpreter
+    case transpiledC // transpiles the program to C and builds it with the system C compiler, see CTranspiler
+    case transpiledCVerification // checks the C transpiler against the interpreter on every program in the test corpus
+    case ssa // prints the SSA form of the program before and after it is optimised, see SSAPasses
+    case ssaAllocationReport // counts the heap allocation sites of every program in the test corpus before and after escape analysis
+    case symbolTableBenchmark // times symbol table lookups on a table with thousands of symbols, see SymbolTable.benchmark
 }
 let executionMode = ExecutionMode.interpreter
+let vmSourceDirectory = URL(fileURLWithPath: #filePath).deletingLastPathComponent().appendingPathComponent("VM").path
+// the programs the transpiler is checked against, TranspilerTests next to this file unless another directory is passed as the first argument.
+// a program that reads input gets the lines of the file with the same name followed by ".in"
+let transpilerTestCorpus = CommandLine.arguments.count > 1
+    ? CommandLine.arguments[1]
+    : URL(fileURLWithPath: #filePath).deletingLastPathComponent().appendingPathComponent("TranspilerTests").path
+
+if executionMode == .transpiledCVerification {
+    let sourceFiles = (try? FileManager.default.contentsOfDirectory(atPath: transpilerTestCorpus)) ?? []
+    let failures = CTranspiler.verifyAgainstInterpreter(
+        sourceFiles: sourceFiles.filter { $0.hasSuffix(".qsc") }.sorted().map { transpilerTestCorpus + "/" + $0 },
+        runtimeDirectory: vmSourceDirectory
+    )
+    exit(failures.isEmpty ? 0 : 1)
+}
+
+if executionMode == .ssaAllocationReport {
+    let sourceFiles = (try? FileManager.default.contentsOfDirectory(atPath: transpilerTestCorpus)) ?? []
+    SSAPasses.allocationReport(sourceFiles: sourceFiles.filter { $0.hasSuffix(".qsc") }.sorted().map { transpilerTestCorpus + "/" + $0 })
+    exit(0)
+}
+
+if executionMode == .symbolTableBenchmark {
+    let result = SymbolTable.benchmark()
+    print("Symbol table benchmark: \(result.symbolCount) symbols, \(result.lookupsFound) lookups found")
+    print("Build \(result.buildMilliseconds) ms, query \(result.queryMilliseconds) ms, getAllMethods \(result.getAllMethodsMilliseconds) ms")
+    exit(0)
+}
 
 if true {
 //    let toInterpret = try! String.init(contentsOfFile: "/Users/michel/Desktop/test.qs")
@@ -59,12 +93,46 @@ if true {
 
 
     let typeChecker = TypeChecker()
-    let typeCheckerErrors = typeChecker.typeCheckAst(statements: ast, symbolTables: &symbolTable, debugPrint: true)
+    let typeCheckerErrors = typeChecker.typeCheckAst(
+        statements: ast,
+        symbolTables: &symbolTable,
+        debugPrint: true,
+        parallel: TYPE_CHECK_IN_PARALLEL,
+        passes: .init(interpreterSupport: executionMode == .interpreter, collectTimings: true)
+    )
+    for (pass, nanoseconds) in typeChecker.passTimings.sorted(by: { $0.key < $1.key }) {
+        print("\(pass): \(Double(nanoseconds) / 1_000_000) ms")
+    }
 
     symbolTable.printTable()
     
-    let interpreter = Interpreter()
-    interpreter.execute(ast, symbolTable: symbolTable, debugPrint: false)
+    if executionMode == .transpiledC {
+        do {
+            let status = try CTranspiler.buildAndRun(source: toInterpret, runtimeDirectory: vmSourceDirectory)
+            print("Exited with status \(status)")
+        } catch {
+            print("C transpiler error", error)
+        }
+    } else if executionMode == .ssa {
+        let (module, ssaProblems) = SSABuilder().buildModule(statements: ast, symbolTable: symbolTable)
+        print("ssaProblems", ssaProblems)
+        print("----- SSA -----")
+        print(module)
+        let passes = SSAPasses(options: .all)
+        let instructionCount = module.instructionCount
+        let heapAllocationCount = module.heapAllocationCount
+        passes.optimise(module)
+        print("----- Optimised SSA -----")
+        print(module)
+        print("\(instructionCount) instructions before optimising, \(module.instructionCount) after")
+        print("\(heapAllocationCount) heap allocation sites before optimising, \(module.heapAllocationCount) after")
+        for (pass, changes) in passes.statistics.sorted(by: { $0.key < $1.key }) {
+            print("\(pass): \(changes)")
+        }
+    } else {
+        let interpreter = Interpreter()
+        interpreter.execute(ast, symbolTable: symbolTable, debugPrint: false)
+    }
     
 //    if executionMode == .compilerAndVM {
 //        /*
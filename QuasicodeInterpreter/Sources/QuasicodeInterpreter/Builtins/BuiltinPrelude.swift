@@ -0,0 +1,665 @@
+import Dispatch
+
+/// The builtin classes, declared once into a snapshot that every run loads in a single step instead of declaring them again by hand.
+///
+/// The snapshot holds everything about the builtins that doesn't depend on the program: the symbol table entries of the String class, which
+/// always come first in the symbol table so that their ids and runtime ids are the same in every run, and the declarations of the templated
+/// builtin classes. The templated classes can't be analysed ahead of time, since the templater instantiates them for the types each program
+/// uses and erases the rest, and none of the builtin methods have bodies to compile, the runtime implements them.
+///
+/// A snapshot can be serialised to bytes and kept between runs. The bytes start with `version`, which has to be bumped whenever the builtins
+/// or the format change, so that a stale snapshot is rejected instead of loaded. Since a change that forgot the bump would still load, a
+/// snapshot is best kept with the build that wrote it rather than in a cache that outlives it.
+public final class BuiltinPrelude {
+    public static let version = 1
+    private static let magic: [UInt8] = Array("QSPL".utf8)
+    
+    /// The prelude that `Builtins` loads from. Unless one was assigned, for example one read from disk, the builtins are declared from
+    /// scratch the first time it is read, so assigning one before any program runs means they never are.
+    public static var shared: BuiltinPrelude {
+        get {
+            sharedLock.wait()
+            defer {
+                sharedLock.signal()
+            }
+            if let assigned = assigned {
+                return assigned
+            }
+            let declared = BuiltinPrelude()
+            assigned = declared
+            return declared
+        }
+        set {
+            sharedLock.wait()
+            assigned = newValue
+            sharedLock.signal()
+        }
+    }
+    private static var assigned: BuiltinPrelude?
+    private static let sharedLock = DispatchSemaphore(value: 1)
+    
+    public enum LoadError: Error {
+        case notAPrelude
+        case unsupportedVersion(Int)
+        case corrupted
+    }
+    
+    indirect enum TypeEntry {
+        case int, double, boolean, any
+        case array(TypeEntry)
+        case classType(name: String, id: Int)
+    }
+    
+    indirect enum AstTypeEntry {
+        case int, double, boolean, any
+        case array(AstTypeEntry)
+        case templateTypeName(belongingClass: String, name: String)
+        case classType(name: String, templateArguments: [AstTypeEntry]?)
+    }
+    
+    struct SymbolEntry {
+        struct FunctionParam {
+            var name: String
+            var type: TypeEntry
+        }
+        enum Kind {
+            case classSymbol(name: String, displayName: String, nonSignatureName: String, classScopeSymbolTableIndex: Int?, upperClass: Int?, depth: Int?, parentOf: [Int])
+            case className(name: String)
+            case function(name: String, functionParams: [FunctionParam], paramRange: ClosedRange<Int>, returnType: TypeEntry)
+            case functionName(isForMethods: Bool, name: String, belongingFunctions: [Int])
+        }
+        var table: Int
+        var kind: Kind
+    }
+    
+    struct ClassDeclaration {
+        struct Method {
+            struct FunctionParam {
+                var name: String
+                var type: AstTypeEntry
+            }
+            var isStatic: Bool
+            var visibilityModifier: VisibilityModifier
+            var name: String
+            var params: [FunctionParam]
+            var annotation: AstTypeEntry?
+        }
+        var name: String
+        var templates: [String]?
+        var methods: [Method]
+    }
+    
+    private var stringClassTableParents: [Int] // the parent of every table the String class adds, in the order they are created
+    private var stringClassSymbols: [SymbolEntry] // in symbol table order
+    private var classDeclarations: [ClassDeclaration]
+    
+    /// Declares the builtins from scratch.
+    public init() {
+        let symbolTable = SymbolTable()
+        Builtins.declareStringClass(symbolTable)
+        stringClassTableParents = Array(symbolTable.getTableParentIds().dropFirst())
+        stringClassSymbols = symbolTable.getAllSymbols().map(BuiltinPrelude.entry(for:))
+        classDeclarations = Builtins.declareBuiltinClasses()
+    }
+    
+    // MARK: loading
+    
+    /// Adds the String class to an empty symbol table, with the same symbol ids and runtime id as in every other run.
+    public func loadStringClass(into symbolTable: SymbolTable) {
+        precondition(symbolTable.getAllSymbols().isEmpty, "The String class has to come first in the symbol table")
+        for parent in stringClassTableParents {
+            symbolTable.gotoTable(parent)
+            _ = symbolTable.createTableAtScope()
+        }
+        for entry in stringClassSymbols {
+            symbolTable.gotoTable(entry.table)
+            _ = symbolTable.addToSymbolTable(symbol: BuiltinPrelude.makeSymbol(entry))
+        }
+        symbolTable.resetScope()
+    }
+    
+    /// Fresh ClassStmts for the builtin classes, since the passes after the parser modify the ones they are given.
+    public func makeBuiltinClassStmts() -> [Stmt] {
+        return classDeclarations.map(BuiltinPrelude.makeClassStmt(_:))
+    }
+    
+    private static func makeSymbol(_ entry: SymbolEntry) -> Symbol {
+        switch entry.kind {
+        case .classSymbol(let name, let displayName, let nonSignatureName, let classScopeSymbolTableIndex, let upperClass, let depth, let parentOf):
+            return ClassSymbol(
+                name: name,
+                displayName: displayName,
+                nonSignatureName: nonSignatureName,
+                builtin: true,
+                classScopeSymbolTableIndex: classScopeSymbolTableIndex,
+                upperClass: upperClass,
+                depth: depth,
+                parentOf: parentOf
+            )
+        case .className(let name):
+            return ClassNameSymbol(name: name, builtin: true)
+        case .function(let name, let functionParams, let paramRange, let returnType):
+            return FunctionSymbol(
+                name: name,
+                functionParams: functionParams.map { FunctionParam(name: $0.name, type: makeType($0.type)) },
+                paramRange: paramRange,
+                returnType: makeType(returnType)
+            )
+        case .functionName(let isForMethods, let name, let belongingFunctions):
+            return FunctionNameSymbol(isForMethods: isForMethods, name: name, belongingFunctions: belongingFunctions)
+        }
+    }
+    
+    private static func makeType(_ entry: TypeEntry) -> QsType {
+        switch entry {
+        case .int:
+            return QsInt()
+        case .double:
+            return QsDouble()
+        case .boolean:
+            return QsBoolean()
+        case .any:
+            return QsAnyType()
+        case .array(let contains):
+            return QsArray(contains: makeType(contains))
+        case .classType(let name, let id):
+            return QsClass(name: name, id: id)
+        }
+    }
+    
+    private static func makeAstType(_ entry: AstTypeEntry) -> AstType {
+        switch entry {
+        case .int:
+            return AstIntType(startLocation: .dub(), endLocation: .dub())
+        case .double:
+            return AstDoubleType(startLocation: .dub(), endLocation: .dub())
+        case .boolean:
+            return AstBooleanType(startLocation: .dub(), endLocation: .dub())
+        case .any:
+            return AstAnyType(startLocation: .dub(), endLocation: .dub())
+        case .array(let contains):
+            return AstArrayType(contains: makeAstType(contains), startLocation: .dub(), endLocation: .dub())
+        case .templateTypeName(let belongingClass, let name):
+            return AstTemplateTypeName(
+                belongingClass: belongingClass,
+                name: .dummyToken(tokenType: .IDENTIFIER, lexeme: name),
+                startLocation: .dub(),
+                endLocation: .dub()
+            )
+        case .classType(let name, let templateArguments):
+            return AstClassType(
+                name: .dummyToken(tokenType: .IDENTIFIER, lexeme: name),
+                templateArguments: templateArguments?.map(makeAstType(_:)),
+                startLocation: .dub(),
+                endLocation: .dub()
+            )
+        }
+    }
+    
+    private static func makeClassStmt(_ declaration: ClassDeclaration) -> ClassStmt {
+        var methodStmts: [MethodStmt] = []
+        for method in declaration.methods {
+            let correspondingFunctionStmt: FunctionStmt = .init(
+                keyword: .dummyToken(tokenType: .IDENTIFIER, lexeme: "function"),
+                name: .dummyToken(tokenType: .IDENTIFIER, lexeme: method.name),
+                endToken: .dummyToken(tokenType: .END, lexeme: "end"),
+                symbolTableIndex: nil,
+                nameSymbolTableIndex: nil,
+                scopeIndex: nil,
+                params: method.params.map { param in
+                    .init(
+                        name: .dummyToken(tokenType: .IDENTIFIER, lexeme: param.name),
+                        astType: makeAstType(param.type),
+                        initializer: nil,
+                        symbolTableIndex: nil
+                    )
+                },
+                annotation: method.annotation.map(makeAstType(_:)),
+                body: [],
+                endOfFunction: .dummyToken(tokenType: .FUNCTION, lexeme: "function"),
+                startLocation: .dub(),
+                endLocation: .dub()
+            )
+            
+            methodStmts.append(
+                .init(
+                    isStatic: method.isStatic,
+                    staticKeyword: method.isStatic ? .dummyToken(tokenType: .STATIC, lexeme: "static") : nil,
+                    visibilityModifier: method.visibilityModifier,
+                    function: correspondingFunctionStmt,
+                    startLocation: .dub(),
+                    endLocation: .dub()
+                )
+            )
+        }
+        
+        return .init(
+            keyword: .dummyToken(tokenType: .CLASS, lexeme: "class"),
+            name: .dummyToken(tokenType: .IDENTIFIER, lexeme: declaration.name),
+            endToken: .dummyToken(tokenType: .END, lexeme: "end"),
+            builtin: true,
+            symbolTableIndex: nil,
+            instanceThisSymbolTableIndex: nil,
+            staticThisSymbolTableIndex: nil,
+            scopeIndex: nil,
+            templateParameters: declaration.templates?.map { .dummyToken(tokenType: .IDENTIFIER, lexeme: $0) },
+            expandedTemplateParameters: nil,
+            superclass: nil,
+            methods: methodStmts,
+            fields: [],
+            startLocation: .dub(),
+            endLocation: .dub()
+        )
+    }
+    
+    // MARK: taking the snapshot
+    
+    private static func entry(for symbol: Symbol) -> SymbolEntry {
+        switch symbol {
+        case is ClassSymbol:
+            let symbol = symbol as! ClassSymbol
+            precondition(symbol.builtin, "Non-builtin class \(symbol.name) in the prelude")
+            return .init(
+                table: symbol.belongsToTable,
+                kind: .classSymbol(
+                    name: symbol.name,
+                    displayName: symbol.displayName,
+                    nonSignatureName: symbol.nonSignatureName,
+                    classScopeSymbolTableIndex: symbol.classScopeSymbolTableIndex,
+                    upperClass: symbol.upperClass,
+                    depth: symbol.depth,
+                    parentOf: symbol.parentOf
+                )
+            )
+        case is ClassNameSymbol:
+            let symbol = symbol as! ClassNameSymbol
+            precondition(symbol.builtin, "Non-builtin class name \(symbol.name) in the prelude")
+            return .init(table: symbol.belongsToTable, kind: .className(name: symbol.name))
+        case is FunctionSymbol:
+            let symbol = symbol as! FunctionSymbol
+            precondition(symbol.functionStmt == nil, "Builtin function \(symbol.name) can't have a body")
+            return .init(
+                table: symbol.belongsToTable,
+                kind: .function(
+                    name: symbol.name,
+                    functionParams: symbol.functionParams.map { SymbolEntry.FunctionParam(name: $0.name, type: typeEntry(for: $0.type)) },
+                    paramRange: symbol.paramRange,
+                    returnType: typeEntry(for: symbol.returnType)
+                )
+            )
+        case is FunctionNameSymbol:
+            let symbol = symbol as! FunctionNameSymbol
+            return .init(
+                table: symbol.belongsToTable,
+                kind: .functionName(isForMethods: symbol.isForMethods, name: symbol.name, belongingFunctions: symbol.belongingFunctions)
+            )
+        default:
+            preconditionFailure("Unexpected symbol \(symbol.name) in the prelude")
+        }
+    }
+    
+    private static func typeEntry(for type: QsType) -> TypeEntry {
+        switch type {
+        case is QsInt:
+            return .int
+        case is QsDouble:
+            return .double
+        case is QsBoolean:
+            return .boolean
+        case is QsAnyType:
+            return .any
+        case is QsArray:
+            return .array(typeEntry(for: (type as! QsArray).contains))
+        case is QsClass:
+            let type = type as! QsClass
+            return .classType(name: type.name, id: type.id)
+        default:
+            preconditionFailure("Unexpected type \(printQsType(type)) in the prelude")
+        }
+    }
+    
+    // MARK: serialising
+    
+    private struct ByteWriter {
+        var bytes: [UInt8] = []
+        
+        mutating func write(_ value: Int) {
+            // zigzag encoded LEB128, so small numbers of either sign take a single byte
+            var remaining = UInt64(bitPattern: Int64((value << 1) ^ (value >> 63)))
+            repeat {
+                var byte = UInt8(remaining & 0x7f)
+                remaining >>= 7
+                if remaining != 0 {
+                    byte |= 0x80
+                }
+                bytes.append(byte)
+            } while remaining != 0
+        }
+        
+        mutating func write(_ value: Int?) {
+            write(value != nil)
+            if let value = value {
+                write(value)
+            }
+        }
+        
+        mutating func write(_ value: Bool) {
+            bytes.append(value ? 1 : 0)
+        }
+        
+        mutating func write(_ value: String) {
+            let utf8 = Array(value.utf8)
+            write(utf8.count)
+            bytes.append(contentsOf: utf8)
+        }
+        
+        mutating func write(_ values: [Int]) {
+            write(values.count)
+            for value in values {
+                write(value)
+            }
+        }
+    }
+    
+    private struct ByteReader {
+        let bytes: [UInt8]
+        var position = 0
+        
+        mutating func readByte() throws -> UInt8 {
+            guard position < bytes.count else {
+                throw LoadError.corrupted
+            }
+            position += 1
+            return bytes[position - 1]
+        }
+        
+        mutating func readInt() throws -> Int {
+            var result: UInt64 = 0
+            var shift: UInt64 = 0
+            while true {
+                let byte = try readByte()
+                guard shift < 64 else {
+                    throw LoadError.corrupted
+                }
+                result |= UInt64(byte & 0x7f) << shift
+                shift += 7
+                if byte & 0x80 == 0 {
+                    break
+                }
+            }
+            return Int(Int64(bitPattern: (result >> 1) ^ (0 &- (result & 1))))
+        }
+        
+        mutating func readCount() throws -> Int {
+            let count = try readInt()
+            // every element takes at least a byte, which catches a corrupted count before it is used to reserve anything
+            guard count >= 0 && count <= bytes.count - position else {
+                throw LoadError.corrupted
+            }
+            return count
+        }
+        
+        mutating func readOptionalInt() throws -> Int? {
+            return try readBool() ? try readInt() : nil
+        }
+        
+        mutating func readBool() throws -> Bool {
+            switch try readByte() {
+            case 0:
+                return false
+            case 1:
+                return true
+            default:
+                throw LoadError.corrupted
+            }
+        }
+        
+        mutating func readString() throws -> String {
+            let count = try readCount()
+            defer {
+                position += count
+            }
+            return String(decoding: bytes[position..<position + count], as: UTF8.self)
+        }
+        
+        mutating func readInts() throws -> [Int] {
+            return try (0..<readCount()).map { _ in try readInt() }
+        }
+    }
+    
+    /// The snapshot as bytes, which `init(serialised:)` reads back.
+    public func serialised() -> [UInt8] {
+        var writer = ByteWriter()
+        writer.bytes.append(contentsOf: BuiltinPrelude.magic)
+        writer.write(BuiltinPrelude.version)
+        
+        writer.write(stringClassTableParents)
+        writer.write(stringClassSymbols.count)
+        for entry in stringClassSymbols {
+            writer.write(entry.table)
+            switch entry.kind {
+            case .classSymbol(let name, let displayName, let nonSignatureName, let classScopeSymbolTableIndex, let upperClass, let depth, let parentOf):
+                writer.write(0)
+                writer.write(name)
+                writer.write(displayName)
+                writer.write(nonSignatureName)
+                writer.write(classScopeSymbolTableIndex)
+                writer.write(upperClass)
+                writer.write(depth)
+                writer.write(parentOf)
+            case .className(let name):
+                writer.write(1)
+                writer.write(name)
+            case .function(let name, let functionParams, let paramRange, let returnType):
+                writer.write(2)
+                writer.write(name)
+                writer.write(functionParams.count)
+                for param in functionParams {
+                    writer.write(param.name)
+                    BuiltinPrelude.write(param.type, to: &writer)
+                }
+                writer.write(paramRange.lowerBound)
+                writer.write(paramRange.upperBound)
+                BuiltinPrelude.write(returnType, to: &writer)
+            case .functionName(let isForMethods, let name, let belongingFunctions):
+                writer.write(3)
+                writer.write(isForMethods)
+                writer.write(name)
+                writer.write(belongingFunctions)
+            }
+        }
+        
+        writer.write(classDeclarations.count)
+        for declaration in classDeclarations {
+            writer.write(declaration.name)
+            writer.write(declaration.templates != nil)
+            if let templates = declaration.templates {
+                writer.write(templates.count)
+                for template in templates {
+                    writer.write(template)
+                }
+            }
+            writer.write(declaration.methods.count)
+            for method in declaration.methods {
+                writer.write(method.isStatic)
+                writer.write(method.visibilityModifier == .PUBLIC)
+                writer.write(method.name)
+                writer.write(method.params.count)
+                for param in method.params {
+                    writer.write(param.name)
+                    BuiltinPrelude.write(param.type, to: &writer)
+                }
+                writer.write(method.annotation != nil)
+                if let annotation = method.annotation {
+                    BuiltinPrelude.write(annotation, to: &writer)
+                }
+            }
+        }
+        return writer.bytes
+    }
+    
+    /// Reads a snapshot written by `serialised()`, which has to be of the current version.
+    public init(serialised bytes: [UInt8]) throws {
+        guard bytes.starts(with: BuiltinPrelude.magic) else {
+            throw LoadError.notAPrelude
+        }
+        var reader = ByteReader(bytes: bytes, position: BuiltinPrelude.magic.count)
+        let version = try reader.readInt()
+        guard version == BuiltinPrelude.version else {
+            throw LoadError.unsupportedVersion(version)
+        }
+        
+        stringClassTableParents = try reader.readInts()
+        stringClassSymbols = try (0..<reader.readCount()).map { _ in
+            let table = try reader.readInt()
+            let kind: SymbolEntry.Kind
+            switch try reader.readInt() {
+            case 0:
+                kind = .classSymbol(
+                    name: try reader.readString(),
+                    displayName: try reader.readString(),
+                    nonSignatureName: try reader.readString(),
+                    classScopeSymbolTableIndex: try reader.readOptionalInt(),
+                    upperClass: try reader.readOptionalInt(),
+                    depth: try reader.readOptionalInt(),
+                    parentOf: try reader.readInts()
+                )
+            case 1:
+                kind = .className(name: try reader.readString())
+            case 2:
+                let name = try reader.readString()
+                let functionParams: [SymbolEntry.FunctionParam] = try (0..<reader.readCount()).map { _ in
+                    .init(name: try reader.readString(), type: try BuiltinPrelude.readType(from: &reader))
+                }
+                let lowerBound = try reader.readInt()
+                let upperBound = try reader.readInt()
+                guard lowerBound <= upperBound else {
+                    throw LoadError.corrupted
+                }
+                kind = .function(
+                    name: name,
+                    functionParams: functionParams,
+                    paramRange: lowerBound...upperBound,
+                    returnType: try BuiltinPrelude.readType(from: &reader)
+                )
+            case 3:
+                kind = .functionName(isForMethods: try reader.readBool(), name: try reader.readString(), belongingFunctions: try reader.readInts())
+            default:
+                throw LoadError.corrupted
+            }
+            return .init(table: table, kind: kind)
+        }
+        
+        classDeclarations = try (0..<reader.readCount()).map { _ in
+            let name = try reader.readString()
+            let templates: [String]? = try reader.readBool() ? try (0..<reader.readCount()).map { _ in try reader.readString() } : nil
+            let methods: [ClassDeclaration.Method] = try (0..<reader.readCount()).map { _ in
+                let isStatic = try reader.readBool()
+                let visibilityModifier: VisibilityModifier = try reader.readBool() ? .PUBLIC : .PRIVATE
+                let methodName = try reader.readString()
+                let params: [ClassDeclaration.Method.FunctionParam] = try (0..<reader.readCount()).map { _ in
+                    .init(name: try reader.readString(), type: try BuiltinPrelude.readAstType(from: &reader))
+                }
+                let annotation = try reader.readBool() ? try BuiltinPrelude.readAstType(from: &reader) : nil
+                return .init(isStatic: isStatic, visibilityModifier: visibilityModifier, name: methodName, params: params, annotation: annotation)
+            }
+            return .init(name: name, templates: templates, methods: methods)
+        }
+        
+        guard reader.position == bytes.count else {
+            throw LoadError.corrupted
+        }
+    }
+    
+    private static func write(_ type: TypeEntry, to writer: inout ByteWriter) {
+        switch type {
+        case .int:
+            writer.write(0)
+        case .double:
+            writer.write(1)
+        case .boolean:
+            writer.write(2)
+        case .any:
+            writer.write(3)
+        case .array(let contains):
+            writer.write(4)
+            write(contains, to: &writer)
+        case .classType(let name, let id):
+            writer.write(5)
+            writer.write(name)
+            writer.write(id)
+        }
+    }
+    
+    private static func readType(from reader: inout ByteReader) throws -> TypeEntry {
+        switch try reader.readInt() {
+        case 0:
+            return .int
+        case 1:
+            return .double
+        case 2:
+            return .boolean
+        case 3:
+            return .any
+        case 4:
+            return .array(try readType(from: &reader))
+        case 5:
+            return .classType(name: try reader.readString(), id: try reader.readInt())
+        default:
+            throw LoadError.corrupted
+        }
+    }
+    
+    private static func write(_ type: AstTypeEntry, to writer: inout ByteWriter) {
+        switch type {
+        case .int:
+            writer.write(0)
+        case .double:
+            writer.write(1)
+        case .boolean:
+            writer.write(2)
+        case .any:
+            writer.write(3)
+        case .array(let contains):
+            writer.write(4)
+            write(contains, to: &writer)
+        case .templateTypeName(let belongingClass, let name):
+            writer.write(5)
+            writer.write(belongingClass)
+            writer.write(name)
+        case .classType(let name, let templateArguments):
+            writer.write(6)
+            writer.write(name)
+            writer.write(templateArguments != nil)
+            if let templateArguments = templateArguments {
+                writer.write(templateArguments.count)
+                for templateArgument in templateArguments {
+                    write(templateArgument, to: &writer)
+                }
+            }
+        }
+    }
+    
+    private static func readAstType(from reader: inout ByteReader) throws -> AstTypeEntry {
+        switch try reader.readInt() {
+        case 0:
+            return .int
+        case 1:
+            return .double
+        case 2:
+            return .boolean
+        case 3:
+            return .any
+        case 4:
+            return .array(try readAstType(from: &reader))
+        case 5:
+            return .templateTypeName(belongingClass: try reader.readString(), name: try reader.readString())
+        case 6:
+            let name = try reader.readString()
+            let templateArguments = try reader.readBool() ? try (0..<reader.readCount()).map { _ in try readAstType(from: &reader) } : nil
+            return .classType(name: name, templateArguments: templateArguments)
+        default:
+            throw LoadError.corrupted
+        }
+    }
+}
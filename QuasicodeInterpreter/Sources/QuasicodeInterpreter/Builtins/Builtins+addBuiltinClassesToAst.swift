@@ -1,93 +1,19 @@
-// swiftlint:disable function_body_length
-
 // TODO: Probably put all of these into external files with Quasicode-native (or implement them in Swift) implementations
 
 extension Builtins {
+    /// Puts the builtin classes in front of the program. Their declarations come from the prelude snapshot, see BuiltinPrelude.
     public static func addBuiltinClassesToAst(_ ast: [Stmt]) -> [Stmt] {
-        // swiftlint:enable function_body_length
-        struct MethodDescription {
-            struct FunctionParam {
-                var name: String
-                var type: AstType
-            }
-            var isStatic: Bool
-            var visibilityModifier: VisibilityModifier
-            var name: String
-            var params: [FunctionParam]
-            var annotation: AstType?
-        }
-        
-        func createClass(name: String, templates: [String]?, methods: [MethodDescription]) -> ClassStmt {
-            var methodStmts: [MethodStmt] = []
-            for method in methods {
-                var params: [AstFunctionParam] = []
-                for param in method.params {
-                    params.append(
-                        .init(
-                            name: .dummyToken(tokenType: .IDENTIFIER, lexeme: param.name),
-                            astType: param.type,
-                            initializer: nil,
-                            symbolTableIndex: nil
-                        )
-                    )
-                }
-                
-                let correspondingFunctionStmt: FunctionStmt = .init(
-                    keyword: .dummyToken(tokenType: .IDENTIFIER, lexeme: "function"),
-                    name: .dummyToken(tokenType: .IDENTIFIER, lexeme: method.name),
-                    endToken: .dummyToken(tokenType: .END, lexeme: "end"),
-                    symbolTableIndex: nil,
-                    nameSymbolTableIndex: nil,
-                    scopeIndex: nil,
-                    params: params,
-                    annotation: method.annotation,
-                    body: [],
-                    endOfFunction: .dummyToken(tokenType: .FUNCTION, lexeme: "function"),
-                    startLocation: .dub(),
-                    endLocation: .dub()
-                )
-                
-                methodStmts.append(
-                    .init(
-                        isStatic: method.isStatic,
-                        staticKeyword: method.isStatic ? .dummyToken(tokenType: .STATIC, lexeme: "static") : nil,
-                        visibilityModifier: method.visibilityModifier,
-                        function: correspondingFunctionStmt,
-                        startLocation: .dub(),
-                        endLocation: .dub()
-                    )
-                )
-            }
-            
-            return .init(
-                keyword: .dummyToken(tokenType: .CLASS, lexeme: "class"),
-                name: .dummyToken(tokenType: .IDENTIFIER, lexeme: name),
-                endToken: .dummyToken(tokenType: .END, lexeme: "end"),
-                builtin: true,
-                symbolTableIndex: nil,
-                instanceThisSymbolTableIndex: nil,
-                staticThisSymbolTableIndex: nil,
-                scopeIndex: nil,
-                templateParameters: templates == nil ? nil : templates!.map({ str in
-                    return Token.dummyToken(tokenType: .IDENTIFIER, lexeme: str)
-                }),
-                expandedTemplateParameters: nil,
-                superclass: nil,
-                methods: methodStmts,
-                fields: [],
-                startLocation: .dub(),
-                endLocation: .dub()
-            )
-        }
-        
-        let collectionClassAstTemplateTypeT = AstTemplateTypeName(
-            belongingClass: "Collection",
-            name: .dummyToken(tokenType: .IDENTIFIER, lexeme: "T"),
-            startLocation: .dub(),
-            endLocation: .dub()
-        )
+        var newAst = ast
+        newAst.insert(contentsOf: BuiltinPrelude.shared.makeBuiltinClassStmts(), at: 0)
+        return newAst
+    }
+    
+    // the builtin classes as they are declared in the prelude snapshot
+    // swiftlint:disable:next function_body_length
+    internal static func declareBuiltinClasses() -> [BuiltinPrelude.ClassDeclaration] {
+        let collectionClassAstTemplateTypeT: BuiltinPrelude.AstTypeEntry = .templateTypeName(belongingClass: "Collection", name: "T")
         
-        let collectionClass = createClass(
+        let collectionClass = BuiltinPrelude.ClassDeclaration(
             name: "Collection",
             templates: ["T"],
             methods: [
@@ -117,26 +43,21 @@ extension Builtins {
                     visibilityModifier: .PUBLIC,
                     name: "isEmpty",
                     params: [],
-                    annotation: AstBooleanType(startLocation: .dub(), endLocation: .dub())
+                    annotation: .boolean
                 ),
                 .init(
                     isStatic: false,
                     visibilityModifier: .PUBLIC,
                     name: "hasNext",
                     params: [],
-                    annotation: AstBooleanType(startLocation: .dub(), endLocation: .dub())
+                    annotation: .boolean
                 )
             ]
         )
         
-        let stackClassAstTemplateTypeT = AstTemplateTypeName(
-            belongingClass: "Stack",
-            name: .dummyToken(tokenType: .IDENTIFIER, lexeme: "T"),
-            startLocation: .dub(),
-            endLocation: .dub()
-        )
+        let stackClassAstTemplateTypeT: BuiltinPrelude.AstTypeEntry = .templateTypeName(belongingClass: "Stack", name: "T")
         
-        let stackClass = createClass(
+        let stackClass = BuiltinPrelude.ClassDeclaration(
             name: "Stack",
             templates: ["T"],
             methods: [
@@ -159,7 +80,7 @@ extension Builtins {
                     visibilityModifier: .PUBLIC,
                     name: "isEmpty",
                     params: [],
-                    annotation: AstBooleanType(startLocation: .dub(), endLocation: .dub())
+                    annotation: .boolean
                 ),
                 .init(
                     isStatic: false,
@@ -171,14 +92,9 @@ extension Builtins {
             ]
         )
         
-        let queueClassAstTemplateTypeT = AstTemplateTypeName(
-            belongingClass: "Queue",
-            name: .dummyToken(tokenType: .IDENTIFIER, lexeme: "T"),
-            startLocation: .dub(),
-            endLocation: .dub()
-        )
+        let queueClassAstTemplateTypeT: BuiltinPrelude.AstTypeEntry = .templateTypeName(belongingClass: "Queue", name: "T")
         
-        let queueClass = createClass(
+        let queueClass = BuiltinPrelude.ClassDeclaration(
             name: "Queue",
             templates: ["T"],
             methods: [
@@ -201,7 +117,7 @@ extension Builtins {
                     visibilityModifier: .PUBLIC,
                     name: "isEmpty",
                     params: [],
-                    annotation: AstBooleanType(startLocation: .dub(), endLocation: .dub())
+                    annotation: .boolean
                 ),
                 .init(
                     isStatic: false,
@@ -213,8 +129,6 @@ extension Builtins {
             ]
         )
         
-        var newAst = ast
-        newAst.insert(contentsOf: [collectionClass, stackClass, queueClass], at: 0)
-        return newAst
+        return [collectionClass, stackClass, queueClass]
     }
 }
@@ -1,6 +1,12 @@
 extension Builtins {
-    // swiftlint:disable:next function_body_length
+    /// Adds the String class to an empty symbol table. This loads it from the prelude snapshot, see BuiltinPrelude.
     public static func addStringClassToSymbolTable(_ symbolTable: SymbolTable) {
+        BuiltinPrelude.shared.loadStringClass(into: symbolTable)
+    }
+    
+    // the String class as it is declared in the prelude snapshot, which runs this once into a table of its own
+    // swiftlint:disable:next function_body_length
+    internal static func declareStringClass(_ symbolTable: SymbolTable) {
         let stringClassScopeSymbol = symbolTable.createTableAtScope()
         let stringClassSymbolTableIndex = symbolTable.addToSymbolTable(
             symbol: ClassSymbol(
@@ -3,7 +3,7 @@ public struct InterpreterProblem {
     public var startLocation: InterpreterLocation
     public var endLocation: InterpreterLocation
     
-    init(message: String, start: InterpreterLocation, end: InterpreterLocation) {
+    public init(message: String, start: InterpreterLocation, end: InterpreterLocation) {
         self.message = message
         self.startLocation = start
         self.endLocation = end
@@ -1,4 +1,5 @@
 import QuasicodeCommon
+import Dispatch
 
 // swiftlint:disable type_body_length
 /// A slow tree-walk interpreter for debugging purposes
@@ -50,6 +51,63 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
     private var customStdin: (() -> String)?
     private var cancellationToken: CancellationToken?
     
+    // a run for an InterpreterSession waits on its input in here, which returns nil once the session is given up on
+    private var sessionStdin: (() -> String?)?
+    
+    /// Limits on how much a run may do, for stopping runaway programs. Both are only looked at in safepoints, see `passSafepoint`.
+    public struct Budget {
+        public var safepoints: Int? // how many loop iterations and function calls the run may make
+        public var seconds: Double?
+        
+        public init(safepoints: Int? = nil, seconds: Double? = nil) {
+            self.safepoints = safepoints
+            self.seconds = seconds
+        }
+    }
+    
+    public enum ExecutionResult {
+        case finished
+        case runtimeError
+        case cancelled
+        case outOfBudget
+        case needsInput // only from an InterpreterSession
+    }
+    
+    private var budget: Budget?
+    private var safepointsLeft: Int?
+    private var deadline: UInt64? // in uptime nanoseconds
+    private var safepointsUntilClockCheck = 0
+    
+    private func startBudget() {
+        safepointsLeft = budget?.safepoints
+        deadline = budget?.seconds.map { DispatchTime.now().uptimeNanoseconds + UInt64($0 * 1_000_000_000) }
+        safepointsUntilClockCheck = 0
+    }
+    
+    // the interpreter only checks for cancellation and its budget at loop back edges and function calls. every other statement runs once for
+    // every time one of those is passed, so a runaway program is still stopped quickly while straight-line code doesn't pay for the checks
+    private func passSafepoint() throws {
+        if cancellationToken?.isCancelled == true {
+            throw InterpreterExitSignal.cancel
+        }
+        if let safepointsLeft = safepointsLeft {
+            if safepointsLeft == 0 {
+                throw InterpreterExitSignal.outOfBudget
+            }
+            self.safepointsLeft = safepointsLeft - 1
+        }
+        if let deadline = deadline {
+            // reading the clock costs more than the rest of the safepoint, so it is only read every so often
+            safepointsUntilClockCheck -= 1
+            if safepointsUntilClockCheck <= 0 {
+                safepointsUntilClockCheck = 1024
+                if DispatchTime.now().uptimeNanoseconds >= deadline {
+                    throw InterpreterExitSignal.outOfBudget
+                }
+            }
+        }
+    }
+    
     private func printToStdout(_ str: String) {
         if let customStdout = customStdout {
             customStdout(str)
@@ -59,6 +117,14 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
     }
     
     private func getStdin() throws -> String {
+        if let sessionStdin = sessionStdin {
+            guard let input = sessionStdin(), cancellationToken?.isCancelled != true else {
+                throw InterpreterExitSignal.cancel
+            }
+            // like the VM, the session gives every stretch between two inputs a budget of its own, which doesn't count the wait
+            startBudget()
+            return input
+        }
         if let customStdin = customStdin {
             if cancellationToken?.isCancelled == true {
                 throw InterpreterExitSignal.cancel
@@ -77,6 +143,7 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
     private enum InterpreterExitSignal: Error {
         case signal
         case cancel
+        case outOfBudget
     }
     
     private enum InterpreterInterruptSignal: Error {
@@ -274,6 +341,7 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
             arguments[i] = try interpret(argument)
         }
         
+        try passSafepoint()
         environment.pushFrame()
         defer {
             environment.popFrame()
@@ -299,7 +367,7 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
             if right is Double {
                 return -(right as! Double)
             } else if right is Int {
-                return -(right as! Int)
+                return 0 &- (right as! Int)
             } else {
                 preconditionFailure("Expected operand of type 'Double' or 'Int' with '-' unary operator")
             }
@@ -531,11 +599,12 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
                     if right == 0 {
                         throw InterpreterRuntimeError.error("Division by zero", expr.startLocation, expr.endLocation)
                     }
+                    // like the other operators, Int.min / -1 wraps around instead of trapping
                     switch expr.opr.tokenType {
                     case .SLASH, .DIV:
-                        return left / right
+                        return left.dividedReportingOverflow(by: right).partialValue
                     case .MOD:
-                        return left % right
+                        return left.remainderReportingOverflow(dividingBy: right).partialValue
                     default:
                         preconditionFailure("Switch should be exhaustive")
                     }
@@ -766,6 +835,7 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
         let rrange = try interpret(stmt.rRange) as! Int
         
         for i in lrange...rrange {
+            try passSafepoint()
             environment.add(symbolTableId: stmt.variable.symbolTableIndex!, name: stmt.variable.name.lexeme, value: i)
             
             do {
@@ -780,6 +850,7 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
     
     public func visitWhileStmt(stmt: WhileStmt) throws {
         while true {
+            try passSafepoint()
             let condition = try interpret(stmt.expression)
             if (condition as! Bool) == false {
                 break
@@ -859,9 +930,6 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
     
     fileprivate func interpret(_ stmt: Stmt) throws {
         try stmt.accept(visitor: self)
-        if cancellationToken?.isCancelled == true {
-            throw InterpreterExitSignal.cancel
-        }
     }
     
     fileprivate func interpret(_ stmts: [Stmt]) throws {
@@ -885,6 +953,10 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
         }
     }
     
+    /// Runs the program to its end, or until it is cancelled or runs out of its budget. The cancellation token and the budget are only looked
+    /// at in safepoints and input statements, so a stretch of the program without loops, calls or input always runs to its end once started.
+    /// Such a stretch is never longer than the program itself, so it can't run away, but cancelling it only takes effect after it.
+    @discardableResult
     public func execute(
         _ stmts: [Stmt],
         symbolTable: SymbolTable,
@@ -892,11 +964,64 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
         customStdin: (() -> String)? = nil,
         customStdout: ((String) -> Void)? = nil,
         customErrorHandling: ((String, InterpreterLocation, InterpreterLocation) -> Void)? = nil,
-        cancellationToken: CancellationToken? = nil
-    ) {
+        cancellationToken: CancellationToken? = nil,
+        budget: Budget? = nil
+    ) -> ExecutionResult {
+        return run(
+            stmts,
+            symbolTable: symbolTable,
+            debugPrint: debugPrint,
+            customStdin: customStdin,
+            customStdout: customStdout,
+            customErrorHandling: customErrorHandling,
+            cancellationToken: cancellationToken,
+            budget: budget
+        )
+    }
+    
+    /// Runs the program for an InterpreterSession, on the session's own thread. An input statement waits in `input` until the session has
+    /// a line for it, or ends the program with `.cancelled` if `input` returns nil.
+    internal func executeInSession(
+        _ stmts: [Stmt],
+        symbolTable: SymbolTable,
+        input: @escaping () -> String?,
+        customStdout: ((String) -> Void)?,
+        customErrorHandling: ((String, InterpreterLocation, InterpreterLocation) -> Void)?,
+        cancellationToken: CancellationToken?,
+        budget: Budget?
+    ) -> ExecutionResult {
+        sessionStdin = input
+        defer {
+            sessionStdin = nil
+        }
+        
+        return run(
+            stmts,
+            symbolTable: symbolTable,
+            debugPrint: false,
+            customStdin: nil,
+            customStdout: customStdout,
+            customErrorHandling: customErrorHandling,
+            cancellationToken: cancellationToken,
+            budget: budget
+        )
+    }
+    
+    private func run(
+        _ stmts: [Stmt],
+        symbolTable: SymbolTable,
+        debugPrint: Bool,
+        customStdin: (() -> String)?,
+        customStdout: ((String) -> Void)?,
+        customErrorHandling: ((String, InterpreterLocation, InterpreterLocation) -> Void)?,
+        cancellationToken: CancellationToken?,
+        budget: Budget?
+    ) -> ExecutionResult {
         self.customStdin = customStdin
         self.customStdout = customStdout
         self.cancellationToken = cancellationToken
+        self.budget = budget
+        startBudget()
         
         defer {
             self.customStdin = nil
@@ -916,16 +1041,21 @@ public class Interpreter: ExprOptionalAnyThrowVisitor, StmtThrowVisitor {
         for stmt in stmts {
             do {
                 try interpret(stmt)
-            } catch InterpreterExitSignal.cancel, InterpreterExitSignal.signal {
+            } catch InterpreterExitSignal.cancel {
+                return .cancelled
+            } catch InterpreterExitSignal.outOfBudget {
+                return .outOfBudget
+            } catch InterpreterExitSignal.signal {
                 break
             } catch InterpreterRuntimeError.error(let str, let begin, let end) {
                 if let customErrorHandling = customErrorHandling {
                     customErrorHandling(str, begin, end)
                 }
-                return
+                return .runtimeError
             } catch {
                 print(error.localizedDescription)
             }
         }
+        return .finished
     }
 }
@@ -0,0 +1,101 @@
+import Foundation
+import QuasicodeCommon
+
+/// Runs a program that reads input without blocking the caller's thread while it waits. Instead of waiting inside an input statement, `start`
+/// and `resume(input:)` return `.needsInput` and hand control back to the caller, who resumes the session once the input arrives, from whatever
+/// thread is free. This lets an event loop drive many sessions on a small thread pool.
+///
+/// The tree-walk interpreter keeps its state on the Swift call stack, which can't be set aside, so every session runs its program on a thread of
+/// its own that is parked while the program waits on input. `start` and `resume(input:)` wait for that thread to reach the next input statement
+/// or the end, so `customStdout` and `customErrorHandling` are called on it, but never while the caller isn't waiting. A waiting session costs
+/// a parked thread and its stack, but no CPU, and every line of input only runs the part of the program that follows it. The budget applies
+/// to each of `start` and `resume(input:)` separately, like the budget of the bytecode VM, which suspends without a thread, see
+/// `resumeWithInput` in VM.h.
+public class InterpreterSession {
+    // what the session and its program thread hand each other. the program thread only holds on to this, so that a session that is let go
+    // of while its program waits on input can be deinitialised, which ends the program
+    private final class Channel {
+        let inputArrived = DispatchSemaphore(value: 0)
+        let programStopped = DispatchSemaphore(value: 0) // at an input statement or the end
+        var input: String? // nil when the session was given up on
+        var result: Interpreter.ExecutionResult = .needsInput
+    }
+    
+    // the tree-walk interpreter recurses for every nested expression, statement and call, so it gets as much stack as a main thread
+    private static let programStackSize = 8 << 20
+    
+    private let stmts: [Stmt]
+    private let symbolTable: SymbolTable
+    private let customStdout: ((String) -> Void)?
+    private let customErrorHandling: ((String, InterpreterLocation, InterpreterLocation) -> Void)?
+    private let cancellationToken: CancellationToken?
+    private let budget: Interpreter.Budget? // for each of start and resume(input:)
+    
+    private let channel = Channel()
+    public private(set) var status: Interpreter.ExecutionResult?
+    
+    public init(
+        _ stmts: [Stmt],
+        symbolTable: SymbolTable,
+        customStdout: ((String) -> Void)? = nil,
+        customErrorHandling: ((String, InterpreterLocation, InterpreterLocation) -> Void)? = nil,
+        cancellationToken: CancellationToken? = nil,
+        budget: Interpreter.Budget? = nil
+    ) {
+        self.stmts = stmts
+        self.symbolTable = symbolTable
+        self.customStdout = customStdout
+        self.customErrorHandling = customErrorHandling
+        self.cancellationToken = cancellationToken
+        self.budget = budget
+    }
+    
+    deinit {
+        if status == .needsInput {
+            channel.input = nil
+            channel.inputArrived.signal()
+        }
+    }
+    
+    public func start() -> Interpreter.ExecutionResult {
+        precondition(status == nil, "Session already started")
+        // the thread captures everything it needs instead of the session
+        let channel = channel, stmts = stmts, symbolTable = symbolTable, customStdout = customStdout
+        let customErrorHandling = customErrorHandling, cancellationToken = cancellationToken, budget = budget
+        let thread = Thread {
+            let result = Interpreter().executeInSession(
+                stmts,
+                symbolTable: symbolTable,
+                input: {
+                    channel.result = .needsInput
+                    channel.programStopped.signal()
+                    channel.inputArrived.wait()
+                    return channel.input
+                },
+                customStdout: customStdout,
+                customErrorHandling: customErrorHandling,
+                cancellationToken: cancellationToken,
+                budget: budget
+            )
+            channel.result = result
+            channel.programStopped.signal()
+        }
+        thread.stackSize = InterpreterSession.programStackSize
+        thread.start()
+        return waitForProgram()
+    }
+    
+    /// Continues the program with one line of input, without the newline.
+    public func resume(input: String) -> Interpreter.ExecutionResult {
+        precondition(status == .needsInput, "Session isn't waiting on input")
+        channel.input = input
+        channel.inputArrived.signal()
+        return waitForProgram()
+    }
+    
+    private func waitForProgram() -> Interpreter.ExecutionResult {
+        channel.programStopped.wait()
+        status = channel.result
+        return channel.result
+    }
+}
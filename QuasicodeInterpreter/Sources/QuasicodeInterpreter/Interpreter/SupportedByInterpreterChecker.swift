@@ -1,263 +1,188 @@
 /// The interpreter doesn't support many expressions and statements, such as classes. This class checks for that
-public class SupportedByInterpreterChecker: ExprBoolVisitor, StmtBoolVisitor {
-    public init() {
-        
+///
+/// It doesn't walk the AST itself, it runs as an analysis pass on the type checker's traversal and only looks at the node it is given, whose
+/// children have already been checked. Turn it on with `AnalysisPassOptions.interpreterSupport`.
+internal class SupportedByInterpreterChecker: ExprVisitor, StmtVisitor {
+    init(symbolTable: SymbolTable, stringClassId: Int, reportError: @escaping ((String, InterpreterLocation, InterpreterLocation) -> Void)) {
+        self.symbolTable = symbolTable
+        self.stringClassId = stringClassId
+        self.reportError = reportError
     }
     
-    private var problems: [InterpreterProblem] = []
-    private var stringClassId = -1
-    private var symbolTable: SymbolTable = .init()
+    private var stringClassId: Int
+    private var symbolTable: SymbolTable
+    private var reportError: ((String, InterpreterLocation, InterpreterLocation) -> Void)
     
     private func getStringType() -> QsType {
         return QsClass(name: "String", id: stringClassId)
     }
     
     private func error(message: String, start: InterpreterLocation, end: InterpreterLocation) {
-        problems.append(.init(message: message, start: start, end: end))
+        reportError(message, start, end)
     }
     
     private func error(message: String, on expr: Expr) {
         error(message: message, start: expr.startLocation, end: expr.endLocation)
     }
     
-    public func visitGroupingExprBool(expr: GroupingExpr) -> Bool {
-        checkSupport(expr.expression)
+    func visitGroupingExpr(expr: GroupingExpr) {
+        // supported
     }
     
-    public func visitLiteralExprBool(expr: LiteralExpr) -> Bool {
-        return true
+    func visitLiteralExpr(expr: LiteralExpr) {
+        // supported
     }
     
-    public func visitArrayLiteralExprBool(expr: ArrayLiteralExpr) -> Bool {
-        var supported = true
-        for value in expr.values {
-            supported = supported && checkSupport(value)
-        }
-        return supported
+    func visitArrayLiteralExpr(expr: ArrayLiteralExpr) {
+        // supported
     }
     
-    public func visitStaticClassExprBool(expr: StaticClassExpr) -> Bool {
-        return false
+    func visitStaticClassExpr(expr: StaticClassExpr) {
+        error(message: "Classes are not supported", on: expr)
     }
     
-    public func visitThisExprBool(expr: ThisExpr) -> Bool {
-        return false
+    func visitThisExpr(expr: ThisExpr) {
+        error(message: "Classes are not supported", on: expr)
     }
     
-    public func visitSuperExprBool(expr: SuperExpr) -> Bool {
-        return false
+    func visitSuperExpr(expr: SuperExpr) {
+        error(message: "Classes are not supported", on: expr)
     }
     
-    public func visitVariableExprBool(expr: VariableExpr) -> Bool {
-        return true
+    func visitVariableExpr(expr: VariableExpr) {
+        // supported
     }
     
-    public func visitSubscriptExprBool(expr: SubscriptExpr) -> Bool {
-        var supported = true
-        supported = supported && checkSupport(expr.expression)
-        supported = supported && checkSupport(expr.index)
-        return supported
+    func visitSubscriptExpr(expr: SubscriptExpr) {
+        // supported
     }
     
-    public func visitCallExprBool(expr: CallExpr) -> Bool {
-        var supported = true
-        if let object = expr.object {
-            supported = supported && checkSupport(object)
-        }
+    func visitCallExpr(expr: CallExpr) {
         if expr.polymorphicCallClassIdToIdDict != nil {
             error(message: "Polymorphic calls are not suppoorted", on: expr)
-            supported = false
         }
         if expr.uniqueFunctionCall != nil {
             let uniqueCall = expr.uniqueFunctionCall!
             let callSymbol = symbolTable.getSymbol(id: uniqueCall)
             if callSymbol is MethodSymbol {
                 error(message: "Calling methods are not supported", on: expr)
-                supported = false
             }
         }
-        return supported
     }
     
-    public func visitGetExprBool(expr: GetExpr) -> Bool {
-        var supported = true
-        supported = checkSupport(expr.object)
-        
+    func visitGetExpr(expr: GetExpr) {
         if !(expr.object.type is QsArray) {
             error(message: "Class-related property getters are not supported", on: expr)
-            supported = false
         }
-        
-        return supported
     }
     
-    public func visitUnaryExprBool(expr: UnaryExpr) -> Bool {
-        return true
+    func visitUnaryExpr(expr: UnaryExpr) {
+        // supported
     }
     
-    public func visitCastExprBool(expr: CastExpr) -> Bool {
-        var supported = true
-        
-        supported = supported && checkSupport(expr.value)
-        
+    func visitCastExpr(expr: CastExpr) {
         if expr.type is QsClass && !qsTypesEqual(expr.type!, getStringType(), anyEqAny: true) {
             error(message: "Classes are not supported", start: expr.toType.startLocation, end: expr.toType.endLocation)
-            supported = false
         }
-        
-        return supported
     }
     
-    public func visitArrayAllocationExprBool(expr: ArrayAllocationExpr) -> Bool {
-        var supported = true
-        for lengthExpr in expr.capacity {
-            supported = supported && checkSupport(lengthExpr)
-        }
-        
-        return supported
+    func visitArrayAllocationExpr(expr: ArrayAllocationExpr) {
+        // supported
     }
     
-    public func visitClassAllocationExprBool(expr: ClassAllocationExpr) -> Bool {
-        return false
+    func visitClassAllocationExpr(expr: ClassAllocationExpr) {
+        error(message: "Classes are not supported", on: expr)
     }
     
-    public func visitBinaryExprBool(expr: BinaryExpr) -> Bool {
-        return true
+    func visitBinaryExpr(expr: BinaryExpr) {
+        // supported
     }
     
-    public func visitLogicalExprBool(expr: LogicalExpr) -> Bool {
-        return true
+    func visitLogicalExpr(expr: LogicalExpr) {
+        // supported
     }
     
-    public func visitVariableToSetExprBool(expr: VariableToSetExpr) -> Bool {
-        return true
+    func visitVariableToSetExpr(expr: VariableToSetExpr) {
+        // supported
     }
     
-    public func visitIsTypeExprBool(expr: IsTypeExpr) -> Bool {
-        return true
+    func visitIsTypeExpr(expr: IsTypeExpr) {
+        // supported
     }
     
-    public func visitImplicitCastExprBool(expr: ImplicitCastExpr) -> Bool {
-        return true
+    func visitImplicitCastExpr(expr: ImplicitCastExpr) {
+        // supported
     }
     
-    public func visitClassStmtBool(stmt: ClassStmt) -> Bool {
+    func visitClassStmt(stmt: ClassStmt) {
         error(message: "Classes are not supported", start: stmt.keyword.startLocation, end: stmt.keyword.endLocation)
-        return false
     }
     
-    public func visitMethodStmtBool(stmt: MethodStmt) -> Bool {
+    func visitMethodStmt(stmt: MethodStmt) {
         error(message: "Methods are not supported", start: stmt.startLocation, end: stmt.endLocation)
-        return false
     }
     
-    public func visitFunctionStmtBool(stmt: FunctionStmt) -> Bool {
-        return checkSupport(stmt.body)
+    func visitFunctionStmt(stmt: FunctionStmt) {
+        // supported
     }
     
-    public func visitExpressionStmtBool(stmt: ExpressionStmt) -> Bool {
-        return checkSupport(stmt.expression)
+    func visitExpressionStmt(stmt: ExpressionStmt) {
+        // supported
     }
     
-    public func visitIfStmtBool(stmt: IfStmt) -> Bool {
-        var supported = true
-        supported = supported && checkSupport(stmt.condition)
-        supported = supported && checkSupport(stmt.thenBranch)
-        supported = supported && checkSupport(stmt.elseIfBranches)
-        if let elseBranch = stmt.elseBranch {
-            supported = supported && checkSupport(elseBranch)
-        }
-        return supported
+    func visitIfStmt(stmt: IfStmt) {
+        // supported
     }
     
-    public func visitOutputStmtBool(stmt: OutputStmt) -> Bool {
-        var supported = true
-        for expression in stmt.expressions {
-            supported = supported && checkSupport(expression)
-        }
-        return supported
+    func visitOutputStmt(stmt: OutputStmt) {
+        // supported
     }
     
-    public func visitInputStmtBool(stmt: InputStmt) -> Bool {
-        var supported = true
-        for expression in stmt.expressions {
-            supported = supported && checkSupport(expression)
-        }
-        return supported
+    func visitInputStmt(stmt: InputStmt) {
+        // supported
     }
     
-    public func visitReturnStmtBool(stmt: ReturnStmt) -> Bool {
-        if let value = stmt.value {
-            return checkSupport(value)
-        }
-        return true
+    func visitReturnStmt(stmt: ReturnStmt) {
+        // supported
     }
     
-    public func visitLoopFromStmtBool(stmt: LoopFromStmt) -> Bool {
-        var supported = true
-        supported = supported && checkSupport(stmt.lRange)
-        supported = supported && checkSupport(stmt.rRange)
-        supported = supported && checkSupport(stmt.body)
-        return supported
+    func visitLoopFromStmt(stmt: LoopFromStmt) {
+        // supported
     }
     
-    public func visitWhileStmtBool(stmt: WhileStmt) -> Bool {
-        var supported = true
-        supported = supported && checkSupport(stmt.expression)
-        supported = supported && checkSupport(stmt.body)
-        return supported
+    func visitWhileStmt(stmt: WhileStmt) {
+        // supported
     }
     
-    public func visitBreakStmtBool(stmt: BreakStmt) -> Bool {
-        return true
+    func visitBreakStmt(stmt: BreakStmt) {
+        // supported
     }
     
-    public func visitContinueStmtBool(stmt: ContinueStmt) -> Bool {
-        return true
+    func visitContinueStmt(stmt: ContinueStmt) {
+        // supported
     }
     
-    public func visitBlockStmtBool(stmt: BlockStmt) -> Bool {
-        return checkSupport(stmt.statements)
+    func visitBlockStmt(stmt: BlockStmt) {
+        // supported
     }
     
-    public func visitExitStmtBool(stmt: ExitStmt) -> Bool {
-        return true
+    func visitExitStmt(stmt: ExitStmt) {
+        // supported
     }
     
-    public func visitMultiSetStmtBool(stmt: MultiSetStmt) -> Bool {
-        return checkSupport(stmt.setStmts)
+    func visitMultiSetStmt(stmt: MultiSetStmt) {
+        // supported
     }
     
-    public func visitSetStmtBool(stmt: SetStmt) -> Bool {
-        var supported = true
-        supported = supported && checkSupport(stmt.left)
-        for chain in stmt.chained {
-            supported = supported && checkSupport(chain)
-        }
-        supported = supported && checkSupport(stmt.value)
-        return supported
-    }
-    
-    private func checkSupport(_ expr: Expr) -> Bool {
-        return expr.accept(visitor: self)
+    func visitSetStmt(stmt: SetStmt) {
+        // supported
     }
     
-    private func checkSupport(_ stmt: Stmt) -> Bool {
-        return stmt.accept(visitor: self)
+    internal func checkSupport(_ expr: Expr) {
+        expr.accept(visitor: self)
     }
     
-    private func checkSupport(_ stmts: [Stmt]) -> Bool {
-        var supported = true
-        for stmt in stmts {
-            supported = supported && stmt.accept(visitor: self)
-        }
-        return supported
-    }
-    
-    public func checkSupport(_ stmts: [Stmt], symbolTable: SymbolTable) -> (Bool, [InterpreterProblem]) {
-        problems = []
-        stringClassId = symbolTable.queryAtGlobalOnly("String<>")?.id ?? -1
-        self.symbolTable = symbolTable
-        return (checkSupport(stmts), problems)
+    internal func checkSupport(_ stmt: Stmt) {
+        stmt.accept(visitor: self)
     }
 }
@@ -0,0 +1,27 @@
+// works out a type's id from its structure instead of looking it up in a table, so creating a type takes no lock
+// and there is nothing to clear between programs.
+// the types without any structure use the fixed ids in TypeHashValues, a class's id follows from its symbol id,
+// and an array's id packs the id of its innermost element type together with its number of dimensions
+internal enum QsTypeIds {
+    // far more dimensions than any program writes out
+    private static let MAX_ARRAY_DIMENSIONS = 255
+    
+    static func idForClass(classId: Int) -> Int {
+        // -1 stands in for a class that isn't there, such as String when it is left out
+        if classId == -1 {
+            return TypeHashValues.MISSING_CLASS
+        }
+        precondition(classId >= 0, "Class ids come from the symbol table")
+        return TypeHashValues.FIRST_CLASS + classId
+    }
+    
+    // array ids are negative, so they never collide with the id of a type that isn't an array
+    static func idForArray(containing contains: QsType) -> Int {
+        let elementId = contains.typeId
+        if elementId >= 0 {
+            return -(elementId * (MAX_ARRAY_DIMENSIONS + 1) + 1)
+        }
+        precondition(-elementId % (MAX_ARRAY_DIMENSIONS + 1) < MAX_ARRAY_DIMENSIONS, "Too many array dimensions")
+        return elementId - 1
+    }
+}
@@ -1,19 +1,24 @@
 public protocol QsType {
     var assignable: Bool { get set }
+    // identical for two types if and only if they are the same type, ignoring assignability
+    var typeId: Int { get }
 }
 
 public class QsArray: QsType {
     init(contains: QsType, assignable: Bool) {
         self.assignable = assignable
         self.contains = contains
+        self.typeId = QsTypeIds.idForArray(containing: contains)
     }
     init(contains: QsType) {
         self.assignable = false
         self.contains = contains
+        self.typeId = QsTypeIds.idForArray(containing: contains)
     }
     
     public var assignable: Bool
     public let contains: QsType
+    public let typeId: Int
 }
 
 public protocol QsNativeType: QsType {}
@@ -26,33 +31,42 @@ public class QsInt: QsNativeType {
     init(assignable: Bool) {
         self.assignable = assignable
     }
-    init() {
+    public init() {
         self.assignable = false
     }
     
     public var assignable: Bool
+    public var typeId: Int {
+        TypeHashValues.INT
+    }
 }
 
 public class QsDouble: QsNativeType {
     init(assignable: Bool) {
         self.assignable = assignable
     }
-    init() {
+    public init() {
         self.assignable = false
     }
     
     public var assignable: Bool
+    public var typeId: Int {
+        TypeHashValues.DOUBLE
+    }
 }
 
 public class QsBoolean: QsNativeType {
     init(assignable: Bool) {
         self.assignable = assignable
     }
-    init() {
+    public init() {
         self.assignable = false
     }
     
     public var assignable: Bool
+    public var typeId: Int {
+        TypeHashValues.BOOLEAN
+    }
 }
 
 public class QsAnyType: QsType {
@@ -64,6 +78,9 @@ public class QsAnyType: QsType {
     }
     
     public var assignable: Bool
+    public var typeId: Int {
+        TypeHashValues.ANY
+    }
 }
 
 public let builtinClassNames = ["Collection", "Stack", "Queue"]
@@ -72,16 +89,19 @@ public class QsClass: QsType {
         self.assignable = assignable
         self.name = name
         self.id = id
+        self.typeId = QsTypeIds.idForClass(classId: id)
     }
     init(name: String, id: Int) {
         self.assignable = false
         self.name = name
         self.id = id
+        self.typeId = QsTypeIds.idForClass(classId: id)
     }
     
     public var assignable: Bool
     public let name: String
     public let id: Int
+    public let typeId: Int
 }
 
 public class QsErrorType: QsType {
@@ -93,6 +113,9 @@ public class QsErrorType: QsType {
     }
     
     public var assignable: Bool
+    public var typeId: Int {
+        TypeHashValues.ERROR
+    }
 }
 
 public class QsVoidType: QsType {
@@ -109,4 +132,7 @@ public class QsVoidType: QsType {
             // do nothing: QsVoidType should always be unsettable but the protocol requires that assignable be settable
         }
     }
+    public var typeId: Int {
+        TypeHashValues.VOID
+    }
 }
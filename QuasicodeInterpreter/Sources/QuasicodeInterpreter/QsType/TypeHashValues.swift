@@ -6,4 +6,8 @@ internal enum TypeHashValues {
     static let CLASS = 4
     static let ARRAY = 5
     static let ERROR = 6
+    static let VOID = 7
+    // the ids of class types, see QsTypeIds
+    static let MISSING_CLASS = 8
+    static let FIRST_CLASS = 9
 }
@@ -0,0 +1,30 @@
+// types are shared between symbols and expressions, so they should never have their assignability mutated in place.
+// this returns the type itself if it already has the requested assignability, and a copy otherwise
+internal func qsTypeWithAssignable(_ value: QsType, assignable: Bool) -> QsType {
+    if value.assignable == assignable {
+        return value
+    }
+    switch value {
+    case is QsInt:
+        return QsInt(assignable: assignable)
+    case is QsDouble:
+        return QsDouble(assignable: assignable)
+    case is QsBoolean:
+        return QsBoolean(assignable: assignable)
+    case is QsAnyType:
+        return QsAnyType(assignable: assignable)
+    case is QsClass:
+        let value = value as! QsClass
+        return QsClass(name: value.name, id: value.id, assignable: assignable)
+    case is QsArray:
+        return QsArray(contains: (value as! QsArray).contains, assignable: assignable)
+    case is QsErrorType:
+        return QsErrorType(assignable: assignable)
+    case is QsVoidType:
+        // void is never assignable
+        return value
+    default:
+        assertionFailure("Attempting to copy unknown type \"\(type(of: value))\"")
+        return value
+    }
+}
@@ -3,45 +3,21 @@ internal func qsTypesEqual(_ lhs: QsType, _ rhs: QsType, anyEqAny: Bool) -> Bool
         return false
     }
     
-    if lhs is QsVoidType || rhs is QsVoidType {
-        return lhs is QsVoidType && rhs is QsVoidType
+    if lhs.typeId != rhs.typeId {
+        return false
     }
     
-    if lhs is QsNativeType {
-        if rhs is QsNativeType {
-            return type(of: lhs) == type(of: rhs)
-        } else {
-            return false
-        }
+    // the ids are the same, so the only thing left is whether the innermost type is one that doesn't equal itself
+    var innermost = lhs
+    while innermost is QsArray {
+        innermost = (innermost as! QsArray).contains
     }
-    
-    if lhs is QsAnyType {
-        if !anyEqAny {
-            return false
-        }
-        if rhs is QsAnyType {
-            return true
-        }
+    if innermost is QsErrorType {
         return false
     }
-    
-    if lhs is QsArray {
-        if rhs is QsArray {
-            return qsTypesEqual((lhs as! QsArray).contains, (rhs as! QsArray).contains, anyEqAny: anyEqAny)
-        } else {
-            return false
-        }
-    }
-    
-    if lhs is QsClass {
-        if rhs is QsClass {
-            return (lhs as! QsClass).id == (rhs as! QsClass).id
-        } else {
-            return false
-        }
+    if innermost is QsAnyType {
+        return anyEqAny
     }
     
-    assertionFailure("Type equality reached end")
-    
     return true
 }
@@ -0,0 +1,365 @@
+/// A typed SSA intermediate representation that sits between the type checked AST and bytecode emission, so that the compiler can optimise
+/// across statements. See SSABuilder for how it is built from the AST and SSAPasses for the optimisations that run on it.
+///
+/// Every function is a list of basic blocks. Values are the indices of the instructions that produce them, and local variables only exist as
+/// values: every assignment is a `copy` and every join point merges them with a `phi`. Global variables, array elements and fields are memory,
+/// which is accessed through loads and stores, since functions and aliasing references can change them behind the current function's back.
+typealias SSAValue = Int
+
+enum SSAOperation: Hashable {
+    case constantInt(Int)
+    case constantDouble(Double)
+    case constantBoolean(Bool)
+    case constantString(String)
+    case parameter(Int) // the symbol table index of the parameter
+    case undefined // a local that is read on a path where it was never assigned
+    case phi // one operand per predecessor of the block, in the same order
+    case copy
+    case unary(TokenType)
+    case binary(TokenType)
+    case convert // between Int and Double, to the type of the instruction
+    case arrayLiteral
+    case arrayAllocate // one operand per dimension
+    case arrayLength
+    case arrayGet // array, index
+    case arraySet // array, index, value
+    case classAllocate(Int) // the symbol table index of the class, the constructor is a separate call
+    case getField(Int) // object, the symbol table index of the field
+    case setField(Int) // object, value
+    case loadGlobal(Int)
+    case storeGlobal(Int)
+    case call(Int) // the symbol table index of the function
+    case output
+    case input // reads a line and converts it to the type of the instruction
+}
+
+struct SSAInstruction {
+    var operation: SSAOperation
+    var operands: [SSAValue]
+    var type: QsType? // nil for instructions that don't produce a value
+    var block: Int
+    // set by escape analysis on allocations that can't outlive the call that makes them, which could live in the call frame instead of the
+    // heap. no backend reads it yet, since nothing lowers SSA to code
+    var isFrameAllocated = false
+}
+
+enum SSATerminator {
+    case unterminated
+    case jump(Int)
+    case branch(SSAValue, Int, Int)
+    case `return`(SSAValue?)
+    case exit
+    
+    var successors: [Int] {
+        switch self {
+        case .jump(let target):
+            return [target]
+        case .branch(_, let thenBlock, let elseBlock):
+            return [thenBlock, elseBlock]
+        default:
+            return []
+        }
+    }
+    
+    var operands: [SSAValue] {
+        switch self {
+        case .branch(let condition, _, _):
+            return [condition]
+        case .return(let value?):
+            return [value]
+        default:
+            return []
+        }
+    }
+}
+
+struct SSABlock {
+    var instructions: [SSAValue] = [] // phis always come first
+    var terminator: SSATerminator = .unterminated
+    var predecessors: [Int] = []
+    var reachable = true
+}
+
+/// A `loop from` or `while` loop. The preheader is the only way into the header from outside of the loop, so that code that doesn't depend on
+/// the loop can be moved into it.
+struct SSALoop {
+    var preheader: Int
+    var header: Int
+    var blocks: Set<Int>
+}
+
+class SSAFunction {
+    let name: String
+    let symbolTableIndex: Int? // nil for the top level code
+    var parameters: [Int] = [] // the symbol table indices of the parameters, in the order calls pass them
+    var instructions: [SSAInstruction] = []
+    var blocks: [SSABlock] = []
+    var loops: [SSALoop] = []
+    
+    init(name: String, symbolTableIndex: Int?) {
+        self.name = name
+        self.symbolTableIndex = symbolTableIndex
+    }
+    
+    var entryBlock: Int {
+        0
+    }
+    
+    func addBlock() -> Int {
+        blocks.append(.init())
+        return blocks.count - 1
+    }
+    
+    func append(_ operation: SSAOperation, operands: [SSAValue] = [], type: QsType?, to block: Int) -> SSAValue {
+        instructions.append(.init(operation: operation, operands: operands, type: type, block: block))
+        blocks[block].instructions.append(instructions.count - 1)
+        return instructions.count - 1
+    }
+    
+    func insertPhi(type: QsType?, in block: Int) -> SSAValue {
+        instructions.append(.init(operation: .phi, operands: [], type: type, block: block))
+        let phiCount = blocks[block].instructions.prefix { instructions[$0].operation == .phi }.count
+        blocks[block].instructions.insert(instructions.count - 1, at: phiCount)
+        return instructions.count - 1
+    }
+    
+    func addEdge(from block: Int, to successor: Int) {
+        blocks[successor].predecessors.append(block)
+    }
+    
+    func terminate(_ block: Int, with terminator: SSATerminator) {
+        blocks[block].terminator = terminator
+        for successor in terminator.successors {
+            addEdge(from: block, to: successor)
+        }
+    }
+    
+    /// Removes an instruction from its block. Its uses have to be replaced first
+    func remove(_ value: SSAValue) {
+        let block = instructions[value].block
+        blocks[block].instructions.removeAll { $0 == value }
+    }
+    
+    /// Points every use of a key at its value, following chains of replacements
+    func replaceUses(_ replacements: [SSAValue: SSAValue]) {
+        if replacements.isEmpty {
+            return
+        }
+        func resolve(_ value: SSAValue) -> SSAValue {
+            var value = value
+            while let replacement = replacements[value], replacement != value {
+                value = replacement
+            }
+            return value
+        }
+        for block in blocks.indices {
+            for instruction in blocks[block].instructions {
+                instructions[instruction].operands = instructions[instruction].operands.map(resolve)
+            }
+            switch blocks[block].terminator {
+            case .branch(let condition, let thenBlock, let elseBlock):
+                blocks[block].terminator = .branch(resolve(condition), thenBlock, elseBlock)
+            case .return(let value?):
+                blocks[block].terminator = .return(resolve(value))
+            default:
+                break
+            }
+        }
+    }
+    
+    /// The number of uses of every value in reachable code
+    func useCounts() -> [Int] {
+        var counts = Array(repeating: 0, count: instructions.count)
+        for block in blocks where block.reachable {
+            for instruction in block.instructions {
+                for operand in instructions[instruction].operands {
+                    counts[operand] += 1
+                }
+            }
+            for operand in block.terminator.operands {
+                counts[operand] += 1
+            }
+        }
+        return counts
+    }
+    
+    var instructionCount: Int {
+        blocks.reduce(0) { $0 + ($1.reachable ? $1.instructions.count : 0) }
+    }
+    
+    func isAllocation(_ value: SSAValue) -> Bool {
+        switch instructions[value].operation {
+        case .arrayLiteral, .arrayAllocate, .classAllocate:
+            return true
+        default:
+            return false
+        }
+    }
+    
+    /// The number of allocation sites in reachable code that still go through the heap
+    var heapAllocationCount: Int {
+        blocks.reduce(0) { count, block in
+            count + (block.reachable ? block.instructions.filter { isAllocation($0) && !instructions[$0].isFrameAllocated }.count : 0)
+        }
+    }
+}
+
+public class SSAModule {
+    var functions: [SSAFunction] = []
+    
+    public var instructionCount: Int {
+        functions.reduce(0) { $0 + $1.instructionCount }
+    }
+    
+    public var heapAllocationCount: Int {
+        functions.reduce(0) { $0 + $1.heapAllocationCount }
+    }
+}
+
+// MARK: side effects
+
+extension SSAFunction {
+    /// Whether the instruction changes memory or talks to the outside world
+    func hasSideEffects(_ value: SSAValue) -> Bool {
+        switch instructions[value].operation {
+        case .arraySet, .setField, .storeGlobal, .call, .output, .input:
+            return true
+        default:
+            return false
+        }
+    }
+    
+    /// Whether the result of the instruction depends on memory, as opposed to only its operands
+    func readsMemory(_ value: SSAValue) -> Bool {
+        switch instructions[value].operation {
+        case .arrayGet, .getField, .loadGlobal, .call:
+            return true
+        default:
+            return false
+        }
+    }
+    
+    /// Whether the instruction can stop the program with a runtime error, in which case it can't be executed on a path that wouldn't have
+    /// executed it
+    func canTrap(_ value: SSAValue) -> Bool {
+        let instruction = instructions[value]
+        switch instruction.operation {
+        case .binary(let operatorType):
+            // int arithmetic wraps around in the VM, only dividing by zero stops the program
+            let isIntOperation = instructions[instruction.operands[0]].type is QsInt
+            return isIntOperation && (operatorType == .SLASH || operatorType == .DIV || operatorType == .MOD)
+        case .convert:
+            // a double that doesn't fit into an int
+            return instruction.type is QsInt
+        case .arrayAllocate, .arrayGet, .arraySet, .getField, .setField, .call, .input:
+            // a field access traps when the object comes from an object field that was never set
+            return true
+        default:
+            return false
+        }
+    }
+    
+    /// Whether the instruction's result only depends on its operands, which makes two instructions with the same operation and operands
+    /// interchangeable
+    func isPure(_ value: SSAValue) -> Bool {
+        let operation = instructions[value].operation
+        if operation == .phi || operation == .undefined || isAllocation(value) {
+            // every allocation is a different array or object
+            return false
+        }
+        return !hasSideEffects(value) && !readsMemory(value)
+    }
+}
+
+// MARK: printing
+
+func ssaTypeName(_ type: QsType?) -> String {
+    switch type {
+    case is QsInt:
+        return "Int"
+    case is QsDouble:
+        return "Double"
+    case is QsBoolean:
+        return "Boolean"
+    case is QsAnyType:
+        return "Any"
+    case is QsVoidType, .none:
+        return "Void"
+    case is QsArray:
+        return ssaTypeName((type as! QsArray).contains) + "[]"
+    case is QsClass:
+        return (type as! QsClass).name
+    default:
+        return "<error>"
+    }
+}
+
+extension SSAFunction: CustomStringConvertible {
+    private func operationDescription(_ operation: SSAOperation) -> String {
+        switch operation {
+        case .constantInt(let value):
+            return "const \(value)"
+        case .constantDouble(let value):
+            return "const \(value)"
+        case .constantBoolean(let value):
+            return "const \(value)"
+        case .constantString(let value):
+            return "const \(value.debugDescription)"
+        case .parameter(let symbolTableIndex):
+            return "param #\(symbolTableIndex)"
+        case .unary(let operatorType):
+            return "unary \(operatorType)"
+        case .binary(let operatorType):
+            return "binary \(operatorType)"
+        case .loadGlobal(let symbolTableIndex):
+            return "loadGlobal #\(symbolTableIndex)"
+        case .storeGlobal(let symbolTableIndex):
+            return "storeGlobal #\(symbolTableIndex)"
+        case .call(let symbolTableIndex):
+            return "call #\(symbolTableIndex)"
+        case .classAllocate(let symbolTableIndex):
+            return "classAllocate #\(symbolTableIndex)"
+        case .getField(let symbolTableIndex):
+            return "getField #\(symbolTableIndex)"
+        case .setField(let symbolTableIndex):
+            return "setField #\(symbolTableIndex)"
+        default:
+            return "\(operation)"
+        }
+    }
+    
+    var description: String {
+        var result = "function \(name)\n"
+        for (index, block) in blocks.enumerated() where block.reachable {
+            let predecessors = block.predecessors.map { "b\($0)" }.joined(separator: ", ")
+            let loopHeader = loops.contains { $0.header == index } ? " loop header" : ""
+            result += "b\(index):\(loopHeader)\(predecessors.isEmpty ? "" : " <- \(predecessors)")\n"
+            for value in block.instructions {
+                let instruction = instructions[value]
+                let operands = instruction.operands.map { "%\($0)" }.joined(separator: ", ")
+                let definition = instruction.type == nil || instruction.type is QsVoidType ? "" : "%\(value): \(ssaTypeName(instruction.type)) = "
+                let frame = instruction.isFrameAllocated ? " [frame]" : ""
+                result += "    \(definition)\(operationDescription(instruction.operation))\(operands.isEmpty ? "" : " \(operands)")\(frame)\n"
+            }
+            switch block.terminator {
+            case .unterminated:
+                result += "    <unterminated>\n"
+            case .jump(let target):
+                result += "    jump b\(target)\n"
+            case .branch(let condition, let thenBlock, let elseBlock):
+                result += "    branch %\(condition), b\(thenBlock), b\(elseBlock)\n"
+            case .return(let value):
+                result += "    return\(value == nil ? "" : " %\(value!)")\n"
+            case .exit:
+                result += "    exit\n"
+            }
+        }
+        return result
+    }
+}
+
+extension SSAModule: CustomStringConvertible {
+    public var description: String {
+        functions.map { $0.description }.joined(separator: "\n")
+    }
+}
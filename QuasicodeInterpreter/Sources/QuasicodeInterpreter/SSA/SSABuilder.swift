@@ -0,0 +1,649 @@
+// swiftlint:disable type_body_length
+/// Lowers a type checked AST into SSA form, one SSAFunction for the top level code and one for every function. Local variables are put into
+/// SSA form while the AST is being walked, using the algorithm from "Simple and Efficient Construction of Static Single Assignment Form"
+/// (Braun et al.): a block is sealed once all of its predecessors are known, and reading a variable in a block that isn't sealed yet leaves
+/// a phi whose operands are filled in when it is. Like CTranspiler, anys aren't supported, and of classes only fields and constructors are,
+/// everything else is reported as a problem.
+public class SSABuilder: ExprVisitor, StmtVisitor {
+// swiftlint:enable type_body_length
+    private var symbolTable: SymbolTable = .init()
+    private var stringClassId = -1
+    private var problems: [InterpreterProblem] = []
+    private var classStmts: [Int : ClassStmt] = [:] // every class declared in the program, by symbol table index
+    
+    private var function = SSAFunction(name: "", symbolTableIndex: nil)
+    private var currentBlock = 0
+    private var result: SSAValue = 0 // the value of the expression that was visited last
+    private var thisSymbolTableIndex: Int? // the instance `this` of the constructor being lowered
+    
+    // the value of every local variable at the end of every block it was assigned or read in, by symbol table index
+    private var currentDefinitions: [Int : [Int : SSAValue]] = [:]
+    private var sealedBlocks: Set<Int> = []
+    private var incompletePhis: [Int : [Int : SSAValue]] = [:]
+    
+    private struct LoopTargets {
+        var continueBlock: Int
+        var breakBlock: Int
+    }
+    private var loopTargets: [LoopTargets] = []
+    
+    public init() {}
+    
+    private func error(message: String, start: InterpreterLocation, end: InterpreterLocation) {
+        problems.append(.init(message: message, start: start, end: end))
+    }
+    
+    private func unsupported(_ what: String, on expr: Expr) {
+        error(message: "\(what) cannot be lowered to SSA", start: expr.startLocation, end: expr.endLocation)
+        result = function.append(.undefined, type: expr.type, to: currentBlock)
+    }
+    
+    private func unsupported(_ what: String, on stmt: Stmt) {
+        error(message: "\(what) cannot be lowered to SSA", start: stmt.startLocation, end: stmt.endLocation)
+    }
+    
+    private func isString(_ type: QsType?) -> Bool {
+        return (type as? QsClass)?.id == stringClassId
+    }
+    
+    private func emit(_ operation: SSAOperation, operands: [SSAValue] = [], type: QsType?) -> SSAValue {
+        return function.append(operation, operands: operands, type: type, to: currentBlock)
+    }
+    
+    // MARK: blocks
+    
+    private func startBlock(_ block: Int) {
+        currentBlock = block
+    }
+    
+    /// Ends the current block, unless a break, continue, return or exit already has
+    private func jump(to target: Int) {
+        if case .unterminated = function.blocks[currentBlock].terminator {
+            function.terminate(currentBlock, with: .jump(target))
+        }
+    }
+    
+    private func branch(on condition: SSAValue, then thenBlock: Int, else elseBlock: Int) {
+        function.terminate(currentBlock, with: .branch(condition, thenBlock, elseBlock))
+    }
+    
+    /// Code after a break, continue, return or exit goes into a block without predecessors, which SSAPasses drops
+    private func startUnreachableBlock() {
+        let block = function.addBlock()
+        sealBlock(block)
+        startBlock(block)
+    }
+    
+    // MARK: variables
+    
+    private func isGlobal(_ symbolTableIndex: Int) -> Bool {
+        return symbolTable.getSymbol(id: symbolTableIndex) is GlobalVariableSymbol
+    }
+    
+    private func isInstanceField(_ symbolTableIndex: Int) -> Bool {
+        return (symbolTable.getSymbol(id: symbolTableIndex) as? VariableSymbol)?.variableType == .instance
+    }
+    
+    private func variableType(_ symbolTableIndex: Int) -> QsType? {
+        return (symbolTable.getSymbol(id: symbolTableIndex) as? VariableSymbol)?.type
+    }
+    
+    private func writeVariable(_ symbolTableIndex: Int, in block: Int, value: SSAValue) {
+        currentDefinitions[symbolTableIndex, default: [:]][block] = value
+    }
+    
+    private func readVariable(_ symbolTableIndex: Int, in block: Int) -> SSAValue {
+        if let value = currentDefinitions[symbolTableIndex]?[block] {
+            return value
+        }
+        let type = variableType(symbolTableIndex)
+        var value: SSAValue
+        if !sealedBlocks.contains(block) {
+            value = function.insertPhi(type: type, in: block)
+            incompletePhis[block, default: [:]][symbolTableIndex] = value
+        } else if function.blocks[block].predecessors.count == 1 {
+            value = readVariable(symbolTableIndex, in: function.blocks[block].predecessors[0])
+        } else if function.blocks[block].predecessors.isEmpty {
+            value = function.append(.undefined, type: type, to: block)
+        } else {
+            // the phi is written first to break cycles through loops
+            value = function.insertPhi(type: type, in: block)
+            writeVariable(symbolTableIndex, in: block, value: value)
+            addPhiOperands(symbolTableIndex, phi: value)
+        }
+        writeVariable(symbolTableIndex, in: block, value: value)
+        return value
+    }
+    
+    private func addPhiOperands(_ symbolTableIndex: Int, phi: SSAValue) {
+        let block = function.instructions[phi].block
+        let operands = function.blocks[block].predecessors.map { readVariable(symbolTableIndex, in: $0) }
+        function.instructions[phi].operands = operands
+    }
+    
+    private func sealBlock(_ block: Int) {
+        for (symbolTableIndex, phi) in incompletePhis[block] ?? [:] {
+            addPhiOperands(symbolTableIndex, phi: phi)
+        }
+        incompletePhis[block] = nil
+        sealedBlocks.insert(block)
+    }
+    
+    private func readVariable(_ symbolTableIndex: Int) -> SSAValue {
+        if isGlobal(symbolTableIndex) {
+            return emit(.loadGlobal(symbolTableIndex), type: variableType(symbolTableIndex))
+        }
+        if isInstanceField(symbolTableIndex), let thisSymbolTableIndex = thisSymbolTableIndex {
+            // a field used by name inside the constructor
+            let this = readVariable(thisSymbolTableIndex, in: currentBlock)
+            return emit(.getField(symbolTableIndex), operands: [this], type: variableType(symbolTableIndex))
+        }
+        return readVariable(symbolTableIndex, in: currentBlock)
+    }
+    
+    private func assignVariable(_ symbolTableIndex: Int, value: SSAValue) {
+        if isGlobal(symbolTableIndex) {
+            _ = emit(.storeGlobal(symbolTableIndex), operands: [value], type: nil)
+            return
+        }
+        if isInstanceField(symbolTableIndex), let thisSymbolTableIndex = thisSymbolTableIndex {
+            let this = readVariable(thisSymbolTableIndex, in: currentBlock)
+            _ = emit(.setField(symbolTableIndex), operands: [this, value], type: nil)
+            return
+        }
+        // the copy gives the variable its own definition, copy propagation removes it again
+        let copy = emit(.copy, operands: [value], type: variableType(symbolTableIndex))
+        writeVariable(symbolTableIndex, in: currentBlock, value: copy)
+    }
+    
+    // MARK: expressions
+    
+    private func lower(_ expr: Expr) -> SSAValue {
+        expr.accept(visitor: self as ExprVisitor)
+        return result
+    }
+    
+    public func visitGroupingExpr(expr: GroupingExpr) {
+        result = lower(expr.expression)
+    }
+    
+    public func visitLiteralExpr(expr: LiteralExpr) {
+        switch expr.value {
+        case is Int:
+            result = emit(.constantInt(expr.value as! Int), type: expr.type)
+        case is Double:
+            result = emit(.constantDouble(expr.value as! Double), type: expr.type)
+        case is Bool:
+            result = emit(.constantBoolean(expr.value as! Bool), type: expr.type)
+        case is String:
+            result = emit(.constantString(expr.value as! String), type: expr.type)
+        default:
+            unsupported("Literals of this type", on: expr)
+        }
+    }
+    
+    public func visitArrayLiteralExpr(expr: ArrayLiteralExpr) {
+        let values = expr.values.map { lower($0) }
+        result = emit(.arrayLiteral, operands: values, type: expr.type)
+    }
+    
+    public func visitStaticClassExpr(expr: StaticClassExpr) {
+        unsupported("Classes", on: expr)
+    }
+    
+    public func visitThisExpr(expr: ThisExpr) {
+        guard let thisSymbolTableIndex = thisSymbolTableIndex, expr.symbolTableIndex == thisSymbolTableIndex else {
+            unsupported("'this' outside of constructors", on: expr)
+            return
+        }
+        result = readVariable(thisSymbolTableIndex, in: currentBlock)
+    }
+    
+    public func visitSuperExpr(expr: SuperExpr) {
+        unsupported("Classes", on: expr)
+    }
+    
+    public func visitVariableExpr(expr: VariableExpr) {
+        result = readVariable(expr.symbolTableIndex!)
+    }
+    
+    public func visitSubscriptExpr(expr: SubscriptExpr) {
+        let array = lower(expr.expression)
+        let index = lower(expr.index)
+        result = emit(.arrayGet, operands: [array, index], type: expr.type)
+    }
+    
+    public func visitCallExpr(expr: CallExpr) {
+        guard
+            let callSymbolId = expr.uniqueFunctionCall,
+            let functionSymbol = symbolTable.getSymbol(id: callSymbolId) as? FunctionSymbol,
+            let functionStmt = functionSymbol.functionStmt
+        else {
+            unsupported("Calls to methods and builtin functions", on: expr)
+            return
+        }
+        
+        // parameters that aren't passed get their initializer evaluated at the call site
+        var arguments: [SSAValue] = []
+        for (i, param) in functionStmt.params.enumerated() {
+            arguments.append(lower(i < expr.arguments.count ? expr.arguments[i] : param.initializer!))
+        }
+        result = emit(.call(callSymbolId), operands: arguments, type: expr.type)
+    }
+    
+    public func visitGetExpr(expr: GetExpr) {
+        if expr.object.type is QsArray {
+            result = emit(.arrayLength, operands: [lower(expr.object)], type: expr.type)
+            return
+        }
+        guard let field = instanceField(of: expr) else {
+            unsupported("Static fields and methods", on: expr)
+            return
+        }
+        result = emit(.getField(field), operands: [lower(expr.object)], type: expr.type)
+    }
+    
+    /// The symbol table index of the field that a property access reads or writes, if it is an instance field of an object
+    private func instanceField(of expr: GetExpr) -> Int? {
+        guard expr.object.type is QsClass, !isString(expr.object.type), let propertyId = expr.propertyId, isInstanceField(propertyId) else {
+            return nil
+        }
+        return propertyId
+    }
+    
+    public func visitUnaryExpr(expr: UnaryExpr) {
+        let right = lower(expr.right)
+        result = emit(.unary(expr.opr.tokenType), operands: [right], type: expr.type)
+    }
+    
+    private func convert(_ value: SSAValue, to type: QsType?, expr: Expr) {
+        let fromType = function.instructions[value].type
+        if (type is QsInt && fromType is QsDouble) || (type is QsDouble && fromType is QsInt) {
+            result = emit(.convert, operands: [value], type: type)
+        } else if (type is QsInt || type is QsDouble) && type?.typeId == fromType?.typeId {
+            result = value
+        } else {
+            unsupported("Casts to this type", on: expr)
+        }
+    }
+    
+    public func visitCastExpr(expr: CastExpr) {
+        convert(lower(expr.value), to: expr.type, expr: expr)
+    }
+    
+    public func visitArrayAllocationExpr(expr: ArrayAllocationExpr) {
+        let lengths = expr.capacity.map { lower($0) }
+        result = emit(.arrayAllocate, operands: lengths, type: expr.type)
+    }
+    
+    private func defaultValue(of type: QsType?) -> SSAValue {
+        switch type {
+        case is QsInt:
+            return emit(.constantInt(0), type: type)
+        case is QsDouble:
+            return emit(.constantDouble(0), type: type)
+        case is QsBoolean:
+            return emit(.constantBoolean(false), type: type)
+        default:
+            return emit(.undefined, type: type)
+        }
+    }
+    
+    /// Allocates the object, sets every instance field to its initializer (or to the zero value the VM gives it), superclass fields first,
+    /// and then calls the constructor with the object as its first argument
+    public func visitClassAllocationExpr(expr: ClassAllocationExpr) {
+        let classType = expr.type as! QsClass
+        guard
+            classStmts[classType.id] != nil,
+            let constructorId = expr.callsFunction,
+            let constructorStmt = (symbolTable.getSymbol(id: constructorId) as? MethodSymbol)?.methodStmt?.function
+        else {
+            unsupported("Allocating builtin classes", on: expr)
+            return
+        }
+        let object = emit(.classAllocate(classType.id), type: expr.type)
+        var classChain: [ClassStmt] = []
+        var classSymbolTableIndex: Int? = classType.id
+        while let index = classSymbolTableIndex, let classStmt = classStmts[index] {
+            classChain.insert(classStmt, at: 0)
+            classSymbolTableIndex = (symbolTable.getSymbol(id: index) as! ClassSymbol).upperClass
+        }
+        for classStmt in classChain {
+            for field in classStmt.fields where !field.isStatic && field.symbolTableIndex != nil {
+                let value = field.initializer.map { lower($0) } ?? defaultValue(of: variableType(field.symbolTableIndex!))
+                _ = emit(.setField(field.symbolTableIndex!), operands: [object, value], type: nil)
+            }
+        }
+        
+        var arguments = [object]
+        for (i, param) in constructorStmt.params.enumerated() {
+            arguments.append(lower(i < expr.arguments.count ? expr.arguments[i] : param.initializer!))
+        }
+        _ = emit(.call(constructorId), operands: arguments, type: nil)
+        result = object
+    }
+    
+    public func visitBinaryExpr(expr: BinaryExpr) {
+        let left = lower(expr.left)
+        let right = lower(expr.right)
+        if expr.left.type is QsAnyType || expr.left.type is QsClass && !isString(expr.left.type) {
+            unsupported("The '\(expr.opr.lexeme)' operator on these operands", on: expr)
+            return
+        }
+        result = emit(.binary(expr.opr.tokenType), operands: [left, right], type: expr.type)
+    }
+    
+    public func visitLogicalExpr(expr: LogicalExpr) {
+        // short circuiting: whichever way the left operand skips the right one, the result is the left operand
+        let left = lower(expr.left)
+        let rightBlock = function.addBlock()
+        let joinBlock = function.addBlock()
+        if expr.opr.tokenType == .AND {
+            branch(on: left, then: rightBlock, else: joinBlock)
+        } else {
+            branch(on: left, then: joinBlock, else: rightBlock)
+        }
+        sealBlock(rightBlock)
+        startBlock(rightBlock)
+        let right = lower(expr.right)
+        let rightEndBlock = currentBlock
+        jump(to: joinBlock)
+        sealBlock(joinBlock)
+        startBlock(joinBlock)
+        
+        let phi = function.insertPhi(type: expr.type, in: joinBlock)
+        function.instructions[phi].operands = function.blocks[joinBlock].predecessors.map { $0 == rightEndBlock ? right : left }
+        result = phi
+    }
+    
+    public func visitVariableToSetExpr(expr: VariableToSetExpr) {
+        result = readVariable(expr.to.symbolTableIndex!)
+    }
+    
+    public func visitIsTypeExpr(expr: IsTypeExpr) {
+        // without anys or classes every value's type is known statically, the operand is still evaluated for its side effects
+        if expr.left.type is QsAnyType || expr.left.type is QsClass && !isString(expr.left.type) {
+            unsupported("Type checks on anys and objects", on: expr)
+            return
+        }
+        _ = lower(expr.left)
+        result = emit(.constantBoolean(expr.left.type!.typeId == expr.rightType!.typeId), type: expr.type)
+    }
+    
+    public func visitImplicitCastExpr(expr: ImplicitCastExpr) {
+        convert(lower(expr.expression), to: expr.type, expr: expr)
+    }
+    
+    // MARK: statements
+    
+    private func lower(_ stmt: Stmt) {
+        stmt.accept(visitor: self as StmtVisitor)
+    }
+    
+    private func lower(_ stmts: [Stmt]) {
+        for stmt in stmts {
+            lower(stmt)
+        }
+    }
+    
+    public func visitClassStmt(stmt: ClassStmt) {
+        // constructors are lowered separately, see lowerConstructor. other methods are only a problem once they are called
+    }
+    
+    public func visitMethodStmt(stmt: MethodStmt) {
+        unsupported("Methods", on: stmt)
+    }
+    
+    public func visitFunctionStmt(stmt: FunctionStmt) {
+        // functions are lowered separately, see lowerFunction
+    }
+    
+    public func visitExpressionStmt(stmt: ExpressionStmt) {
+        _ = lower(stmt.expression)
+    }
+    
+    public func visitIfStmt(stmt: IfStmt) {
+        let joinBlock = function.addBlock()
+        var branches = [(condition: stmt.condition, body: stmt.thenBranch)]
+        branches.append(contentsOf: stmt.elseIfBranches.map { (condition: $0.condition, body: $0.thenBranch) })
+        for (condition, body) in branches {
+            let thenBlock = function.addBlock()
+            let elseBlock = function.addBlock()
+            branch(on: lower(condition), then: thenBlock, else: elseBlock)
+            sealBlock(thenBlock)
+            sealBlock(elseBlock)
+            startBlock(thenBlock)
+            lower(body)
+            jump(to: joinBlock)
+            startBlock(elseBlock)
+        }
+        if let elseBranch = stmt.elseBranch {
+            lower(elseBranch)
+        }
+        jump(to: joinBlock)
+        sealBlock(joinBlock)
+        startBlock(joinBlock)
+    }
+    
+    public func visitOutputStmt(stmt: OutputStmt) {
+        let values = stmt.expressions.map { lower($0) }
+        _ = emit(.output, operands: values, type: nil)
+    }
+    
+    private func assign(_ value: SSAValue, to lhs: Expr) {
+        switch lhs {
+        case is SubscriptExpr:
+            let lhs = lhs as! SubscriptExpr
+            let array = lower(lhs.expression)
+            let index = lower(lhs.index)
+            _ = emit(.arraySet, operands: [array, index, value], type: nil)
+        case is VariableToSetExpr:
+            assignVariable((lhs as! VariableToSetExpr).to.symbolTableIndex!, value: value)
+        case is VariableExpr:
+            assignVariable((lhs as! VariableExpr).symbolTableIndex!, value: value)
+        case is GetExpr:
+            let lhs = lhs as! GetExpr
+            guard let field = instanceField(of: lhs) else {
+                error(message: "Assigning to static fields cannot be lowered to SSA", start: lhs.startLocation, end: lhs.endLocation)
+                return
+            }
+            _ = emit(.setField(field), operands: [lower(lhs.object), value], type: nil)
+        default:
+            error(message: "Assigning to this cannot be lowered to SSA", start: lhs.startLocation, end: lhs.endLocation)
+        }
+    }
+    
+    public func visitInputStmt(stmt: InputStmt) {
+        for expr in stmt.expressions {
+            if !(expr.type is QsInt || expr.type is QsDouble || isString(expr.type)) {
+                unsupported("Inputting values of this type", on: stmt)
+                continue
+            }
+            assign(emit(.input, type: expr.type), to: expr)
+        }
+    }
+    
+    public func visitReturnStmt(stmt: ReturnStmt) {
+        let value = stmt.value.map { lower($0) }
+        function.terminate(currentBlock, with: .return(value))
+        startUnreachableBlock()
+    }
+    
+    /// Gives a loop a preheader and a header that isn't sealed until its body, and with it every back edge, has been lowered
+    private func startLoop() -> (preheader: Int, header: Int) {
+        let preheader = function.addBlock()
+        jump(to: preheader)
+        sealBlock(preheader)
+        startBlock(preheader)
+        let header = function.addBlock()
+        jump(to: header)
+        startBlock(header)
+        return (preheader: preheader, header: header)
+    }
+    
+    private func finishLoop(preheader: Int, header: Int, exitBlock: Int) {
+        sealBlock(header)
+        // every block that was created while lowering the loop belongs to it, the exit block is the one exception
+        let blocks = Set(header..<function.blocks.count).subtracting([exitBlock])
+        function.loops.append(.init(preheader: preheader, header: header, blocks: blocks))
+        sealBlock(exitBlock)
+        startBlock(exitBlock)
+    }
+    
+    public func visitLoopFromStmt(stmt: LoopFromStmt) {
+        // the counter is separate from the loop variable, so assigning to the variable in the body doesn't change how often the loop runs
+        let counterStart = lower(stmt.lRange)
+        let upperBound = lower(stmt.rRange)
+        let intType = function.instructions[counterStart].type
+        let (preheader, header) = startLoop()
+        let counter = function.insertPhi(type: intType, in: header)
+        let bodyBlock = function.addBlock()
+        let latchBlock = function.addBlock()
+        let exitBlock = function.addBlock()
+        branch(on: emit(.binary(.LESS_EQUAL), operands: [counter, upperBound], type: QsBoolean()), then: bodyBlock, else: exitBlock)
+        
+        sealBlock(bodyBlock)
+        startBlock(bodyBlock)
+        assignVariable(stmt.variable.symbolTableIndex!, value: counter)
+        loopTargets.append(.init(continueBlock: latchBlock, breakBlock: exitBlock))
+        lower(stmt.body)
+        loopTargets.removeLast()
+        jump(to: latchBlock)
+        
+        sealBlock(latchBlock)
+        startBlock(latchBlock)
+        let one = emit(.constantInt(1), type: intType)
+        let nextCounter = emit(.binary(.PLUS), operands: [counter, one], type: intType)
+        jump(to: header)
+        // the header's predecessors are the preheader and the latch, in that order
+        function.instructions[counter].operands = [counterStart, nextCounter]
+        finishLoop(preheader: preheader, header: header, exitBlock: exitBlock)
+    }
+    
+    public func visitWhileStmt(stmt: WhileStmt) {
+        let (preheader, header) = startLoop()
+        let bodyBlock = function.addBlock()
+        let exitBlock = function.addBlock()
+        branch(on: lower(stmt.expression), then: bodyBlock, else: exitBlock)
+        
+        sealBlock(bodyBlock)
+        startBlock(bodyBlock)
+        loopTargets.append(.init(continueBlock: header, breakBlock: exitBlock))
+        lower(stmt.body)
+        loopTargets.removeLast()
+        jump(to: header)
+        finishLoop(preheader: preheader, header: header, exitBlock: exitBlock)
+    }
+    
+    public func visitBreakStmt(stmt: BreakStmt) {
+        function.terminate(currentBlock, with: .jump(loopTargets.last!.breakBlock))
+        startUnreachableBlock()
+    }
+    
+    public func visitContinueStmt(stmt: ContinueStmt) {
+        function.terminate(currentBlock, with: .jump(loopTargets.last!.continueBlock))
+        startUnreachableBlock()
+    }
+    
+    public func visitBlockStmt(stmt: BlockStmt) {
+        lower(stmt.statements)
+    }
+    
+    public func visitExitStmt(stmt: ExitStmt) {
+        function.terminate(currentBlock, with: .exit)
+        startUnreachableBlock()
+    }
+    
+    public func visitMultiSetStmt(stmt: MultiSetStmt) {
+        for setStmt in stmt.setStmts {
+            lower(setStmt)
+        }
+    }
+    
+    public func visitSetStmt(stmt: SetStmt) {
+        // the value is evaluated before any of the targets, like the interpreter does
+        let value = lower(stmt.value)
+        for chained in stmt.chained.reversed() {
+            assign(value, to: chained)
+        }
+        assign(value, to: stmt.left)
+    }
+    
+    // MARK: functions
+    
+    private func startFunction(name: String, symbolTableIndex: Int?) {
+        function = SSAFunction(name: name, symbolTableIndex: symbolTableIndex)
+        currentDefinitions = [:]
+        sealedBlocks = []
+        incompletePhis = [:]
+        loopTargets = []
+        thisSymbolTableIndex = nil
+        let entryBlock = function.addBlock()
+        sealBlock(entryBlock)
+        startBlock(entryBlock)
+    }
+    
+    private func finishFunction() {
+        if case .unterminated = function.blocks[currentBlock].terminator {
+            function.terminate(currentBlock, with: .return(nil))
+        }
+    }
+    
+    private func lowerFunction(_ symbol: FunctionSymbol) -> SSAFunction {
+        let functionStmt = symbol.functionStmt!
+        startFunction(name: functionStmt.name.lexeme, symbolTableIndex: symbol.id)
+        lowerBody(of: functionStmt)
+        return function
+    }
+    
+    /// Constructors take the object they initialise as an extra first parameter
+    private func lowerConstructor(_ symbol: MethodSymbol, in classStmt: ClassStmt) -> SSAFunction {
+        let functionStmt = symbol.methodStmt!.function
+        startFunction(name: "\(classStmt.name.lexeme).\(functionStmt.name.lexeme)", symbolTableIndex: symbol.id)
+        if let thisSymbolTableIndex = classStmt.instanceThisSymbolTableIndex {
+            self.thisSymbolTableIndex = thisSymbolTableIndex
+            let this = emit(.parameter(thisSymbolTableIndex), type: variableType(thisSymbolTableIndex))
+            writeVariable(thisSymbolTableIndex, in: currentBlock, value: this)
+            function.parameters.append(thisSymbolTableIndex)
+        }
+        lowerBody(of: functionStmt)
+        return function
+    }
+    
+    private func lowerBody(of functionStmt: FunctionStmt) {
+        for param in functionStmt.params {
+            let value = emit(.parameter(param.symbolTableIndex!), type: variableType(param.symbolTableIndex!))
+            writeVariable(param.symbolTableIndex!, in: currentBlock, value: value)
+            function.parameters.append(param.symbolTableIndex!)
+        }
+        lower(functionStmt.body)
+        finishFunction()
+    }
+    
+    /// Lowers a type checked AST. The module is only meaningful when there are no problems
+    public func buildModule(statements: [Stmt], symbolTable: SymbolTable) -> (SSAModule, [InterpreterProblem]) {
+        self.symbolTable = symbolTable
+        stringClassId = symbolTable.queryAtGlobalOnly("String<>")?.id ?? -1
+        problems = []
+        classStmts = [:]
+        for statement in statements {
+            if let classStmt = statement as? ClassStmt, !classStmt.builtin, let symbolTableIndex = classStmt.symbolTableIndex {
+                classStmts[symbolTableIndex] = classStmt
+            }
+        }
+        
+        let module = SSAModule()
+        startFunction(name: "<main>", symbolTableIndex: nil)
+        lower(statements)
+        finishFunction()
+        module.functions.append(function)
+        for symbol in symbolTable.getAllSymbols() {
+            if let symbol = symbol as? FunctionSymbol, symbol.functionStmt != nil {
+                module.functions.append(lowerFunction(symbol))
+            } else if let symbol = symbol as? MethodSymbol, symbol.isConstructor, symbol.methodStmt != nil, let classStmt = classStmts[symbol.withinClass] {
+                module.functions.append(lowerConstructor(symbol, in: classStmt))
+            }
+        }
+        return (module, problems)
+    }
+}
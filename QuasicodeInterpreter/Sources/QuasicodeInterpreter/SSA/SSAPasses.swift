@@ -0,0 +1,606 @@
+/// Which optimisations SSAPasses runs. Each of them can be turned off on its own, to compare their output or to track down a miscompile
+public struct SSAPassOptions {
+    public var copyPropagation = true
+    public var commonSubexpressionElimination = true
+    public var loopInvariantCodeMotion = true
+    public var deadStoreElimination = true
+    public var escapeAnalysis = true
+    
+    public static let all = SSAPassOptions()
+    public static let none = SSAPassOptions(
+        copyPropagation: false,
+        commonSubexpressionElimination: false,
+        loopInvariantCodeMotion: false,
+        deadStoreElimination: false,
+        escapeAnalysis: false
+    )
+}
+
+/// The optimisations that run on SSA functions between lowering and bytecode emission. Unreachable blocks are always removed first, since
+/// the dominator tree that the other passes rely on only covers reachable code.
+public class SSAPasses {
+    let options: SSAPassOptions
+    // the number of instructions every pass removed or moved, by pass name
+    public private(set) var statistics: [String : Int] = [:]
+    
+    public init(options: SSAPassOptions = .all) {
+        self.options = options
+    }
+    
+    public func optimise(_ module: SSAModule) {
+        for function in module.functions {
+            optimise(function)
+        }
+        if options.escapeAnalysis {
+            // escape analysis looks across calls, so it runs once every function is optimised on its own
+            count("frame allocation", allocateInFrames(module))
+            for function in module.functions {
+                let replaced = replaceScalars(function)
+                count("scalar replacement", replaced)
+                if replaced > 0 {
+                    // clean up the copies the loads became and the array literals that are no longer used
+                    count("copy propagation", propagateCopies(function))
+                    count("dead store elimination", eliminateDeadStores(function))
+                }
+            }
+        }
+    }
+    
+    func optimise(_ function: SSAFunction) {
+        removeUnreachableBlocks(function)
+        if options.copyPropagation {
+            count("copy propagation", propagateCopies(function))
+        }
+        if options.commonSubexpressionElimination {
+            count("common subexpression elimination", eliminateCommonSubexpressions(function))
+        }
+        if options.loopInvariantCodeMotion {
+            count("loop invariant code motion", hoistLoopInvariants(function))
+            if options.commonSubexpressionElimination {
+                // hoisting puts invariants from sibling loops next to each other in the preheader of their parent
+                count("common subexpression elimination", eliminateCommonSubexpressions(function))
+            }
+        }
+        if options.deadStoreElimination {
+            count("dead store elimination", eliminateDeadStores(function))
+        }
+    }
+    
+    private func count(_ pass: String, _ changes: Int) {
+        statistics[pass, default: 0] += changes
+    }
+    
+    // MARK: control flow
+    
+    func removeUnreachableBlocks(_ function: SSAFunction) {
+        var reachable: Set<Int> = [function.entryBlock]
+        var worklist = [function.entryBlock]
+        while let block = worklist.popLast() {
+            for successor in function.blocks[block].terminator.successors where !reachable.contains(successor) {
+                reachable.insert(successor)
+                worklist.append(successor)
+            }
+        }
+        for block in function.blocks.indices where !reachable.contains(block) {
+            function.blocks[block].reachable = false
+        }
+        // drop the edges out of unreachable blocks along with the phi operands they bring in
+        for block in function.blocks.indices where reachable.contains(block) {
+            let predecessors = function.blocks[block].predecessors
+            let kept = predecessors.indices.filter { reachable.contains(predecessors[$0]) }
+            if kept.count == predecessors.count {
+                continue
+            }
+            function.blocks[block].predecessors = kept.map { predecessors[$0] }
+            for instruction in function.blocks[block].instructions where function.instructions[instruction].operation == .phi {
+                let operands = function.instructions[instruction].operands
+                function.instructions[instruction].operands = kept.map { operands[$0] }
+            }
+        }
+        for loopIndex in function.loops.indices {
+            function.loops[loopIndex].blocks = function.loops[loopIndex].blocks.intersection(reachable)
+        }
+        function.loops.removeAll { !reachable.contains($0.header) }
+    }
+    
+    /// Reachable blocks in reverse postorder, where every block comes after its dominators
+    func reversePostorder(_ function: SSAFunction) -> [Int] {
+        var visited: Set<Int> = []
+        var postorder: [Int] = []
+        func visit(_ block: Int) {
+            visited.insert(block)
+            for successor in function.blocks[block].terminator.successors where !visited.contains(successor) {
+                visit(successor)
+            }
+            postorder.append(block)
+        }
+        visit(function.entryBlock)
+        return postorder.reversed()
+    }
+    
+    /// The immediate dominator of every reachable block, using "A Simple, Fast Dominance Algorithm" (Cooper, Harvey and Kennedy)
+    func immediateDominators(_ function: SSAFunction) -> [Int : Int] {
+        let order = reversePostorder(function)
+        var orderIndex: [Int : Int] = [:]
+        for (index, block) in order.enumerated() {
+            orderIndex[block] = index
+        }
+        var dominators: [Int : Int] = [function.entryBlock: function.entryBlock]
+        func intersect(_ lhs: Int, _ rhs: Int) -> Int {
+            var lhs = lhs
+            var rhs = rhs
+            while lhs != rhs {
+                while orderIndex[lhs]! > orderIndex[rhs]! {
+                    lhs = dominators[lhs]!
+                }
+                while orderIndex[rhs]! > orderIndex[lhs]! {
+                    rhs = dominators[rhs]!
+                }
+            }
+            return lhs
+        }
+        var changed = true
+        while changed {
+            changed = false
+            for block in order.dropFirst() {
+                var newDominator: Int?
+                for predecessor in function.blocks[block].predecessors where dominators[predecessor] != nil {
+                    newDominator = newDominator == nil ? predecessor : intersect(predecessor, newDominator!)
+                }
+                if let newDominator = newDominator, dominators[block] != newDominator {
+                    dominators[block] = newDominator
+                    changed = true
+                }
+            }
+        }
+        return dominators
+    }
+    
+    // MARK: copy propagation
+    
+    /// Replaces copies, and phis whose operands are all the same value, with the value they copy
+    func propagateCopies(_ function: SSAFunction) -> Int {
+        var removed = 0
+        var changed = true
+        while changed {
+            changed = false
+            var replacements: [SSAValue: SSAValue] = [:]
+            for block in function.blocks.indices where function.blocks[block].reachable {
+                for value in function.blocks[block].instructions {
+                    let instruction = function.instructions[value]
+                    var copied: SSAValue?
+                    if instruction.operation == .copy {
+                        copied = instruction.operands[0]
+                    } else if instruction.operation == .phi {
+                        // a phi that only merges itself with one other value, which is what a variable that isn't changed in a loop leaves
+                        let incoming = Set(instruction.operands).subtracting([value])
+                        if incoming.count == 1 {
+                            copied = incoming.first!
+                        }
+                    }
+                    // only ever point at a value that isn't being replaced itself, so that phis that merge each other can't form a cycle
+                    guard var target = copied else {
+                        continue
+                    }
+                    while let replacement = replacements[target] {
+                        target = replacement
+                    }
+                    if target != value {
+                        replacements[value] = target
+                    }
+                }
+            }
+            if !replacements.isEmpty {
+                function.replaceUses(replacements)
+                for value in replacements.keys {
+                    function.remove(value)
+                }
+                removed += replacements.count
+                changed = true
+            }
+        }
+        return removed
+    }
+    
+    // MARK: common subexpression elimination
+    
+    private struct ExpressionKey: Hashable {
+        var operation: SSAOperation
+        var operands: [SSAValue]
+        var typeId: Int?
+    }
+    
+    /// Replaces pure instructions that recompute a value that an instruction in a dominating block already computed. Loads are also reused
+    /// within a block, until something that might change the memory they read from, and a store makes the value it stores available to
+    /// later loads of the same place.
+    func eliminateCommonSubexpressions(_ function: SSAFunction) -> Int {
+        let dominators = immediateDominators(function)
+        var children: [Int : [Int]] = [:]
+        for (block, dominator) in dominators where block != dominator {
+            children[dominator, default: []].append(block)
+        }
+        
+        var removed = 0
+        var replacements: [SSAValue: SSAValue] = [:]
+        func resolve(_ value: SSAValue) -> SSAValue {
+            var value = value
+            while let replacement = replacements[value] {
+                value = replacement
+            }
+            return value
+        }
+        
+        // walks the dominator tree with a scoped table of the pure expressions that are available
+        var available: [ExpressionKey: SSAValue] = [:]
+        func visit(_ block: Int) {
+            var addedKeys: [ExpressionKey] = []
+            var availableGlobals: [Int : SSAValue] = [:]
+            var availableElements: [[SSAValue] : SSAValue] = [:]
+            var kept: [SSAValue] = []
+            for value in function.blocks[block].instructions {
+                function.instructions[value].operands = function.instructions[value].operands.map(resolve)
+                let instruction = function.instructions[value]
+                var replacement: SSAValue?
+                switch instruction.operation {
+                case .loadGlobal(let global):
+                    replacement = availableGlobals[global]
+                    availableGlobals[global] = replacement ?? value
+                case .storeGlobal(let global):
+                    availableGlobals[global] = instruction.operands[0]
+                case .arrayGet:
+                    replacement = availableElements[instruction.operands]
+                    availableElements[instruction.operands] = replacement ?? value
+                case .arraySet:
+                    // any other array could be the same one
+                    availableElements = [:]
+                    availableElements[[instruction.operands[0], instruction.operands[1]]] = instruction.operands[2]
+                case .call:
+                    availableGlobals = [:]
+                    availableElements = [:]
+                default:
+                    if function.isPure(value) {
+                        let key = ExpressionKey(operation: instruction.operation, operands: instruction.operands, typeId: instruction.type?.typeId)
+                        replacement = available[key]
+                        if replacement == nil {
+                            available[key] = value
+                            addedKeys.append(key)
+                        }
+                    }
+                }
+                if let replacement = replacement {
+                    replacements[value] = replacement
+                    removed += 1
+                } else {
+                    kept.append(value)
+                }
+            }
+            function.blocks[block].instructions = kept
+            for child in children[block] ?? [] {
+                visit(child)
+            }
+            for key in addedKeys {
+                available[key] = nil
+            }
+        }
+        visit(function.entryBlock)
+        // phis and terminators can refer to values from blocks that were visited later
+        function.replaceUses(replacements)
+        return removed
+    }
+    
+    // MARK: loop invariant code motion
+    
+    /// Moves instructions that compute the same value on every iteration of a loop into the loop's preheader. Only instructions that can't
+    /// stop the program are moved, since the loop body might never run. Loads of globals are moved when nothing in the loop can store to them
+    func hoistLoopInvariants(_ function: SSAFunction) -> Int {
+        var hoisted = 0
+        // inner loops first, so that what is hoisted out of them can be hoisted further out of their parents
+        let loops = function.loops.sorted { $0.blocks.count < $1.blocks.count }
+        for loop in loops {
+            var storedGlobals: Set<Int> = []
+            var containsCall = false
+            for block in loop.blocks {
+                for value in function.blocks[block].instructions {
+                    switch function.instructions[value].operation {
+                    case .storeGlobal(let global):
+                        storedGlobals.insert(global)
+                    case .call:
+                        containsCall = true
+                    default:
+                        break
+                    }
+                }
+            }
+            func isInvariant(_ value: SSAValue, definedInLoop: Set<SSAValue>) -> Bool {
+                let instruction = function.instructions[value]
+                if function.canTrap(value) || instruction.operation == .phi {
+                    return false
+                }
+                if case .loadGlobal(let global) = instruction.operation {
+                    return !containsCall && !storedGlobals.contains(global)
+                }
+                if !function.isPure(value) {
+                    return false
+                }
+                return instruction.operands.allSatisfy { !definedInLoop.contains($0) }
+            }
+            
+            var definedInLoop: Set<SSAValue> = []
+            for block in loop.blocks {
+                definedInLoop.formUnion(function.blocks[block].instructions)
+            }
+            // blocks in creation order visit definitions before their uses, apart from phis
+            var changed = true
+            while changed {
+                changed = false
+                for block in loop.blocks.sorted() {
+                    for value in function.blocks[block].instructions where isInvariant(value, definedInLoop: definedInLoop) {
+                        function.remove(value)
+                        function.blocks[loop.preheader].instructions.append(value)
+                        function.instructions[value].block = loop.preheader
+                        definedInLoop.remove(value)
+                        hoisted += 1
+                        changed = true
+                    }
+                }
+            }
+        }
+        return hoisted
+    }
+    
+    // MARK: dead store elimination
+    
+    /// Whether the value is a reference through which an instruction could get at the elements of an array
+    private func mightReferToArray(_ value: SSAValue, in function: SSAFunction) -> Bool {
+        let type = function.instructions[value].type
+        return type is QsArray || type is QsAnyType
+    }
+    
+    /// Removes stores that are overwritten later in the same block before anything could read them, and then instructions whose values are
+    /// never used and that have no effect besides computing that value
+    func eliminateDeadStores(_ function: SSAFunction) -> Int {
+        var removed = 0
+        for block in function.blocks.indices where function.blocks[block].reachable {
+            var overwrittenGlobals: Set<Int> = []
+            var overwrittenElements: Set<[SSAValue]> = []
+            var dead: Set<SSAValue> = []
+            for value in function.blocks[block].instructions.reversed() {
+                let instruction = function.instructions[value]
+                switch instruction.operation {
+                case .storeGlobal(let global):
+                    if overwrittenGlobals.contains(global) {
+                        dead.insert(value)
+                    }
+                    overwrittenGlobals.insert(global)
+                    if mightReferToArray(instruction.operands[0], in: function) {
+                        overwrittenElements = []
+                    }
+                case .loadGlobal(let global):
+                    overwrittenGlobals.remove(global)
+                case .arraySet:
+                    let element = [instruction.operands[0], instruction.operands[1]]
+                    if overwrittenElements.contains(element) {
+                        dead.insert(value)
+                    }
+                    if mightReferToArray(instruction.operands[2], in: function) {
+                        // storing a nested array lets it be read through the outer one
+                        overwrittenElements = []
+                    }
+                    overwrittenElements.insert(element)
+                case .arrayGet:
+                    // it might read the element through another reference to the same array
+                    overwrittenElements = []
+                case .call:
+                    overwrittenGlobals = []
+                    overwrittenElements = []
+                default:
+                    // outputting an array reads its elements, and storing or copying a reference to it somewhere lets something else read them
+                    if instruction.operands.contains(where: { mightReferToArray($0, in: function) }) {
+                        overwrittenElements = []
+                    }
+                }
+            }
+            function.blocks[block].instructions.removeAll { dead.contains($0) }
+            removed += dead.count
+        }
+        
+        var changed = true
+        while changed {
+            changed = false
+            let useCounts = function.useCounts()
+            for block in function.blocks.indices where function.blocks[block].reachable {
+                let unused = function.blocks[block].instructions.filter { value in
+                    useCounts[value] == 0 && !function.hasSideEffects(value) && !function.canTrap(value)
+                }
+                if !unused.isEmpty {
+                    function.blocks[block].instructions.removeAll { unused.contains($0) }
+                    removed += unused.count
+                    changed = true
+                }
+            }
+        }
+        return removed
+    }
+    
+    // MARK: escape analysis
+    
+    private struct Uses {
+        var users: [SSAValue: [SSAValue]] = [:] // the instructions in reachable code that use every value
+        var returned: Set<SSAValue> = []
+        
+        init(of function: SSAFunction) {
+            for block in function.blocks where block.reachable {
+                for value in block.instructions {
+                    for operand in function.instructions[value].operands {
+                        users[operand, default: []].append(value)
+                    }
+                }
+                if case .return(let value?) = block.terminator {
+                    returned.insert(value)
+                }
+            }
+        }
+    }
+    
+    private struct EscapeSummaries {
+        var functions: [Int : SSAFunction] = [:] // by symbol table index
+        var escapingParameters: [Int : Set<Int>] = [:] // the symbol table indices of the parameters of every function that escape
+    }
+    
+    /// Whether a reference to an allocation can outlive the call that made it. Every value derived from the reference is followed: copies,
+    /// and the arrays nested in a multidimensional array. It escapes when it is stored into memory, merged by a phi, returned, or passed
+    /// to a function that lets that parameter escape. A phi counts as escaping since an allocation in a loop reuses its frame slot on every
+    /// iteration, while the one from the previous iteration could still be reachable through the phi.
+    private func escapes(_ reference: SSAValue, in function: SSAFunction, uses: Uses, summaries: EscapeSummaries) -> Bool {
+        var visited: Set<SSAValue> = [reference]
+        var worklist = [reference]
+        while let value = worklist.popLast() {
+            if uses.returned.contains(value) {
+                return true
+            }
+            for user in uses.users[value] ?? [] {
+                let instruction = function.instructions[user]
+                var derived = false
+                switch instruction.operation {
+                case .copy:
+                    derived = true
+                case .arrayGet:
+                    derived = instruction.type is QsArray
+                case .arrayLength, .getField, .output:
+                    break
+                case .arraySet:
+                    if instruction.operands[2] == value {
+                        return true
+                    }
+                case .setField:
+                    if instruction.operands[1] == value {
+                        return true
+                    }
+                case .call(let calleeIndex):
+                    guard let callee = summaries.functions[calleeIndex], let escapingParameters = summaries.escapingParameters[calleeIndex] else {
+                        return true
+                    }
+                    for (position, operand) in instruction.operands.enumerated() where operand == value {
+                        if position >= callee.parameters.count || escapingParameters.contains(callee.parameters[position]) {
+                            return true
+                        }
+                    }
+                default:
+                    return true
+                }
+                if derived && !visited.contains(user) {
+                    visited.insert(user)
+                    worklist.append(user)
+                }
+            }
+        }
+        return false
+    }
+    
+    /// Marks the allocations that don't escape as frame allocated, so that a backend could put them in the stack region of the call frame
+    /// instead of going through compilerReallocate and the garbage collector. Which parameters of every function escape is worked out first,
+    /// starting from none and growing until nothing changes, so that passing an allocation to a function that only reads it doesn't make it
+    /// escape.
+    func allocateInFrames(_ module: SSAModule) -> Int {
+        var summaries = EscapeSummaries()
+        for function in module.functions {
+            if let symbolTableIndex = function.symbolTableIndex {
+                summaries.functions[symbolTableIndex] = function
+                summaries.escapingParameters[symbolTableIndex] = []
+            }
+        }
+        let uses = module.functions.map { Uses(of: $0) }
+        
+        var changed = true
+        while changed {
+            changed = false
+            for (function, uses) in zip(module.functions, uses) {
+                guard let symbolTableIndex = function.symbolTableIndex else {
+                    continue
+                }
+                for value in function.blocks[function.entryBlock].instructions {
+                    guard
+                        case .parameter(let parameter) = function.instructions[value].operation,
+                        !summaries.escapingParameters[symbolTableIndex]!.contains(parameter),
+                        escapes(value, in: function, uses: uses, summaries: summaries)
+                    else {
+                        continue
+                    }
+                    summaries.escapingParameters[symbolTableIndex]!.insert(parameter)
+                    changed = true
+                }
+            }
+        }
+        
+        var frameAllocated = 0
+        for (function, uses) in zip(module.functions, uses) {
+            for block in function.blocks where block.reachable {
+                for value in block.instructions where function.isAllocation(value) {
+                    let isFrameAllocated = !escapes(value, in: function, uses: uses, summaries: summaries)
+                    function.instructions[value].isFrameAllocated = isFrameAllocated
+                    frameAllocated += isFrameAllocated ? 1 : 0
+                }
+            }
+        }
+        return frameAllocated
+    }
+    
+    /// Replaces frame allocated array literals whose only uses are reads and writes of constant indices in the block that creates them, and
+    /// their length, by the values of their elements. Reads become copies of the element's current value, writes disappear and the literal
+    /// is left unused.
+    func replaceScalars(_ function: SSAFunction) -> Int {
+        var replaced = 0
+        let useCounts = function.useCounts()
+        for block in function.blocks.indices where function.blocks[block].reachable {
+            let instructions = function.blocks[block].instructions
+            for (position, literal) in instructions.enumerated() {
+                guard function.instructions[literal].operation == .arrayLiteral, function.instructions[literal].isFrameAllocated else {
+                    continue
+                }
+                var elements = function.instructions[literal].operands
+                func constantIndex(_ value: SSAValue) -> Int? {
+                    if case .constantInt(let index) = function.instructions[value].operation, index >= 0 && index < elements.count {
+                        return index
+                    }
+                    return nil
+                }
+                
+                // every use has to come after the literal in the same block, and be one that can be replaced
+                let uses = instructions[(position + 1)...].filter { function.instructions[$0].operands.contains(literal) }
+                let isReplaceable = uses.count == useCounts[literal] && uses.allSatisfy { value in
+                    let instruction = function.instructions[value]
+                    switch instruction.operation {
+                    case .arrayGet, .arraySet:
+                        return instruction.operands.filter { $0 == literal }.count == 1 && constantIndex(instruction.operands[1]) != nil
+                    case .arrayLength:
+                        return true
+                    default:
+                        return false
+                    }
+                }
+                if !isReplaceable {
+                    continue
+                }
+                
+                var stores: Set<SSAValue> = []
+                for value in uses {
+                    let instruction = function.instructions[value]
+                    switch instruction.operation {
+                    case .arrayGet:
+                        function.instructions[value].operation = .copy
+                        function.instructions[value].operands = [elements[constantIndex(instruction.operands[1])!]]
+                    case .arraySet:
+                        elements[constantIndex(instruction.operands[1])!] = instruction.operands[2]
+                        stores.insert(value)
+                    default:
+                        function.instructions[value].operation = .constantInt(elements.count)
+                        function.instructions[value].operands = []
+                    }
+                }
+                function.blocks[block].instructions.removeAll { stores.contains($0) }
+                replaced += 1
+            }
+        }
+        return replaced
+    }
+}
@@ -0,0 +1,93 @@
+import Dispatch
+
+public struct SymbolTableBenchmarkResult {
+    public let symbolCount: Int
+    // how many of the lookups found something, so that a broken lookup shows up next to the timings
+    public let lookupsFound: Int
+    public let buildMilliseconds: Double
+    public let queryMilliseconds: Double
+    public let getAllMethodsMilliseconds: Double
+}
+
+extension SymbolTable {
+    /// Builds a symbol table shaped like a large program (lots of globals and a deep class hierarchy whose classes override each other's methods)
+    /// and times lookups against it. Run it through the symbolTableBenchmark execution mode in main.swift.
+    public static func benchmark(
+        globalCount: Int = 5000,
+        classDepth: Int = 50,
+        methodsPerClass: Int = 40,
+        lookupRounds: Int = 20
+    ) -> SymbolTableBenchmarkResult {
+        func milliseconds(since start: DispatchTime) -> Double {
+            return Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000
+        }
+        
+        let buildStart = DispatchTime.now()
+        let symbolTable = SymbolTable()
+        for i in 0..<globalCount {
+            symbolTable.addToSymbolTable(symbol: VariableSymbol(type: QsInt(), name: "global\(i)", variableStatus: .finishedInit, variableType: .global))
+        }
+        var classScopes: [Int] = []
+        for classIndex in 0..<classDepth {
+            symbolTable.resetScope()
+            let classId = symbolTable.addToSymbolTable(
+                symbol: ClassSymbol(name: "Class\(classIndex)<>", displayName: "Class\(classIndex)", nonSignatureName: "Class\(classIndex)", builtin: false, parentOf: [])
+            )
+            let classScope = symbolTable.createAndEnterScope()
+            if let superclassScope = classScopes.last {
+                symbolTable.linkCurrentTableToParent(withId: superclassScope)
+            }
+            classScopes.append(classScope)
+            for methodIndex in 0..<methodsPerClass {
+                let methodId = symbolTable.addToSymbolTable(
+                    symbol: MethodSymbol(
+                        name: "method\(methodIndex)<Int>",
+                        withinClass: classId,
+                        overridedBy: [],
+                        isStatic: false,
+                        visibility: .PUBLIC,
+                        functionParams: [.init(name: "x", type: QsInt())],
+                        paramRange: 1...1,
+                        returnType: QsVoidType(),
+                        isConstructor: false
+                    )
+                )
+                symbolTable.addToSymbolTable(symbol: FunctionNameSymbol(isForMethods: true, name: "#FuncName#method\(methodIndex)", belongingFunctions: [methodId]))
+            }
+        }
+        let buildTime = milliseconds(since: buildStart)
+        
+        let queriedGlobalNames = stride(from: 0, to: globalCount, by: 10).map { "global\($0)" }
+        let methodNames = (0..<methodsPerClass).map { "method\($0)" }
+        var found = 0
+        let queryStart = DispatchTime.now()
+        for _ in 0..<lookupRounds {
+            for classScope in classScopes {
+                symbolTable.gotoTable(classScope)
+                for name in queriedGlobalNames where symbolTable.query(name) != nil {
+                    found += 1
+                }
+            }
+        }
+        let queryTime = milliseconds(since: queryStart)
+        
+        let getAllMethodsStart = DispatchTime.now()
+        for _ in 0..<lookupRounds {
+            for classScope in classScopes {
+                symbolTable.gotoTable(classScope)
+                for methodName in methodNames {
+                    found += symbolTable.getAllMethods(methodName: methodName).count
+                }
+            }
+        }
+        let getAllMethodsTime = milliseconds(since: getAllMethodsStart)
+        
+        return .init(
+            symbolCount: symbolTable.getAllSymbols().count,
+            lookupsFound: found,
+            buildMilliseconds: buildTime,
+            queryMilliseconds: queryTime,
+            getAllMethodsMilliseconds: getAllMethodsTime
+        )
+    }
+}
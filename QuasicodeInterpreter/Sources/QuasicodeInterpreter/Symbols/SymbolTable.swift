@@ -3,21 +3,55 @@ public class SymbolTable {
         let id: Int
         var parent: ScopeTable?
         var childTables: [ScopeTable] = []
-        private var table: [String : Symbol] = [:]
+        // open addressed table from interned name ids to symbols, with linear probing
+        // the capacity is always a power of two, and the table is kept at most half full
+        private var slotNameIds: [Int] = .init(repeating: -1, count: 8)
+        private var slotSymbols: [Symbol?] = .init(repeating: nil, count: 8)
+        private var count = 0
         private var allSymbolsCache: [Symbol]?
         init(parent: ScopeTable?, id: Int) {
             self.parent = parent
             self.id = id
         }
         
-        public func queryTable(name: String) -> Symbol? {
-            return table[name]
+        private func findSlot(nameId: Int, slotNameIds: [Int]) -> Int {
+            let mask = slotNameIds.count - 1
+            // fibonacci hashing so that consecutive name ids spread out
+            var slot = Int(truncatingIfNeeded: (UInt64(bitPattern: Int64(nameId)) &* 11400714819323198485) >> 32) & mask
+            while slotNameIds[slot] != -1 && slotNameIds[slot] != nameId {
+                slot = (slot + 1) & mask
+            }
+            return slot
+        }
+        
+        private func grow() {
+            let oldSlotNameIds = slotNameIds
+            let oldSlotSymbols = slotSymbols
+            slotNameIds = .init(repeating: -1, count: oldSlotNameIds.count * 2)
+            slotSymbols = .init(repeating: nil, count: oldSlotNameIds.count * 2)
+            for i in 0..<oldSlotNameIds.count where oldSlotNameIds[i] != -1 {
+                let slot = findSlot(nameId: oldSlotNameIds[i], slotNameIds: slotNameIds)
+                slotNameIds[slot] = oldSlotNameIds[i]
+                slotSymbols[slot] = oldSlotSymbols[i]
+            }
+        }
+        
+        public func queryTable(nameId: Int) -> Symbol? {
+            return slotSymbols[findSlot(nameId: nameId, slotNameIds: slotNameIds)]
         }
-        public func addToTable(symbol: Symbol) {
+        public func addToTable(symbol: Symbol, nameId: Int) {
             if allSymbolsCache != nil {
                 allSymbolsCache!.append(symbol)
             }
-            table[symbol.name] = symbol
+            if (count + 1) * 2 > slotNameIds.count {
+                grow()
+            }
+            let slot = findSlot(nameId: nameId, slotNameIds: slotNameIds)
+            if slotNameIds[slot] == -1 {
+                count += 1
+            }
+            slotNameIds[slot] = nameId
+            slotSymbols[slot] = symbol
         }
         public func linkTableToParent(_ parent: ScopeTable) {
             self.parent = parent
@@ -25,18 +59,29 @@ public class SymbolTable {
         public func getAllSymbolsInTable() -> [Symbol] {
             if allSymbolsCache == nil {
                 allSymbolsCache = []
-                for symbol in table.values {
-                    allSymbolsCache!.append(symbol)
+                for symbol in slotSymbols where symbol != nil {
+                    allSymbolsCache!.append(symbol!)
                 }
             }
             return allSymbolsCache!
         }
     }
+    private struct MethodLookupKey: Hashable {
+        let tableId: Int
+        let nameId: Int
+    }
     private var allSymbols: [Symbol] = []
     private var tables: [ScopeTable] = []
     private var current: ScopeTable
     private var classRuntimeIdCount = 0
     private var classSymbolTableIndexToRuntimeIdDict: [Int : Int] = [:]
+    // every symbol name is interned once, scopes are then keyed by the name's id
+    private var nameIds: [String : Int] = [:]
+    // method name -> name id of its "#FuncName#" symbol, so method lookups don't have to build the string
+    private var functionNameSymbolNameIds: [String : Int] = [:]
+    // the function name symbols that make up the result of getAllMethods, by the table the lookup started from.
+    // the belonging functions are read from the symbols on every lookup since the resolver appends to them in place
+    private var methodLookupCache: [MethodLookupKey : [FunctionNameSymbol]] = [:]
     
     private func exitScope() {
         current = current.parent!
@@ -47,6 +92,29 @@ public class SymbolTable {
         tables.append(current)
     }
     
+    private init(sharingStorageWith other: SymbolTable) {
+        allSymbols = other.allSymbols
+        tables = other.tables
+        current = other.current
+        classRuntimeIdCount = other.classRuntimeIdCount
+        classSymbolTableIndexToRuntimeIdDict = other.classSymbolTableIndexToRuntimeIdDict
+        nameIds = other.nameIds
+        functionNameSymbolNameIds = other.functionNameSymbolNameIds
+        methodLookupCache = other.methodLookupCache
+    }
+    
+    /// Creates a symbol table that shares every scope and symbol with this one but keeps its own current scope,
+    /// so that several threads can move around and query the same tables at once.
+    /// Symbols added to the view are not visible from the original table, so views should only be used after the resolver is done.
+    /// Views have to be created before the threads start, since creating one fills the caches that the scopes share.
+    public func createView() -> SymbolTable {
+        // the scopes fill their list of symbols lazily, which the threads would otherwise race on
+        for table in tables {
+            _ = table.getAllSymbolsInTable()
+        }
+        return .init(sharingStorageWith: self)
+    }
+    
     public func getClassRuntimeIdCount() -> Int {
         return classRuntimeIdCount
     }
@@ -92,21 +160,46 @@ public class SymbolTable {
         current = tables[index]
     }
     
+    private func internName(_ name: String) -> Int {
+        if let nameId = nameIds[name] {
+            return nameId
+        }
+        let nameId = nameIds.count
+        nameIds[name] = nameId
+        if name.hasPrefix("#FuncName#") {
+            functionNameSymbolNameIds[String(name.dropFirst("#FuncName#".count))] = nameId
+        }
+        return nameId
+    }
+    
     public func queryAtScopeOnly(_ name: String) -> Symbol? {
-        return current.queryTable(name: name)
+        guard let nameId = nameIds[name] else {
+            return nil
+        }
+        return current.queryTable(nameId: nameId)
     }
     
     public func queryAtGlobalOnly(_ name: String) -> Symbol? {
-        return tables[0].queryTable(name: name)
+        guard let nameId = nameIds[name] else {
+            return nil
+        }
+        return tables[0].queryTable(nameId: nameId)
     }
     
     public func query(_ name: String) -> Symbol? {
-        var queryingTable: ScopeTable? = current
+        guard let nameId = nameIds[name] else {
+            return nil
+        }
+        return query(nameId: nameId, from: current)
+    }
+    
+    private func query(nameId: Int, from table: ScopeTable) -> Symbol? {
+        var queryingTable: ScopeTable? = table
         while queryingTable != nil {
-            if let result = queryingTable!.queryTable(name: name) {
+            if let result = queryingTable!.queryTable(nameId: nameId) {
                 return result
             }
-            queryingTable = queryingTable?.parent
+            queryingTable = queryingTable!.parent
         }
         return nil
     }
@@ -125,7 +218,8 @@ public class SymbolTable {
             (newSymbol as! ClassSymbol).runtimeId = classRuntimeIdCount
         }
         allSymbols.append(symbol)
-        current.addToTable(symbol: newSymbol)
+        current.addToTable(symbol: newSymbol, nameId: internName(newSymbol.name))
+        methodLookupCache.removeAll(keepingCapacity: true)
         return newSymbol.id
     }
     
@@ -141,30 +235,46 @@ public class SymbolTable {
         return current.id
     }
     
-    public func getAllMethods(methodName: String) -> [Int] {
-        let currentSymbolTableState = getCurrentTableId()
-        var allMethods: [Int] = []
-        while true {
-            let functionNameSymbol = query("#FuncName#\(methodName)")
-            if functionNameSymbol == nil {
+    // the id of every table's parent, or -1 for the global table
+    internal func getTableParentIds() -> [Int] {
+        return tables.map { $0.parent?.id ?? -1 }
+    }
+    
+    private func findMethodNameSymbols(nameId: Int) -> [FunctionNameSymbol] {
+        let key = MethodLookupKey(tableId: current.id, nameId: nameId)
+        if let cached = methodLookupCache[key] {
+            return cached
+        }
+        var methodNameSymbols: [FunctionNameSymbol] = []
+        var searchFrom: ScopeTable? = current
+        while searchFrom != nil {
+            guard let functionNameSymbol = query(nameId: nameId, from: searchFrom!) as? FunctionNameSymbol else {
+                break
+            }
+            if !functionNameSymbol.isForMethods {
                 break
-            } else {
-                let functionNameSymbol = functionNameSymbol as! FunctionNameSymbol
-                if functionNameSymbol.isForMethods {
-                    allMethods.append(contentsOf: functionNameSymbol.belongingFunctions)
-                    gotoTable(functionNameSymbol.belongsToTable)
-                    exitScope()
-                } else {
-                    break
-                }
             }
+            methodNameSymbols.append(functionNameSymbol)
+            searchFrom = tables[functionNameSymbol.belongsToTable].parent
+        }
+        methodLookupCache[key] = methodNameSymbols
+        return methodNameSymbols
+    }
+    
+    public func getAllMethods(methodName: String) -> [Int] {
+        guard let nameId = functionNameSymbolNameIds[methodName] else {
+            return []
+        }
+        var allMethods: [Int] = []
+        for methodNameSymbol in findMethodNameSymbols(nameId: nameId) {
+            allMethods.append(contentsOf: methodNameSymbol.belongingFunctions)
         }
-        gotoTable(currentSymbolTableState)
         return allMethods
     }
     
     public func linkCurrentTableToParent(withId parent: Int) {
         current.linkTableToParent(tables[parent])
+        methodLookupCache.removeAll(keepingCapacity: true)
     }
     
     public func printTable() {
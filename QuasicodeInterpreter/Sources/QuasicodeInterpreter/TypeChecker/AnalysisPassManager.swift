@@ -0,0 +1,128 @@
+import Dispatch
+
+/// Which analyses run alongside the type checker, on top of the return and initializer checks that are part of type checking
+public struct AnalysisPassOptions {
+    /// reports what the tree-walk interpreter can't run, see SupportedByInterpreterChecker
+    public var interpreterSupport: Bool
+    /// times every pass, see TypeChecker.passTimings. this reads the clock around every hook, so it is off unless asked for
+    public var collectTimings: Bool
+    
+    public init(interpreterSupport: Bool = false, collectTimings: Bool = false) {
+        self.interpreterSupport = interpreterSupport
+        self.collectTimings = collectTimings
+    }
+}
+
+/// The analyses that run after the resolver. Instead of each walking the whole AST on its own, they register hooks that the type checker
+/// calls as it goes, so the program is only walked once. Every hook runs after the type checker is done with the node it is given, since
+/// the analyses need its types.
+internal final class AnalysisPassManager {
+    struct Hooks {
+        var afterExpr: ((Expr) -> Void)?
+        var afterStmt: ((Stmt) -> Void)?
+        var afterFunction: ((FunctionStmt) -> Void)? // once the body of a function or method is checked
+        var afterInitializer: ((MethodStmt, ClassStmt) -> Void)? // once the body of an initializer is checked
+        
+        init(
+            afterExpr: ((Expr) -> Void)? = nil,
+            afterStmt: ((Stmt) -> Void)? = nil,
+            afterFunction: ((FunctionStmt) -> Void)? = nil,
+            afterInitializer: ((MethodStmt, ClassStmt) -> Void)? = nil
+        ) {
+            self.afterExpr = afterExpr
+            self.afterStmt = afterStmt
+            self.afterFunction = afterFunction
+            self.afterInitializer = afterInitializer
+        }
+    }
+    
+    private let collectTimings: Bool
+    private var passNames: [String] = []
+    private var passNanoseconds: [UInt64] = []
+    // the hooks of every kind, each with the index of the pass that registered it
+    private var exprHooks: [(pass: Int, hook: (Expr) -> Void)] = []
+    private var stmtHooks: [(pass: Int, hook: (Stmt) -> Void)] = []
+    private var functionHooks: [(pass: Int, hook: (FunctionStmt) -> Void)] = []
+    private var initializerHooks: [(pass: Int, hook: (MethodStmt, ClassStmt) -> Void)] = []
+    
+    init(collectTimings: Bool) {
+        self.collectTimings = collectTimings
+    }
+    
+    /// Passes run in the order they are registered, which matters for the order of the problems they report
+    func register(_ name: String, hooks: Hooks) {
+        let pass = passNames.count
+        passNames.append(name)
+        passNanoseconds.append(0)
+        if let hook = hooks.afterExpr {
+            exprHooks.append((pass, hook))
+        }
+        if let hook = hooks.afterStmt {
+            stmtHooks.append((pass, hook))
+        }
+        if let hook = hooks.afterFunction {
+            functionHooks.append((pass, hook))
+        }
+        if let hook = hooks.afterInitializer {
+            initializerHooks.append((pass, hook))
+        }
+    }
+    
+    /// The time spent in every pass, in nanoseconds by pass name. Empty unless timings are collected
+    var timings: [String : UInt64] {
+        if !collectTimings {
+            return [:]
+        }
+        return .init(uniqueKeysWithValues: zip(passNames, passNanoseconds))
+    }
+    
+    /// Adds in the timings of a manager with the same passes, such as one of a type checker working on a part of the same program
+    func addTimings(_ other: [String : UInt64]) {
+        for (index, name) in passNames.enumerated() {
+            passNanoseconds[index] += other[name] ?? 0
+        }
+    }
+    
+    @inline(__always)
+    private func run(pass: Int, _ body: () -> Void) {
+        if !collectTimings {
+            body()
+            return
+        }
+        let start = DispatchTime.now().uptimeNanoseconds
+        body()
+        passNanoseconds[pass] += DispatchTime.now().uptimeNanoseconds - start
+    }
+    
+    func afterExpr(_ expr: Expr) {
+        for (pass, hook) in exprHooks {
+            run(pass: pass) {
+                hook(expr)
+            }
+        }
+    }
+    
+    func afterStmt(_ stmt: Stmt) {
+        for (pass, hook) in stmtHooks {
+            run(pass: pass) {
+                hook(stmt)
+            }
+        }
+    }
+    
+    func afterFunction(_ stmt: FunctionStmt) {
+        for (pass, hook) in functionHooks {
+            run(pass: pass) {
+                hook(stmt)
+            }
+        }
+    }
+    
+    func afterInitializer(_ stmt: MethodStmt, accompanyingClassStmt: ClassStmt) {
+        for (pass, hook) in initializerHooks {
+            run(pass: pass) {
+                hook(stmt, accompanyingClassStmt)
+            }
+        }
+    }
+}
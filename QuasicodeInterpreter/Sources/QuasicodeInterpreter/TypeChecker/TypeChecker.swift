@@ -1,3 +1,5 @@
+import Dispatch
+
 // swiftlint:disable file_length
 // swiftlint:disable:next type_body_length
 public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
@@ -10,7 +12,23 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     // current class the checker is currently in for public / private checks and super checks
     var currentFunctionIndex: Int?
     var currentClassIndex: Int?
-    var stringClassId: Int = -1
+    var stringClassId: Int = -1 {
+        didSet {
+            stringType = QsClass(name: "String", id: stringClassId)
+        }
+    }
+    private var stringType: QsType = QsClass(name: "String", id: -1)
+    private struct CommonTypeCacheKey: Hashable {
+        let lhs: Int
+        let rhs: Int
+    }
+    // the common type of two types only depends on the class hierarchy, which doesn't change while type checking
+    private var commonTypeCache: [CommonTypeCacheKey : QsType] = [:]
+    private var passOptions = AnalysisPassOptions()
+    private var passes = AnalysisPassManager(collectTimings: false)
+    /// The time the last `typeCheckAst` spent in every analysis pass, in nanoseconds by pass name, and in all of type checking under
+    /// "type checking". Only collected with `AnalysisPassOptions.collectTimings`
+    public private(set) var passTimings: [String : UInt64] = [:]
     
     private func isInMethod() -> Bool {
         return currentFunctionIndex != nil && currentClassIndex != nil
@@ -105,7 +123,17 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     }
     
     private func findCommonType(_ lhs: QsType, _ rhs: QsType) -> QsType {
-        TypeChecker.findCommonType(lhs, rhs, symbolTable: self.symbolTable)
+        if lhs.typeId == rhs.typeId || lhs is QsErrorType || rhs is QsErrorType {
+            // cheap enough to not be worth caching, and the result may be one of the types passed in
+            return TypeChecker.findCommonType(lhs, rhs, symbolTable: self.symbolTable)
+        }
+        let key = CommonTypeCacheKey(lhs: lhs.typeId, rhs: rhs.typeId)
+        if let commonType = commonTypeCache[key] {
+            return commonType
+        }
+        let commonType = TypeChecker.findCommonType(lhs, rhs, symbolTable: self.symbolTable)
+        commonTypeCache[key] = commonType
+        return commonType
     }
     
     public func visitAstArrayTypeQsType(asttype: AstArrayType) -> QsType {
@@ -252,7 +280,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     }
     
     private func getStringType() -> QsType {
-        return QsClass(name: "String", id: stringClassId)
+        return stringType
     }
     
     private func implicitlyCastExprOfSubTypeToType(expr: inout Expr, toType: QsType, reportError: Bool) -> Bool {
@@ -286,7 +314,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitGroupingExpr(expr: GroupingExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         
         typeCheck(expr.expression)
@@ -300,7 +328,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitArrayLiteralExpr(expr: ArrayLiteralExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         if expr.values.isEmpty {
             expr.type = QsAnyType()
@@ -333,7 +361,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitThisExpr(expr: ThisExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         if expr.symbolTableIndex == nil {
             return
@@ -348,7 +376,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitSuperExpr(expr: SuperExpr) {
         defer {
             expr.fallbackToErrorType(assignable: true)
-            expr.type!.assignable = true
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: true)
         }
         if expr.propertyId == nil {
             return
@@ -381,8 +409,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             let globalEntry = symbolEntry as! GlobalVariableSymbol
             switch globalEntry.variableStatus {
             case .finishedInit:
-                expr.type = globalEntry.type!
-                expr.type!.assignable = true
+                expr.type = qsTypeWithAssignable(globalEntry.type!, assignable: true)
             case .initing:
                 assertionFailure("Initing variable status unexpected")
             case .fieldIniting:
@@ -398,8 +425,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             if (symbolEntry as! VariableSymbol).type == nil {
                 return
             } else {
-                expr.type = (symbolEntry as! VariableSymbol).type!
-                expr.type!.assignable = true
+                expr.type = qsTypeWithAssignable((symbolEntry as! VariableSymbol).type!, assignable: true)
             }
         default:
             assertionFailure("Symbol entry for variable expression must be of type Variable or Function!")
@@ -409,7 +435,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitSubscriptExpr(expr: SubscriptExpr) {
         defer {
             expr.fallbackToErrorType(assignable: true)
-            expr.type!.assignable = true
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: true)
         }
         // the index and the expression must both be indexable
         typeCheck(expr.index)
@@ -491,7 +517,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitCallExpr(expr: CallExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         if expr.object != nil {
             typeCheck(expr.object!)
@@ -724,9 +750,8 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             }
         }
         
-        var type = queriedSymbol.type
-        type?.assignable = true
-        return ComputedObjectPropertyInfo(type: type!, propertyId: queriedSymbol.id)
+        let type = qsTypeWithAssignable(queriedSymbol.type!, assignable: true)
+        return ComputedObjectPropertyInfo(type: type, propertyId: queriedSymbol.id)
     }
     
     private func getPropertyForObject(property: Token, className: String, classId: Int, staticLimit: StaticLimit) -> ComputedObjectPropertyInfo? {
@@ -824,7 +849,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitUnaryExpr(expr: UnaryExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         typeCheck(expr.right)
         switch expr.opr.tokenType {
@@ -852,7 +877,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitCastExpr(expr: CastExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         typeCheck(expr.value)
         let castTo = typeCheck(expr.toType)
@@ -888,7 +913,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitArrayAllocationExpr(expr: ArrayAllocationExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         let expressionType = typeCheck(expr.contains)
         for capacity in expr.capacity {
@@ -901,7 +926,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitClassAllocationExpr(expr: ClassAllocationExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         let classSignature = generateClassSignature(className: expr.classType.name.lexeme, templateAstTypes: expr.classType.templateArguments)
         guard let classSymbol = symbolTable.queryAtGlobalOnly(classSignature) as? ClassSymbol else {
@@ -943,7 +968,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitBinaryExpr(expr: BinaryExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         typeCheck(expr.left)
         typeCheck(expr.right)
@@ -1042,7 +1067,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitLogicalExpr(expr: LogicalExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         typeCheck(expr.left)
         typeCheck(expr.right)
@@ -1063,9 +1088,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
         guard let symbol = symbolTable.getSymbol(id: variable.symbolTableIndex!) as? VariableSymbol else {
             return
         }
-        var typeCopy = type
-        typeCopy.assignable = true
-        symbol.type = typeCopy
+        symbol.type = qsTypeWithAssignable(type, assignable: true)
         variable.type = type
     }
     
@@ -1085,7 +1108,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitVariableToSetExpr(expr: VariableToSetExpr) {
         defer {
             expr.fallbackToErrorType(assignable: true)
-            expr.type!.assignable = true
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: true)
         }
         
         typeCheck(expr.to)
@@ -1095,7 +1118,7 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     public func visitIsTypeExpr(expr: IsTypeExpr) {
         defer {
             expr.fallbackToErrorType(assignable: false)
-            expr.type!.assignable = false
+            expr.type = qsTypeWithAssignable(expr.type!, assignable: false)
         }
         typeCheck(expr.left)
         expr.rightType = typeCheck(expr.right)
@@ -1110,6 +1133,17 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
         if stmt.symbolTableIndex == nil {
             return
         }
+        withinClassScope(stmt) {
+            typeClassFieldsAndThis(stmt)
+            
+            // type all of the methods
+            for method in stmt.methods {
+                processMethodStmt(stmt: method, isInitializer: method.function.name.lexeme == stmt.name.lexeme, accompanyingClassStmt: stmt)
+            }
+        }
+    }
+    
+    private func withinClassScope(_ stmt: ClassStmt, _ body: () -> Void) {
         let previousSymbolTableIndex = symbolTable.getCurrentTableId()
         symbolTable.gotoTable(stmt.scopeIndex!)
         let previousClassIndex = currentClassIndex
@@ -1118,6 +1152,10 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             symbolTable.gotoTable(previousSymbolTableIndex)
             currentClassIndex = previousClassIndex
         }
+        body()
+    }
+    
+    private func typeClassFieldsAndThis(_ stmt: ClassStmt) {
         // type all of the fields
         func typeField(_ field: AstClassField) {
             if field.symbolTableIndex == nil {
@@ -1149,11 +1187,6 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             let relatedStaticThisSymbol = symbolTable.getSymbol(id: stmt.staticThisSymbolTableIndex!) as! VariableSymbol
             relatedStaticThisSymbol.type = QsClass(name: symbol.displayName, id: stmt.symbolTableIndex!)
         }
-        
-        // type all of the methods
-        for method in stmt.methods {
-            processMethodStmt(stmt: method, isInitializer: method.function.name.lexeme == stmt.name.lexeme, accompanyingClassStmt: stmt)
-        }
     }
     
     private func processMethodStmt(stmt: MethodStmt, isInitializer: Bool, accompanyingClassStmt: ClassStmt) {
@@ -1162,28 +1195,32 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
         let isDub = stmt.function.keyword.isDummy()
         
         if isInitializer && !isDub {
-            let instanceVariableHasInitializedInInitializerChecker = InstanceVariableInitializedInInitializerChecker(
-                reportErrorForReturnStatement: { returnStmt, message in
-                    self.error(message: message, on: returnStmt.keyword)
-                },
-                reportErrorForExpression: { expr, message in
-                    self.error(message: message, on: expr)
-                },
-                reportEndingError: { message in
-                    self.error(message: message, on: stmt.function.endOfFunction)
-                },
-                symbolTable: symbolTable
+            passes.afterInitializer(stmt, accompanyingClassStmt: accompanyingClassStmt)
+        }
+    }
+    
+    private func checkInstanceVariablesInitialized(_ stmt: MethodStmt, accompanyingClassStmt: ClassStmt) {
+        let instanceVariableHasInitializedInInitializerChecker = InstanceVariableInitializedInInitializerChecker(
+            reportErrorForReturnStatement: { returnStmt, message in
+                self.error(message: message, on: returnStmt.keyword)
+            },
+            reportErrorForExpression: { expr, message in
+                self.error(message: message, on: expr)
+            },
+            reportEndingError: { message in
+                self.error(message: message, on: stmt.function.endOfFunction)
+            },
+            symbolTable: symbolTable
+        )
+        for field in accompanyingClassStmt.fields where field.symbolTableIndex != nil {
+            instanceVariableHasInitializedInInitializerChecker.trackVariable(variableId: field.symbolTableIndex!)
+        }
+        if accompanyingClassStmt.symbolTableIndex != nil {
+            
+            instanceVariableHasInitializedInInitializerChecker.checkStatements(
+                stmt.function.body,
+                withinClass: accompanyingClassStmt.symbolTableIndex!
             )
-            for field in accompanyingClassStmt.fields where field.symbolTableIndex != nil {
-                instanceVariableHasInitializedInInitializerChecker.trackVariable(variableId: field.symbolTableIndex!)
-            }
-            if accompanyingClassStmt.symbolTableIndex != nil {
-                
-                instanceVariableHasInitializedInInitializerChecker.checkStatements(
-                    stmt.function.body,
-                    withinClass: accompanyingClassStmt.symbolTableIndex!
-                )
-            }
         }
     }
     
@@ -1210,6 +1247,10 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             typeCheck(stmt)
         }
         
+        passes.afterFunction(stmt)
+    }
+    
+    private func checkGaurenteedReturn(_ stmt: FunctionStmt) {
         let functionSymbol = symbolTable.getSymbol(id: stmt.symbolTableIndex!) as! FunctionLikeSymbol
         if !(functionSymbol.returnType is QsVoidType) {
             // gaurentee a return
@@ -1406,7 +1447,12 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
     }
     
     private func typeCheck(_ stmt: Stmt) {
+        if stmt is SetStmt && (stmt as! SetStmt).typeChecked {
+            // global definitions are checked ahead of everything else, see typeGlobals
+            return
+        }
         stmt.accept(visitor: self)
+        passes.afterStmt(stmt)
     }
     
     private func typeCheck(_ expr: Expr) {
@@ -1414,6 +1460,41 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
             return
         }
         expr.accept(visitor: self)
+        passes.afterExpr(expr)
+    }
+    
+    // the analyses that run on this type checker's traversal instead of walking the AST again, see AnalysisPassManager
+    private func makePasses() -> AnalysisPassManager {
+        let passes = AnalysisPassManager(collectTimings: passOptions.collectTimings)
+        passes.register("return check", hooks: .init(afterFunction: { [unowned self] stmt in
+            self.checkGaurenteedReturn(stmt)
+        }))
+        passes.register("initializer check", hooks: .init(afterInitializer: { [unowned self] stmt, accompanyingClassStmt in
+            self.checkInstanceVariablesInitialized(stmt, accompanyingClassStmt: accompanyingClassStmt)
+        }))
+        if passOptions.interpreterSupport {
+            let supportedByInterpreterChecker = SupportedByInterpreterChecker(
+                symbolTable: symbolTable,
+                stringClassId: stringClassId,
+                reportError: { [unowned self] message, start, end in
+                    self.problems.append(.init(message: message, start: start, end: end))
+                }
+            )
+            // a class is reported as a whole, what is inside of it isn't reported again
+            passes.register("interpreter support", hooks: .init(
+                afterExpr: { [unowned self] expr in
+                    if self.currentClassIndex == nil {
+                        supportedByInterpreterChecker.checkSupport(expr)
+                    }
+                },
+                afterStmt: { [unowned self] stmt in
+                    if self.currentClassIndex == nil {
+                        supportedByInterpreterChecker.checkSupport(stmt)
+                    }
+                }
+            ))
+        }
+        return passes
     }
     
     private func typeCheck(_ type: AstType) -> QsType {
@@ -1506,23 +1587,40 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
         }
     }
     
-    public func typeCheckAst(statements: [Stmt], symbolTables: inout SymbolTable, debugPrint: Bool = false) -> [InterpreterProblem] {
+    public func typeCheckAst(
+        statements: [Stmt],
+        symbolTables: inout SymbolTable,
+        debugPrint: Bool = false,
+        parallel: Bool = false,
+        passes passOptions: AnalysisPassOptions = .init()
+    ) -> [InterpreterProblem] {
         if debugPrint {
             print("----- Type Checker -----")
         }
+        let start = DispatchTime.now().uptimeNanoseconds
         
         self.symbolTable = symbolTables
         stringClassId = symbolTable.queryAtGlobalOnly("String<>")?.id ?? -1
+        self.passOptions = passOptions
+        passes = makePasses()
         
         typeFunctions(statements: statements)
         typeClassFields(statements: statements)
         typeGlobals(statements: statements)
         
-        for statement in statements {
-            typeCheck(statement)
+        if parallel {
+            typeCheckBodiesConcurrently(statements: statements)
+        } else {
+            for statement in statements {
+                typeCheck(statement)
+            }
         }
         
         symbolTables = self.symbolTable
+        passTimings = passes.timings
+        if passOptions.collectTimings {
+            passTimings["type checking"] = DispatchTime.now().uptimeNanoseconds - start
+        }
         
         if debugPrint {
             print("Type checked AST")
@@ -1536,6 +1634,97 @@ public class TypeChecker: ExprVisitor, StmtVisitor, AstTypeQsTypeVisitor {
         return problems
     }
     
+    private enum ConcurrentTypeCheckSegment {
+        case problems([InterpreterProblem])
+        case workItem(Int)
+    }
+    
+    private func typeCheckBodiesConcurrently(statements: [Stmt]) {
+        // function and method bodies only write to the types of their own locals and expressions,
+        // everything they share (signatures, globals, fields, this) has already been typed at this point.
+        // everything else is checked serially, and problems are stitched back together in source order
+        var segments: [ConcurrentTypeCheckSegment] = []
+        var workItems: [(TypeChecker) -> Void] = []
+        func flushProblems() {
+            if !problems.isEmpty {
+                segments.append(.problems(problems))
+                problems = []
+            }
+        }
+        func addWorkItem(_ workItem: @escaping (TypeChecker) -> Void) {
+            flushProblems()
+            segments.append(.workItem(workItems.count))
+            workItems.append(workItem)
+        }
+        
+        for statement in statements {
+            switch statement {
+            case is FunctionStmt:
+                let statement = statement as! FunctionStmt
+                addWorkItem { worker in
+                    worker.typeCheck(statement)
+                }
+            case is ClassStmt:
+                let statement = statement as! ClassStmt
+                if statement.symbolTableIndex == nil {
+                    // typeCheck still runs the hooks of a class it has nothing to check in
+                    passes.afterStmt(statement)
+                    continue
+                }
+                withinClassScope(statement) {
+                    typeClassFieldsAndThis(statement)
+                }
+                for method in statement.methods {
+                    addWorkItem { worker in
+                        worker.withinClassScope(statement) {
+                            worker.processMethodStmt(
+                                stmt: method,
+                                isInitializer: method.function.name.lexeme == statement.name.lexeme,
+                                accompanyingClassStmt: statement
+                            )
+                        }
+                    }
+                }
+                // the class is never passed to typeCheck here, but its hooks still run after its methods like they would
+                passes.afterStmt(statement)
+            default:
+                typeCheck(statement)
+            }
+        }
+        flushProblems()
+        
+        // every worker gets its own view of the symbol table so that they don't fight over the current scope
+        let symbolTableViews = workItems.map { _ in symbolTable.createView() }
+        var workItemProblems: [[InterpreterProblem]] = .init(repeating: [], count: workItems.count)
+        var workItemTimings: [[String : UInt64]] = .init(repeating: [:], count: workItems.count)
+        workItemProblems.withUnsafeMutableBufferPointer { workItemProblems in
+            workItemTimings.withUnsafeMutableBufferPointer { workItemTimings in
+                DispatchQueue.concurrentPerform(iterations: workItems.count) { index in
+                    let worker = TypeChecker()
+                    worker.symbolTable = symbolTableViews[index]
+                    worker.stringClassId = stringClassId
+                    worker.passOptions = passOptions
+                    worker.passes = worker.makePasses()
+                    workItems[index](worker)
+                    workItemProblems[index] = worker.problems
+                    workItemTimings[index] = worker.passes.timings
+                }
+            }
+        }
+        for timings in workItemTimings {
+            passes.addTimings(timings)
+        }
+        
+        for segment in segments {
+            switch segment {
+            case .problems(let segmentProblems):
+                problems.append(contentsOf: segmentProblems)
+            case .workItem(let index):
+                problems.append(contentsOf: workItemProblems[index])
+            }
+        }
+    }
+    
     private enum TypeCheckerError: Error {
         case error(String)
     }
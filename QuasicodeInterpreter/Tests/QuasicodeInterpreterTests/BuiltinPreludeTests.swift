@@ -0,0 +1,69 @@
+import XCTest
+@testable import QuasicodeInterpreter
+
+final class BuiltinPreludeTests: XCTestCase {
+    private func describeStringClass(loadedFrom prelude: BuiltinPrelude) -> [String] {
+        let symbolTable = SymbolTable()
+        prelude.loadStringClass(into: symbolTable)
+        return symbolTable.getAllSymbols().map { "\($0.belongsToTable) \($0.id) \($0.name)" }
+    }
+    
+    private func describeBuiltinClasses(of prelude: BuiltinPrelude) -> String {
+        return astPrinterSingleton.printAst(prelude.makeBuiltinClassStmts(), printWithTypes: false)
+    }
+    
+    func testSerialisedPreludeLoadsTheSameBuiltins() throws {
+        let declared = BuiltinPrelude()
+        let bytes = declared.serialised()
+        let loaded = try BuiltinPrelude(serialised: bytes)
+        
+        XCTAssertEqual(loaded.serialised(), bytes)
+        let stringClass = describeStringClass(loadedFrom: loaded)
+        XCTAssertFalse(stringClass.isEmpty)
+        XCTAssertEqual(stringClass, describeStringClass(loadedFrom: declared))
+        XCTAssertEqual(describeBuiltinClasses(of: loaded), describeBuiltinClasses(of: declared))
+    }
+    
+    func testCorruptedPreludeIsRejected() throws {
+        let bytes = BuiltinPrelude().serialised()
+        
+        XCTAssertThrowsError(try BuiltinPrelude(serialised: [])) { error in
+            guard case BuiltinPrelude.LoadError.notAPrelude = error else {
+                return XCTFail("\(error)")
+            }
+        }
+        XCTAssertThrowsError(try BuiltinPrelude(serialised: Array("QSPX".utf8) + bytes.dropFirst(4))) { error in
+            guard case BuiltinPrelude.LoadError.notAPrelude = error else {
+                return XCTFail("\(error)")
+            }
+        }
+        
+        // the version follows the magic, as a single byte for a small version
+        var newerVersion = bytes
+        newerVersion[4] = UInt8((BuiltinPrelude.version + 1) << 1)
+        XCTAssertThrowsError(try BuiltinPrelude(serialised: newerVersion)) { error in
+            guard case BuiltinPrelude.LoadError.unsupportedVersion(let version) = error else {
+                return XCTFail("\(error)")
+            }
+            XCTAssertEqual(version, BuiltinPrelude.version + 1)
+        }
+        
+        // a snapshot that was cut off anywhere, or has anything after it, is never taken for a complete one
+        for length in 0..<bytes.count {
+            XCTAssertThrowsError(try BuiltinPrelude(serialised: Array(bytes.prefix(length))), "cut off after \(length) bytes")
+        }
+        XCTAssertThrowsError(try BuiltinPrelude(serialised: bytes + [0])) { error in
+            guard case BuiltinPrelude.LoadError.corrupted = error else {
+                return XCTFail("\(error)")
+            }
+        }
+        // a count that is larger than what is left
+        var hugeCount = Array(bytes.prefix(5))
+        hugeCount.append(contentsOf: [0xfe, 0xff, 0xff, 0xff, 0x0f])
+        XCTAssertThrowsError(try BuiltinPrelude(serialised: hugeCount)) { error in
+            guard case BuiltinPrelude.LoadError.corrupted = error else {
+                return XCTFail("\(error)")
+            }
+        }
+    }
+}
@@ -0,0 +1,74 @@
+import XCTest
+@testable import QuasicodeInterpreter
+
+final class InterpreterSessionTests: XCTestCase {
+    private func makeSession(_ program: String, budget: Interpreter.Budget? = nil, output: @escaping (String) -> Void) -> InterpreterSession {
+        // Foundation has a Scanner too
+        let (tokens, _) = QuasicodeInterpreter.Scanner(source: program).scanTokens()
+        var symbolTable: SymbolTable = .init()
+        Builtins.addStringClassToSymbolTable(symbolTable)
+        let stringClassIndex = symbolTable.queryAtGlobalOnly("String<>")!.id
+        let (parsedStmts, _) = Parser(tokens: tokens, stringClassIndex: stringClassIndex, builtinClasses: ["String"])
+            .parse(addBuiltinclassesToAst: false)
+        var (ast, _) = Templater().expandClasses(statements: parsedStmts)
+        _ = Resolver().resolveAST(statements: &ast, symbolTable: &symbolTable)
+        let problems = TypeChecker().typeCheckAst(statements: ast, symbolTables: &symbolTable, parallel: false)
+        XCTAssertEqual(problems.map { $0.message }, [])
+        return InterpreterSession(ast, symbolTable: symbolTable, customStdout: output, budget: budget)
+    }
+    
+    func testOutputIsHandedOverOnceAcrossResumes() throws {
+        var output = ""
+        let session = makeSession("""
+        output "before"
+        name = ""
+        input name
+        output "hello " + name
+        count = 0
+        input count
+        output count + 1
+        """) { output += $0 }
+        XCTAssertNil(session.status)
+        
+        XCTAssertEqual(session.start(), .needsInput)
+        XCTAssertEqual(session.status, .needsInput)
+        XCTAssertEqual(output, "before\n")
+        
+        XCTAssertEqual(session.resume(input: "world"), .needsInput)
+        XCTAssertEqual(session.status, .needsInput)
+        XCTAssertEqual(output, "before\nhello world\n")
+        
+        XCTAssertEqual(session.resume(input: "41"), .finished)
+        XCTAssertEqual(session.status, .finished)
+        XCTAssertEqual(output, "before\nhello world\n42\n")
+    }
+    
+    func testEveryResumeHasABudgetOfItsOwn() throws {
+        var output = ""
+        // each of the first two loops fits in the budget, but not both of them, and the last one doesn't fit on its own
+        let session = makeSession("""
+        total = 0
+        loop i from 1 to 10
+            total = total + i
+        end loop
+        output total
+        line = ""
+        input line
+        loop j from 1 to 10
+            total = total + j
+        end loop
+        output total
+        input line
+        loop k from 1 to 100
+            total = total + k
+        end loop
+        output total
+        """, budget: Interpreter.Budget(safepoints: 15)) { output += $0 }
+        XCTAssertEqual(session.start(), .needsInput)
+        XCTAssertEqual(session.resume(input: ""), .needsInput)
+        XCTAssertEqual(output, "55\n110\n")
+        XCTAssertEqual(session.resume(input: ""), .outOfBudget)
+        XCTAssertEqual(session.status, .outOfBudget)
+        XCTAssertEqual(output, "55\n110\n")
+    }
+}
@@ -0,0 +1,111 @@
+import XCTest
+import Dispatch
+import QuasicodeCommon
+@testable import QuasicodeInterpreter
+
+final class InterpreterTests: XCTestCase {
+    private func execute(
+        _ program: String,
+        cancellationToken: CancellationToken? = nil,
+        budget: Interpreter.Budget? = nil,
+        output: @escaping (String) -> Void = { _ in }
+    ) -> Interpreter.ExecutionResult {
+        // Foundation has a Scanner too
+        let (tokens, _) = QuasicodeInterpreter.Scanner(source: program).scanTokens()
+        var symbolTable: SymbolTable = .init()
+        Builtins.addStringClassToSymbolTable(symbolTable)
+        let stringClassIndex = symbolTable.queryAtGlobalOnly("String<>")!.id
+        let (parsedStmts, _) = Parser(tokens: tokens, stringClassIndex: stringClassIndex, builtinClasses: ["String"])
+            .parse(addBuiltinclassesToAst: false)
+        var (ast, _) = Templater().expandClasses(statements: parsedStmts)
+        _ = Resolver().resolveAST(statements: &ast, symbolTable: &symbolTable)
+        let problems = TypeChecker().typeCheckAst(statements: ast, symbolTables: &symbolTable, parallel: false)
+        XCTAssertEqual(problems.map { $0.message }, [])
+        return Interpreter().execute(
+            ast,
+            symbolTable: symbolTable,
+            customStdout: output,
+            cancellationToken: cancellationToken,
+            budget: budget
+        )
+    }
+    
+    private let endlessLoop = """
+    output "started"
+    count = 0
+    loop while true
+        count = count + 1
+    end loop
+    """
+    
+    func testRunsOutOfSafepoints() throws {
+        let budget = Interpreter.Budget(safepoints: 15)
+        XCTAssertEqual(execute("""
+        total = 0
+        loop i from 1 to 10
+            total = total + i
+        end loop
+        """, budget: budget), .finished)
+        
+        var output = ""
+        XCTAssertEqual(execute("""
+        total = 0
+        loop i from 1 to 100
+            total = total + i
+        end loop
+        output total
+        """, budget: budget) { output += $0 }, .outOfBudget)
+        XCTAssertEqual(output, "")
+        
+        // calls are safepoints too
+        XCTAssertEqual(execute("""
+        function countDown(n: int): int
+            if n == 0 then
+                return 0
+            end if
+            return countDown(n - 1)
+        end function
+        output countDown(100)
+        """, budget: budget), .outOfBudget)
+    }
+    
+    func testRunsOutOfTime() throws {
+        var output = ""
+        let start = DispatchTime.now().uptimeNanoseconds
+        XCTAssertEqual(execute(endlessLoop, budget: Interpreter.Budget(seconds: 0.05)) { output += $0 }, .outOfBudget)
+        XCTAssertEqual(output, "started\n")
+        // the clock is only read every so often, but a loop gets to a reading quickly
+        XCTAssertLessThan(DispatchTime.now().uptimeNanoseconds - start, 5_000_000_000)
+    }
+    
+    func testCancellation() throws {
+        let token = CancellationToken()
+        DispatchQueue.global().asyncAfter(deadline: .now() + 0.05) {
+            token.cancel()
+        }
+        var output = ""
+        XCTAssertEqual(execute(endlessLoop, cancellationToken: token) { output += $0 }, .cancelled)
+        XCTAssertEqual(output, "started\n")
+    }
+    
+    func testCancellationOnlyStopsAtSafepoints() throws {
+        let token = CancellationToken()
+        token.cancel()
+        // without a loop or a call, there is no safepoint for the cancellation to stop the program at
+        var output = ""
+        XCTAssertEqual(execute("""
+        output "first"
+        output "second"
+        """, cancellationToken: token) { output += $0 }, .finished)
+        XCTAssertEqual(output, "first\nsecond\n")
+        
+        output = ""
+        XCTAssertEqual(execute("""
+        output "first"
+        loop i from 1 to 2
+            output i
+        end loop
+        """, cancellationToken: token) { output += $0 }, .cancelled)
+        XCTAssertEqual(output, "first\n")
+    }
+}
@@ -0,0 +1,223 @@
+import XCTest
+@testable import QuasicodeInterpreter
+
+final class SSAPassesTests: XCTestCase {
+    private func buildModule(_ program: String) -> SSAModule {
+        // Foundation has a Scanner too
+        let (tokens, _) = QuasicodeInterpreter.Scanner(source: program).scanTokens()
+        var symbolTable: SymbolTable = .init()
+        Builtins.addStringClassToSymbolTable(symbolTable)
+        let stringClassIndex = symbolTable.queryAtGlobalOnly("String<>")!.id
+        let (parsedStmts, _) = Parser(tokens: tokens, stringClassIndex: stringClassIndex, builtinClasses: ["String"])
+            .parse(addBuiltinclassesToAst: false)
+        var (ast, _) = Templater().expandClasses(statements: parsedStmts)
+        _ = Resolver().resolveAST(statements: &ast, symbolTable: &symbolTable)
+        let problems = TypeChecker().typeCheckAst(statements: ast, symbolTables: &symbolTable, parallel: false)
+        XCTAssertEqual(problems.map { $0.message }, [])
+        
+        let (module, ssaProblems) = SSABuilder().buildModule(statements: ast, symbolTable: symbolTable)
+        XCTAssertEqual(ssaProblems.map { $0.message }, [])
+        return module
+    }
+    
+    /// Lowers the program and returns one of its functions, with its unreachable blocks removed like SSAPasses.optimise does first
+    private func lowerFunction(_ name: String, in program: String) -> SSAFunction {
+        let function = buildModule(program).functions.first { $0.name == name }!
+        SSAPasses().removeUnreachableBlocks(function)
+        return function
+    }
+    
+    private func instructions(of function: SSAFunction, where predicate: (SSAOperation) -> Bool) -> [SSAValue] {
+        function.blocks.filter { $0.reachable }.flatMap { $0.instructions }.filter { predicate(function.instructions[$0].operation) }
+    }
+    
+    func testCopyPropagationRemovesCopies() throws {
+        let function = lowerFunction("f", in: """
+        function f(a: int): int
+            b = a
+            c = b
+            return c + 1
+        end function
+        """)
+        XCTAssertEqual(instructions(of: function) { $0 == .copy }.count, 2)
+        
+        XCTAssertEqual(SSAPasses().propagateCopies(function), 2)
+        XCTAssertEqual(instructions(of: function) { $0 == .copy }, [])
+        let sum = instructions(of: function) { $0 == .binary(.PLUS) }
+        XCTAssertEqual(sum.count, 1)
+        XCTAssertEqual(function.instructions[function.instructions[sum[0]].operands[0]].operation, .parameter(function.parameters[0]))
+    }
+    
+    func testCommonSubexpressionEliminationReusesValues() throws {
+        let function = lowerFunction("f", in: """
+        function f(a: int, b: int): int
+            x = a * b
+            y = a * b
+            return x + y
+        end function
+        """)
+        let passes = SSAPasses()
+        _ = passes.propagateCopies(function)
+        XCTAssertEqual(instructions(of: function) { $0 == .binary(.STAR) }.count, 2)
+        
+        XCTAssertEqual(passes.eliminateCommonSubexpressions(function), 1)
+        let products = instructions(of: function) { $0 == .binary(.STAR) }
+        XCTAssertEqual(products.count, 1)
+        let sum = instructions(of: function) { $0 == .binary(.PLUS) }[0]
+        XCTAssertEqual(function.instructions[sum].operands, [products[0], products[0]])
+    }
+    
+    func testLoopInvariantCodeMotionHoistsIntoPreheader() throws {
+        let function = lowerFunction("f", in: """
+        function f(a: int, b: int): int
+            total = 0
+            loop i from 1 to 10
+                total = total + a * b
+            end loop
+            return total
+        end function
+        """)
+        let passes = SSAPasses()
+        // the parameters are read through phis in the loop header until copy propagation removes them
+        _ = passes.propagateCopies(function)
+        XCTAssertEqual(function.loops.count, 1)
+        let loop = function.loops[0]
+        let product = instructions(of: function) { $0 == .binary(.STAR) }[0]
+        XCTAssertTrue(loop.blocks.contains(function.instructions[product].block))
+        
+        XCTAssertGreaterThan(passes.hoistLoopInvariants(function), 0)
+        XCTAssertEqual(function.instructions[product].block, loop.preheader)
+        XCTAssertTrue(function.blocks[loop.preheader].instructions.contains(product))
+        // the sum depends on the previous iteration and stays in the loop
+        let sum = instructions(of: function) { $0 == .binary(.PLUS) }.first { function.instructions[$0].operands.contains(product) }!
+        XCTAssertTrue(loop.blocks.contains(function.instructions[sum].block))
+    }
+    
+    func testDeadStoreEliminationRemovesOverwrittenStores() throws {
+        let program = """
+        total = 0
+        total = 1
+        output total
+        
+        function f(a: int[])
+            a[0] = 1
+            a[0] = 2
+        end function
+        """
+        let main = lowerFunction("<main>", in: program)
+        let isStoreGlobal = { (operation: SSAOperation) -> Bool in
+            if case .storeGlobal = operation {
+                return true
+            }
+            return false
+        }
+        XCTAssertEqual(instructions(of: main, where: isStoreGlobal).count, 2)
+        XCTAssertGreaterThan(SSAPasses().eliminateDeadStores(main), 0)
+        let globalStores = instructions(of: main, where: isStoreGlobal)
+        XCTAssertEqual(globalStores.count, 1)
+        XCTAssertEqual(main.instructions[main.instructions[globalStores[0]].operands[0]].operation, .constantInt(1))
+        
+        // both stores index with a constant 0 of their own until common subexpression elimination merges them
+        let function = lowerFunction("f", in: program)
+        let passes = SSAPasses()
+        _ = passes.eliminateCommonSubexpressions(function)
+        XCTAssertEqual(instructions(of: function) { $0 == .arraySet }.count, 2)
+        XCTAssertGreaterThan(passes.eliminateDeadStores(function), 0)
+        let elementStores = instructions(of: function) { $0 == .arraySet }
+        XCTAssertEqual(elementStores.count, 1)
+        XCTAssertEqual(function.instructions[function.instructions[elementStores[0]].operands[2]].operation, .constantInt(2))
+    }
+    
+    func testDeadStoreEliminationKeepsStoresReadThroughTheArray() throws {
+        // between the two stores, the array is output, saved in a global where anything could read it, and stored into another array
+        let program = """
+        saved = new int[1]
+        
+        function outputs(a: int[])
+            a[0] = 1
+            output a
+            a[0] = 2
+        end function
+        
+        function savesGlobally(a: int[])
+            a[0] = 1
+            saved = a
+            a[0] = 2
+        end function
+        
+        function nests(outer: int[][], a: int[])
+            a[0] = 1
+            outer[0] = a
+            a[0] = 2
+        end function
+        """
+        for name in ["outputs", "savesGlobally", "nests"] {
+            let function = lowerFunction(name, in: program)
+            let passes = SSAPasses()
+            _ = passes.propagateCopies(function)
+            _ = passes.eliminateCommonSubexpressions(function)
+            let storesBefore = instructions(of: function) { $0 == .arraySet }.count
+            _ = passes.eliminateDeadStores(function)
+            XCTAssertEqual(instructions(of: function) { $0 == .arraySet }.count, storesBefore, "\(name) lost a store")
+        }
+    }
+    
+    func testEscapeAnalysis() throws {
+        let module = buildModule("""
+        kept = new int[1]
+        
+        function returned(): int[]
+            a = new int[2]
+            return a
+        end function
+        
+        function storedGlobally()
+            a = new int[2]
+            kept = a
+        end function
+        
+        function keeps(a: int[])
+            kept = a
+        end function
+        
+        function reads(a: int[]): int
+            return a[0]
+        end function
+        
+        function passedToKeeper()
+            a = new int[2]
+            keeps(a)
+        end function
+        
+        function passedToReader(): int
+            a = new int[2]
+            return reads(a)
+        end function
+        
+        function usedLocally(): int
+            a = new int[2]
+            a[0] = 5
+            return a[0] + a.length
+        end function
+        """)
+        let passes = SSAPasses()
+        for function in module.functions {
+            passes.removeUnreachableBlocks(function)
+        }
+        XCTAssertEqual(passes.allocateInFrames(module), 2)
+        
+        func isFrameAllocated(_ name: String) -> Bool {
+            let function = module.functions.first { $0.name == name }!
+            let allocations = instructions(of: function) { $0 == .arrayAllocate }
+            XCTAssertEqual(allocations.count, 1, name)
+            return function.instructions[allocations[0]].isFrameAllocated
+        }
+        XCTAssertFalse(isFrameAllocated("returned"))
+        XCTAssertFalse(isFrameAllocated("storedGlobally"))
+        XCTAssertFalse(isFrameAllocated("passedToKeeper"))
+        XCTAssertTrue(isFrameAllocated("passedToReader"))
+        XCTAssertTrue(isFrameAllocated("usedLocally"))
+        // the global's own array is stored into it
+        XCTAssertEqual(module.heapAllocationCount, 4)
+    }
+}
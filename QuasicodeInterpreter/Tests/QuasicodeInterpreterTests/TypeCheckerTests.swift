@@ -0,0 +1,120 @@
+import XCTest
+@testable import QuasicodeInterpreter
+
+final class TypeCheckerTests: XCTestCase {
+    // functions, methods and top level code, with problems in each of them so that the order in which they are reported is checked too
+    private let program = """
+    function square(x: int): int
+        return x * x
+    end function
+    
+    function describe(value: double, label: String = "value"): String
+        if value > 1.5 then
+            return label + " is big"
+        end if
+        return true
+    end function
+    
+    class Counter
+        count: int = 0
+        step: int = 1
+        
+        function increment()
+            this.count = this.count + this.step
+        end function
+        
+        function reset(to: int)
+            this.count = "zero"
+        end function
+        
+        function scaled(by: double): double
+            return this.count * by
+        end function
+    end class
+    
+    class Pair<T>
+        first: T
+        second: T
+        
+        function swap()
+            temporary = this.first
+            this.first = this.second
+            this.second = temporary
+        end function
+    end class
+    
+    counter = new Counter()
+    counter.increment()
+    output square(3), describe(2.5), counter.scaled(0.5)
+    output square("three")
+    pair = new Pair<int>()
+    pair.swap()
+    loop i from 1 to 10
+        output square(i) + describe(i)
+    end loop
+    """
+    
+    private func typeCheck(
+        parallel: Bool,
+        passes: AnalysisPassOptions = .init()
+    ) -> (problems: [String], ast: String, locatedProblems: [InterpreterProblem], classes: [ClassStmt]) {
+        // Foundation has a Scanner too
+        let (tokens, _) = QuasicodeInterpreter.Scanner(source: program).scanTokens()
+        var symbolTable: SymbolTable = .init()
+        Builtins.addStringClassToSymbolTable(symbolTable)
+        let stringClassIndex = symbolTable.queryAtGlobalOnly("String<>")!.id
+        let (parsedStmts, _) = Parser(tokens: tokens, stringClassIndex: stringClassIndex, builtinClasses: ["String"])
+            .parse(addBuiltinclassesToAst: false)
+        var (ast, _) = Templater().expandClasses(statements: parsedStmts)
+        _ = Resolver().resolveAST(statements: &ast, symbolTable: &symbolTable)
+        
+        let problems = TypeChecker().typeCheckAst(statements: ast, symbolTables: &symbolTable, parallel: parallel, passes: passes)
+        let describedProblems = problems.map { problem in
+            "\(problem.startLocation.row):\(problem.startLocation.column)-\(problem.endLocation.row):\(problem.endLocation.column) \(problem.message)"
+        }
+        return (describedProblems, astPrinterSingleton.printAst(ast, printWithTypes: true), problems, ast.compactMap { $0 as? ClassStmt })
+    }
+    
+    func testParallelTypeCheckingMatchesSerial() throws {
+        let serial = typeCheck(parallel: false)
+        XCTAssertFalse(serial.problems.isEmpty)
+        // the bodies are spread over the threads differently every time, so give a race a few chances to show up
+        for _ in 0..<20 {
+            let parallel = typeCheck(parallel: true)
+            XCTAssertEqual(parallel.problems, serial.problems)
+            XCTAssertEqual(parallel.ast, serial.ast)
+        }
+    }
+    
+    func testInterpreterSupportMatchesSerialAndStaysOutOfClasses() throws {
+        let typeCheckerOnly = typeCheck(parallel: false)
+        let serial = typeCheck(parallel: false, passes: .init(interpreterSupport: true))
+        // the checker adds its problems between the type checker's own, which keep their order
+        let supportProblems = serial.locatedProblems.filter { problem in
+            !typeCheckerOnly.locatedProblems.contains { other in
+                other.message == problem.message && other.startLocation == problem.startLocation && other.endLocation == problem.endLocation
+            }
+        }
+        XCTAssertEqual(serial.problems.count, typeCheckerOnly.problems.count + supportProblems.count)
+        XCTAssertEqual(serial.problems.filter { typeCheckerOnly.problems.contains($0) }, typeCheckerOnly.problems)
+        
+        // a class is reported once, at its keyword, and nothing inside of it is reported on top of that
+        XCTAssertFalse(serial.classes.isEmpty)
+        for classStmt in serial.classes {
+            let reportedInClass = supportProblems.filter { $0.startLocation >= classStmt.startLocation && $0.endLocation <= classStmt.endLocation }
+            XCTAssertEqual(reportedInClass.map { $0.message }, ["Classes are not supported"], classStmt.name.lexeme)
+            XCTAssertEqual(reportedInClass.first?.startLocation, classStmt.keyword.startLocation, classStmt.name.lexeme)
+        }
+        XCTAssertFalse(supportProblems.contains { $0.message == "Methods are not supported" })
+        // the top level code creates instances and calls methods
+        XCTAssertTrue(supportProblems.contains { $0.message == "Calling methods are not supported" })
+        XCTAssertGreaterThan(supportProblems.filter { $0.message == "Classes are not supported" }.count, serial.classes.count)
+        
+        // the class hooks run outside of the work items in typeCheckBodiesConcurrently, which has to put them back in the same place
+        for _ in 0..<20 {
+            let parallel = typeCheck(parallel: true, passes: .init(interpreterSupport: true))
+            XCTAssertEqual(parallel.problems, serial.problems)
+            XCTAssertEqual(parallel.ast, serial.ast)
+        }
+    }
+}